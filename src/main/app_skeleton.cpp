@@ -18,85 +18,35 @@
 #include "sde/debug_render.h"
 #include "sde/font_asset.h"
 #include "sde/job_system.h"
-#include "vox/model_ray_marcher.h"
 
 #include "particle_tests.h"
+#include "voxel_layout_benchmark.h"
+#include "voxel_brush_benchmark.h"
+#include "voxel_mesher_benchmark.h"
 
-struct ShotTest
+static glm::vec4 ImpactParticleColour(Materials mat)
 {
-	glm::vec3 m_center;
-	float m_radius;
-	void operator()(Vox::ModelAreaDataWriterParams<VoxelModel>& areaParams)
+	glm::vec4 particleColour(1.0f);
+	switch (mat)
 	{
-		for (int32_t vz = areaParams.StartVoxel().z; vz != areaParams.EndVoxel().z; ++vz)
-		{
-			for (int32_t vy = areaParams.StartVoxel().y; vy != areaParams.EndVoxel().y; ++vy)
-			{
-				for (int32_t vx = areaParams.StartVoxel().x; vx != areaParams.EndVoxel().x; ++vx)
-				{
-					const glm::vec3 vPos = areaParams.VoxelPosition(vx, vy, vz);
-					if (glm::distance(vPos, m_center) <= m_radius)
-					{
-						auto& voxel = areaParams.VoxelAt(vx, vy, vz);
-						if (voxel != static_cast<uint8_t>(Materials::Air))
-						{
-							uint8_t voxelDamage = GetVoxelDamage(voxel);
-							if (voxelDamage < 3)
-							{
-								voxelDamage++;
-								voxel = PackVoxel(GetVoxelMaterial(voxel), voxelDamage);
-							}
-							else if(GetVoxelMaterial(voxel) != Materials::OuterWall)
-							{
-								voxel = 0;
-							}
-						}
-					}
-				}
-			}
-		}
+	case Materials::OuterWall:
+		particleColour = glm::vec4(0.686f, 0.686f, 0.686f, 1.0f);
+		break;
+	case Materials::Walls:
+		particleColour = glm::vec4(0.581f, 0.315f, 0.231f, 1.0f);
+		break;
+	case Materials::Floor:
+		particleColour = glm::vec4(0.9f, 0.9f, 0.9f, 1.0f);
+		break;
+	case Materials::Carpet:
+		particleColour = glm::vec4(0.269f, 0.574f, 0.261f, 1.0f);
+		break;
+	case Materials::Pillars:
+		particleColour = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+		break;
 	}
-};
-
-struct RaymarchTester
-{
-	Floor* m_floor;
-	float m_radius;
-	AppSkeleton* m_app;
-	bool operator()(const Vox::ModelRaymarcherParams<VoxelModel>& params)
-	{
-		if (params.VoxelData() != 0)
-		{
-			auto mat = GetVoxelMaterial(params.VoxelData());
-			glm::vec4 particleColour(1.0f);
-			switch (mat)
-			{
-			case Materials::OuterWall:
-				particleColour = glm::vec4(0.686f, 0.686f, 0.686f, 1.0f);
-				break;
-			case Materials::Walls:
-				particleColour = glm::vec4(0.581f, 0.315f, 0.231f, 1.0f);
-				break;
-			case Materials::Floor:
-				particleColour = glm::vec4(0.9f, 0.9f, 0.9f, 1.0f);
-				break;
-			case Materials::Carpet:
-				particleColour = glm::vec4(0.269f, 0.574f, 0.261f, 1.0f);
-				break;
-			case Materials::Pillars:
-				particleColour = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
-				break;
-			}
-			m_app->SpawnParticlesAt(params.VoxelPosition(), particleColour);
-			ShotTest shot;
-			shot.m_radius = m_radius;
-			shot.m_center = params.VoxelPosition();
-			m_floor->ModifyData(Math::Box3(shot.m_center - shot.m_radius, shot.m_center + shot.m_radius), shot);
-			return false;
-		}
-		return true;	// Keep going
-	}
-};
+	return particleColour;
+}
 
 void AppSkeleton::InitialiseFloor(std::shared_ptr<Assets::Asset>& materialAsset)
 {
@@ -111,21 +61,19 @@ void AppSkeleton::InitialiseFloor(std::shared_ptr<Assets::Asset>& materialAsset)
 		glm::vec4(1.0f,1.0f,1.0f,1.0f)	// Outerwall
 	};
 	const uint8_t c_maxMaterials = (uint8_t)(sizeof(baseColours) / sizeof(baseColours[0]));
+	// Meshes only use the undamaged materials, the floor shader darkens damaged voxels from the damage lookup
 	for (uint8_t m = 0; m < c_maxMaterials; ++m)
 	{
-		for (uint8_t dmg = 0; dmg < 4; ++dmg)
-		{
-			VoxelMaterial mat;
-			float dmgColourMod = 0.5f + (0.5f * ((float)(3 - dmg) / 3.0f));
-			mat.Colour() = dmgColourMod * baseColours[m];
-			mat.TextureIndex() = (float)m;
-			floorMaterials.SetMaterial(PackVoxel(static_cast<Materials>(m + 1), dmg), mat);
-		}
+		VoxelMaterial mat;
+		mat.Colour() = baseColours[m];
+		mat.TextureIndex() = (float)m;
+		floorMaterials.SetMaterial(PackVoxel(static_cast<Materials>(m + 1), 0), mat);
 	}
 	floorMaterials.SetRenderMaterialAsset(materialAsset);
 
 	m_testFloor = std::make_unique<Floor>();
 	m_testFloor->Create(m_jobSystem, floorMaterials, glm::vec3(128.0f, 8.0f, 128.0f), 16);
+	m_shots.Create(m_jobSystem, m_testFloor.get());
 
 //	// We now populate the world data, then save it
 //	TestRoomBuilder valFiller;
@@ -135,6 +83,11 @@ void AppSkeleton::InitialiseFloor(std::shared_ptr<Assets::Asset>& materialAsset)
 //	m_testFloor->ModifyDataAndSave(Math::Box3(glm::vec3(0.0f), glm::vec3(128.0f, 8.0f, 128.0f)), valFiller, "models/test_big.vox");
 //#endif
 
+//	// Compare block layouts (see VoxelBlockLayout), the brush kernels against the old shot edit and the two meshers
+//	VoxelLayoutBenchmark::Run("models/test_big.vox");
+//	VoxelBrushBenchmark::Run("models/test_big.vox");
+//	VoxelMesherBenchmark::Run("models/test_big.vox");
+
 #ifdef SDE_DEBUG
 	m_testFloor->LoadFile("models/test.vox");
 #else
@@ -240,7 +193,7 @@ bool AppSkeleton::PostInit()
 	m_camera.SetFOVAndAspectRatio(70.0f, (float)c_windowWidth / (float)c_windowHeight);
 
 	// load material, on completion, create the floor
-	m_assetSystem->LoadAsset("simple_diffuse_material", [this](const std::string& asset, bool result)
+	m_assetSystem->LoadAsset("voxel_floor_material", [this](const std::string& asset, bool result)
 	{
 		if (result)
 		{
@@ -268,49 +221,38 @@ bool AppSkeleton::Tick()
 	m_debugCameraController->Update(*m_inputSystem->ControllerState(0), 0.016);
 	m_debugCameraController->ApplyToCamera(m_camera);
 
-	// Update world
+	// Update world. Shots resolved since last frame are applied first so their edits go out with this update
 	if (m_testFloor != nullptr)
 	{
-		m_testFloor->Update();
+		m_shots.ApplyResults([this](const glm::vec3& position, Materials material)
+		{
+			SpawnParticlesAt(position, ImpactParticleColour(material));
+		});
+		m_testFloor->Update(m_camera);
 		m_testFloor->DisplayDebugGui(*m_debugGui);
 	}
 
-	if ((m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::RightShoulder)
-		|| m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::LeftShoulder)
+	if (m_testFloor != nullptr && ((m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::RightShoulder)
+		|| m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::LeftShoulder))
 	{
-		RaymarchTester filler;
-		filler.m_app = this;
-		filler.m_floor = m_testFloor.get();
-
-		uint32_t pellets = 0; 
-		float jitterMax = 0.0f;
+		ShotPipeline::ShotRequest shot;
+		shot.m_origin = m_camera.Position();
+		shot.m_direction = glm::normalize(m_camera.Target() - m_camera.Position());
+		shot.m_range = 128.0f;
+		shot.m_seed = (uint32_t)rand();
 		if (m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::RightShoulder)
 		{
-			pellets = 10 + rand() % 10;
-			jitterMax = 0.25;
-			filler.m_radius = 0.25f * ((float)rand() / (float)RAND_MAX);
+			shot.m_pellets = 10 + rand() % 10;
+			shot.m_spread = 0.25;
+			shot.m_damageRadius = 0.25f * ((float)rand() / (float)RAND_MAX);
 		}
 		else
 		{
-			pellets = 2 + rand() % 8;
-			jitterMax = 0.1f;
-			filler.m_radius = 0.125f * ((float)rand() / (float)RAND_MAX);
-		}
-
-		for (uint32_t p = 0; p < pellets; ++p)
-		{
-			const glm::vec3 cameraPos = m_camera.Position();
-			const glm::vec3 cameraTarget = m_camera.Target();
-			const glm::vec3 cameraDir = glm::normalize(cameraTarget - cameraPos);
-			glm::vec3 jitter = glm::vec3(jitterMax * ((float)rand() / (float)RAND_MAX),
-				jitterMax * ((float)rand() / (float)RAND_MAX),
-				jitterMax * ((float)rand() / (float)RAND_MAX));
-			jitter -= jitterMax * 0.5f;
-			const glm::vec3 rayEndPos = glm::normalize(cameraDir + jitter) * 128.0f;
-
-			Vox::ModelRaymarcher<VoxelModel> rayMarcher(m_testFloor->GetModel());
-			rayMarcher.Raymarch(cameraPos, cameraPos + rayEndPos, filler);
+			shot.m_pellets = 2 + rand() % 8;
+			shot.m_spread = 0.1f;
+			shot.m_damageRadius = 0.125f * ((float)rand() / (float)RAND_MAX);
 		}
+		m_shots.Fire(shot);
 	}
 
 	if ((m_inputSystem->ControllerState(0)->m_buttonState & Input::ControllerButtons::Start))
@@ -365,6 +307,7 @@ void AppSkeleton::Shutdown()
 {	
 	m_pointRender = nullptr;
 	m_debugRender = nullptr;
+	m_shots.Destroy();
 	m_testFloor = nullptr;
 	m_debugCameraController = nullptr;
 }
\ No newline at end of file
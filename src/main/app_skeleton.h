@@ -2,6 +2,7 @@
 
 #include "voxel_definitions.h"
 #include "floor.h"
+#include "shot_pipeline.h"
 #include "pointsprite_particle_renderer.h"
 #include "core/system.h"
 #include "sde/debug_camera_controller.h"
@@ -51,6 +52,7 @@ private:
 	std::shared_ptr<PointSpriteParticleRenderer> m_pointRender;
 	std::unique_ptr<SDE::DebugRender> m_debugRender;
 	std::unique_ptr<Floor> m_testFloor;
+	ShotPipeline m_shots;
 	std::unique_ptr<SDE::DebugCameraController> m_debugCameraController;
 	Render::Camera m_camera;
 	SDE::RenderSystem* m_renderSystem;
@@ -2,24 +2,77 @@
 #include "sde/job_system.h"
 #include "render/mesh.h"
 #include "render/material_asset.h"
-#include "render/mesh_builder.h"
 #include "render/render_pass.h"
 #include "render/camera.h"
 #include "math/intersections.h"
-#include "voxel_mesh_builder.h"
 #include "voxel_material.h"
-#include "voxel_model_serialiser.h"
-#include "vox_model_loader.h"
+#include "voxel_raymarcher.h"
+#include "voxel_block_allocator.h"
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <thread>
 
 static const glm::vec3 c_floorTotalSize(128.0f);
+static const int32_t c_maxRemeshJobsInFlight = 8;		// Max. remesh jobs running at once
+static const uint32_t c_maxRemeshChunksPerFrame = 64;	// Max. chunks to dispatch for meshing per frame
+static const size_t c_maxJournalBytes = 1024 * 1024;	// Journals larger than this get folded back into the model file
+static const uint32_t c_coldScanIntervalSeconds = 1;	// How often we look for blocks to move to the cold tier
+static const uint32_t c_raycastPacketsPerJob = 16;		// Raycast batches bigger than this are shared with the job system
+static const uint32_t c_maxRaycastJobs = 8;
+
+inline std::string JournalPath(const std::string& modelFilename)
+{
+	return modelFilename + ".journal";
+}
+
+inline bool FileExists(const std::string& filename)
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename.c_str(), "rb") == 0 && file != nullptr)
+	{
+		fclose(file);
+		return true;
+	}
+	return false;
+}
+
+// Kernel atomics only give us CAS, so we build the bitmask operations on top
+inline void AtomicOrBits(Kernel::AtomicInt32& value, uint32_t bits)
+{
+	int32_t current = value.Get();
+	while (!value.CAS(current, current | (int32_t)bits))
+	{
+		current = value.Get();
+	}
+}
+
+inline uint32_t AtomicTakeBits(Kernel::AtomicInt32& value)
+{
+	int32_t current = value.Get();
+	while (!value.CAS(current, 0))
+	{
+		current = value.Get();
+	}
+	return (uint32_t)current;
+}
 
 Floor::Floor()
 	: m_sectionsPerSide(0)
+	, m_chunkCount(0)
 	, m_isSaving(0)
 	, m_isLoading(0)
 	, m_totalWritesPending(0)
+	, m_remeshJobsInFlight(0)
+	, m_raycastsInFlight(0)
+	, m_saveJobsInFlight(0)
 	, m_loadInProgress(0)
 	, m_totalVbBytes(0)
+	, m_uploadCameraPos(0.0f)
+	, m_startTicks(0)
+	, m_lastColdScan(0)
+	, m_coldIdleSeconds(60)
+	, m_warmBudgetBytes(32 * 1024 * 1024)
 {
 }
 
@@ -35,7 +88,9 @@ Floor::SectionDesc& Floor::GetSection(int32_t x, int32_t z)
 
 void Floor::DisplayDebugGui(DebugGui::DebugGuiSystem& gui)
 {
-	m_stats.UpdateStats(m_totalBounds, m_sectionSize, m_totalWritesPending.Get(), m_totalVbBytes.Get(), m_voxelData.TotalVoxelMemory());
+	m_stats.UpdateStats(m_totalBounds, m_sectionSize, m_totalWritesPending.Get(), m_totalVbBytes.Get(), m_voxelData.TotalVoxelMemory(), m_saveSnapshot.ClonedBlockBytes(),
+		m_uploadScheduler.QueueDepth(), m_uploadScheduler.LastFrameBytes(), VoxelBlockAllocator::GetStats(),
+		m_voxelData.WarmVoxelMemory(), m_warmBudgetBytes, m_voxelData.GetStorageStats());
 	m_stats.DisplayDebugGui(gui);
 }
 
@@ -54,15 +109,34 @@ void Floor::Create(SDE::JobSystem* jobSystem, VoxelMaterialSet& materials, const
 	m_sectionSize.y = floorSize.y;
 	m_sectionsPerSide = sectionDimensions;
 	m_materials = materials;
-	m_sections.resize(sectionDimensions * sectionDimensions);
+	m_sections.reset(new SectionDesc[sectionDimensions * sectionDimensions]);
 	m_voxelData.SetVoxelSize(glm::vec3(0.125f));	// All floors have constant voxel density of 8/meter
+	m_voxelData.SetPaletteCompression(true);		// Floors only use a handful of materials/damage levels per block
+	VoxelBlockAllocator::UseHugePages(true);		// Floors keep thousands of blocks resident, so save on TLB misses
 	m_jobSystem = jobSystem;
+	m_meshScratch.Create([this]()
+	{
+		return std::make_unique<FloorMeshScratch>(m_voxelData);
+	});
+	m_loaderScratch.Create([]()
+	{
+		return std::make_unique<VoxelModelLoader<VoxelModel>>();
+	});
+	m_serialiserScratch.Create([]()
+	{
+		return std::make_unique<VoxelModelSerialiser<VoxelModel>>();
+	});
 
-	// setup the mesh materials
-	auto renderAsset = materials.GetRenderMaterialAsset();
-	Render::MaterialAsset* mat = static_cast<Render::MaterialAsset*>(renderAsset.get());
+	// Each section is split into chunks the same size as the voxel model blocks
+	m_chunkSize = m_voxelData.GetVoxelSize() * (float)VoxelModel::BlockType::VoxelDimensions;
+	m_chunksPerSection = glm::ivec3(glm::ceil(m_sectionSize / m_chunkSize));
+	m_chunkCount = m_chunksPerSection.x * m_chunksPerSection.y * m_chunksPerSection.z;
+	SDE_ASSERT(m_chunkCount <= 32, "Too many chunks per section for the dirty mask");
+	SDE_ASSERT(glm::floor(m_sectionSize / m_chunkSize) == m_sectionSize / m_chunkSize, "Chunks must line up with the model blocks");
 
 	// setup the section descriptors
+	m_chunkBounds.Clear();
+	m_chunkBounds.Reserve(sectionDimensions * sectionDimensions * m_chunkCount);
 	for (int32_t z = 0; z < sectionDimensions; ++z)
 	{
 		for (int32_t x = 0; x < sectionDimensions; ++x)
@@ -70,128 +144,599 @@ void Floor::Create(SDE::JobSystem* jobSystem, VoxelMaterialSet& materials, const
 			auto& theSection = GetSection(x, z);
 			const glm::vec3 boundsMin(x * m_sectionSize.x, 0.0f, z * m_sectionSize.z);
 			theSection.m_bounds = Math::Box3(boundsMin, boundsMin + m_sectionSize);
-			theSection.m_renderMesh.SetMaterial(mat->GetMaterial());
+			theSection.m_chunkMeshes.resize(m_chunkCount);
+			theSection.m_chunkDamage.resize(m_chunkCount);
+			theSection.m_chunkLodMeshes.resize(m_chunkCount * (VoxelLod::c_lodCount - 1));
+			theSection.m_chunkDrawnLod.resize(m_chunkCount, 0);
+			theSection.m_lod = 0;
+			theSection.m_nextLod = 0;
+			std::fill(std::begin(theSection.m_staleLodChunks), std::end(theSection.m_staleLodChunks), 0);
+			std::fill(std::begin(theSection.m_readyLodChunks), std::end(theSection.m_readyLodChunks), 0);
+			theSection.m_editsSubmitted = 0;
+			theSection.m_editsApplied.Set(0);
+			theSection.m_saveEditTarget = 0;
+			theSection.m_repackRequested.Set(0);
+			theSection.m_coldChunks.Set(0);
+		}
+	}
+
+	// chunk bounds are stored in section order, so the culling results index straight into the sections
+	for (int32_t s = 0; s < sectionDimensions * sectionDimensions; ++s)
+	{
+		for (uint32_t c = 0; c < m_chunkCount; ++c)
+		{
+			m_chunkBounds.AddBox(ChunkBounds(m_sections[s], c));
 		}
 	}
 
-	// We get away with being lockless by ensuring the voxel model data *structure*
-	// does not change during async calls (i.e. no new blocks should be allocated)
+	// This only builds the block table, blocks are stored as a single value until they are written to.
+	// The table itself must not change during async calls, expanding/compacting blocks is fine
 	m_voxelData.PreallocateMemory(m_totalBounds);
+	m_saveSnapshot.Create(m_voxelData);
+	m_meshResults.Create(sectionDimensions * sectionDimensions * m_chunkCount);
+	m_startTicks = m_timer.GetTicks();
+	m_lastColdScan = 0;
 }
 
 void Floor::Destroy()
 {
-	m_sections.clear();
-	m_voxelData = VoxelModel();
+	m_frameEdits.clear();
+	m_uploadScheduler.Clear();
+	m_meshResults.Destroy();
+	m_meshScratch.Destroy();
+	m_loaderScratch.Destroy();
+	m_serialiserScratch.Destroy();
+	m_sections = nullptr;
+	m_voxelData.RemoveAllBlocks();
 }
 
-void Floor::RebuildDirtyMeshes()
+void Floor::SetUploadBudget(size_t maxBytesPerFrame, double maxSecondsPerFrame)
 {
-	// we move the entire result data out, so we keep the lock for as little time
-	// as possible
-	std::unordered_map<int32_t, Render::MeshBuilder> buildResults;
+	m_uploadScheduler.SetBudget(maxBytesPerFrame, maxSecondsPerFrame);
+}
+
+void Floor::SetColdStorage(uint32_t idleSeconds, size_t warmBudgetBytes)
+{
+	m_coldIdleSeconds = idleSeconds;
+	m_warmBudgetBytes = warmBudgetBytes;
+}
+
+float Floor::MeshDistance(uint32_t meshIndex) const
+{
+	Math::Box3 chunkBounds = m_chunkBounds.GetBox(meshIndex);
+	return glm::distance(m_uploadCameraPos, glm::clamp(m_uploadCameraPos, chunkBounds.Min(), chunkBounds.Max()));
+}
+
+size_t Floor::UploadMesh(uint32_t meshIndex)
+{
+	// A newer result may have replaced the one we were scheduled for, that's fine, we upload the latest
+	FloorMeshResults::Result* result = m_meshResults.Consume(meshIndex);
+	if (result == nullptr)
 	{
-		Kernel::ScopedMutex lock(m_updatedMeshesLock);
-		buildResults = std::move(m_updatedMeshes);
+		return 0;
 	}
 
-	// now we're safe to remesh the results
-	for (auto& it : buildResults)
+	// Empty chunks release their meshes entirely
+	auto& section = m_sections[meshIndex / m_chunkCount];
+	const uint32_t chunkIndex = meshIndex % m_chunkCount;
+	size_t bytesUploaded = 0;
+	for (uint32_t lod = 0; lod < VoxelLod::c_lodCount; ++lod)
 	{
-		// Rebuild the section index
-		int32_t sectionX = it.first % m_sectionsPerSide;
-		int32_t sectionY = (it.first - sectionX) / m_sectionsPerSide;
+		if (result->m_lodMask & (1u << lod))
+		{
+			section.m_readyLodChunks[lod] |= 1u << chunkIndex;
+		}
+	}
+	for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		if (result->m_lodMask & (1u << lod))
+		{
+			auto& lodMesh = section.m_chunkLodMeshes[(chunkIndex * (VoxelLod::c_lodCount - 1)) + lod - 1];
+			bytesUploaded += ReplaceChunkMesh(lodMesh, result->m_lodVertices[lod - 1]);
+		}
+	}
+	if ((result->m_lodMask & 1) == 0)
+	{
+		m_meshResults.Recycle(meshIndex, result);
+		return bytesUploaded;
+	}
+	auto& chunkMesh = section.m_chunkMeshes[chunkIndex];
+	bytesUploaded += ReplaceChunkMesh(chunkMesh, result->m_vertices);
 
-		auto& section = GetSection(sectionX, sectionY);
+	// Quads merge across damage levels, the shader reads the damage for each voxel from this
+	auto& chunkDamage = section.m_chunkDamage[chunkIndex];
+	chunkDamage = nullptr;
+	if (chunkMesh != nullptr && !result->m_damage.IsEmpty())
+	{
+		chunkDamage = std::make_unique<Render::Texture>();
+		if (VoxelMeshBuilder::CreateDamageTexture(result->m_damage, *chunkDamage))
+		{
+			bytesUploaded += result->m_damage.Data().size();
+		}
+		else
+		{
+			chunkDamage = nullptr;
+		}
+	}
+	m_meshResults.Recycle(meshIndex, result);
 
-		m_totalVbBytes.Add(-(int32_t)section.m_renderMesh.TotalVertexBufferBytes());
+	return bytesUploaded;
+}
 
-		// Update the section render mesh
-		it.second.CreateMesh(section.m_renderMesh, 1024 * 32);
+size_t Floor::ReplaceChunkMesh(std::unique_ptr<Render::Mesh>& chunkMesh, const std::vector<PackedVoxelVertex>& vertices)
+{
+	if (chunkMesh != nullptr)
+	{
+		m_totalVbBytes.Add(-(int32_t)chunkMesh->TotalVertexBufferBytes());
+		chunkMesh = nullptr;
+	}
+	if (vertices.empty())
+	{
+		return 0;
+	}
+
+	// The buffers are sized for the data, so each upload gets a new mesh
+	auto renderAsset = m_materials.GetRenderMaterialAsset();
+	Render::MaterialAsset* mat = static_cast<Render::MaterialAsset*>(renderAsset.get());
+	chunkMesh = std::make_unique<Render::Mesh>();
+	chunkMesh->SetMaterial(mat->GetMaterial());
+	if (!VoxelMeshBuilder::CreateMesh(vertices, *chunkMesh))
+	{
+		chunkMesh = nullptr;
+		return 0;
+	}
+	const size_t bytesUploaded = chunkMesh->TotalVertexBufferBytes();
+	m_totalVbBytes.Add((int32_t)bytesUploaded);
+	return bytesUploaded;
+}
 
-		m_totalVbBytes.Add((int32_t)section.m_renderMesh.TotalVertexBufferBytes());
+Render::Mesh* Floor::ChunkMesh(const SectionDesc& section, uint32_t chunkIndex, uint32_t lod) const
+{
+	if (lod == 0)
+	{
+		return section.m_chunkMeshes[chunkIndex].get();
+	}
+	return section.m_chunkLodMeshes[(chunkIndex * (VoxelLod::c_lodCount - 1)) + lod - 1].get();
+}
+
+void Floor::RebuildDirtyMeshes(const glm::vec3& cameraPos)
+{
+	// Jobs flag the chunks they published results for, they wait in the result slots until uploaded
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		auto& section = m_sections[s];
+		if (section.m_meshResultChunks.Get() == 0)
+		{
+			continue;
+		}
+		const uint32_t resultChunks = AtomicTakeBits(section.m_meshResultChunks);
+		for (uint32_t chunkIndex = 0; chunkIndex < m_chunkCount; ++chunkIndex)
+		{
+			if (resultChunks & (1 << chunkIndex))
+			{
+				m_uploadScheduler.AddPending((s * m_chunkCount) + chunkIndex);
+			}
+		}
+	}
+
+	m_uploadCameraPos = cameraPos;
+	m_uploadScheduler.UploadPending(*this);
+}
+
+uint32_t Floor::ChunkMaskForBounds(const SectionDesc& section, const Math::Box3& bounds, const glm::vec3& margin) const
+{
+	const glm::vec3 localMin = glm::max(bounds.Min() - margin - section.m_bounds.Min(), glm::vec3(0.0f));
+	const glm::vec3 localMax = glm::min(bounds.Max() + margin - section.m_bounds.Min(), m_sectionSize);
+	const glm::ivec3 chunkMin = glm::floor(localMin / m_chunkSize);
+	const glm::ivec3 chunkMax = glm::min(glm::ivec3(glm::ceil(localMax / m_chunkSize)), m_chunksPerSection);
+
+	uint32_t mask = 0;
+	for (int32_t cz = chunkMin.z; cz < chunkMax.z; ++cz)
+	{
+		for (int32_t cy = chunkMin.y; cy < chunkMax.y; ++cy)
+		{
+			for (int32_t cx = chunkMin.x; cx < chunkMax.x; ++cx)
+			{
+				mask |= 1 << (cx + (cy * m_chunksPerSection.x) + (cz * m_chunksPerSection.x * m_chunksPerSection.y));
+			}
+		}
+	}
+	return mask;
+}
+
+glm::ivec3 Floor::ChunkBlockIndex(const SectionDesc& section, uint32_t chunkIndex) const
+{
+	// Chunks match the model blocks, so the block containing the chunk center is the one
+	const Math::Box3 chunkBounds = ChunkBounds(section, chunkIndex);
+	const glm::vec3 chunkCenter = (chunkBounds.Min() + chunkBounds.Max()) * 0.5f;
+	glm::ivec3 blockStart, blockEnd;
+	m_voxelData.GetBlockIterationParameters(Math::Box3(chunkCenter, chunkCenter), blockStart, blockEnd);
+	return blockStart;
+}
+
+int32_t Floor::SectionIndexForBlock(const glm::ivec3& blockIndex) const
+{
+	const glm::vec3 blockCenter = (glm::vec3(blockIndex) + 0.5f) * m_chunkSize;
+	if (glm::any(glm::lessThan(blockCenter, m_totalBounds.Min())) || glm::any(glm::greaterThanEqual(blockCenter, m_totalBounds.Max())))
+	{
+		return -1;
+	}
+	const glm::ivec3 section = glm::floor(blockCenter / m_sectionSize);
+	return section.x + (section.z * m_sectionsPerSide);
+}
+
+void Floor::TakeUnsavedBlocks(std::vector<glm::ivec3>& blocks)
+{
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		auto& section = m_sections[s];
+		const uint32_t unsavedChunks = AtomicTakeBits(section.m_unsavedChunks);
+		for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
+		{
+			if (unsavedChunks & (1 << chunk))
+			{
+				blocks.push_back(ChunkBlockIndex(section, chunk));
+			}
+		}
 	}
 }
 
-void Floor::AddSectionMeshResult(int32_t x, int32_t z, Render::MeshBuilder& result)
+void Floor::RestoreUnsavedBlocks(const std::vector<glm::ivec3>& blocks)
 {
-	int32_t sectionResultIndex = x + (z * m_sectionsPerSide);
+	for (const auto& blockIndex : blocks)
 	{
-		Kernel::ScopedMutex lock(m_updatedMeshesLock);
-		m_updatedMeshes[sectionResultIndex] = std::move(result);
+		const int32_t sectionIndex = SectionIndexForBlock(blockIndex);
+		if (sectionIndex < 0)
+		{
+			continue;
+		}
+		auto& section = m_sections[sectionIndex];
+		for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
+		{
+			if (ChunkBlockIndex(section, chunk) == blockIndex)
+			{
+				AtomicOrBits(section.m_unsavedChunks, 1 << chunk);
+			}
+		}
 	}
 }
 
-void Floor::RemeshSection(int32_t x, int32_t z)
+Math::Box3 Floor::ChunkBounds(const SectionDesc& section, uint32_t chunkIndex) const
+{
+	const int32_t cx = chunkIndex % m_chunksPerSection.x;
+	const int32_t cy = (chunkIndex / m_chunksPerSection.x) % m_chunksPerSection.y;
+	const int32_t cz = chunkIndex / (m_chunksPerSection.x * m_chunksPerSection.y);
+	const glm::vec3 chunkMin = section.m_bounds.Min() + (glm::vec3((float)cx, (float)cy, (float)cz) * m_chunkSize);
+	return Math::Box3(chunkMin, glm::min(chunkMin + m_chunkSize, section.m_bounds.Max()));
+}
+
+void Floor::RemeshSection(int32_t x, int32_t z, uint32_t dirtyChunks, uint32_t lodMask)
 {
 	SDE_ASSERT(x >= 0 && x < m_sectionsPerSide);
 	SDE_ASSERT(z >= 0 && z < m_sectionsPerSide);
 
 	// This assumes nobody else is touching this section, be careful!
 	auto& thisSection = GetSection(x, z);
-	
-	// We basically do everything but actually update the gpu data (it must happen in the main thread)
-	Render::MeshBuilder meshBuilder;
-	VoxelMeshBuilder voxelMeshBuilder;
-
-	voxelMeshBuilder.BuildMeshData(m_voxelData, m_materials, thisSection.m_bounds, meshBuilder);
 
-	if (meshBuilder.HasData())
+	// We basically do everything but actually update the gpu data (it must happen in the main thread)
+	// Empty results are still passed on so the old chunk mesh gets removed
+	auto scratch = m_meshScratch.Borrow();
+	const uint32_t firstResultSlot = (x + (z * m_sectionsPerSide)) * m_chunkCount;
+	for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
 	{
-		AddSectionMeshResult(x, z, meshBuilder);
+		if (dirtyChunks & (1 << chunk))
+		{
+			FloorMeshResults::Result* result = m_meshResults.Acquire(firstResultSlot + chunk);
+			const Math::Box3 chunkBounds = ChunkBounds(thisSection, chunk);
+			result->m_lodMask = lodMask;
+			if (lodMask & 1)
+			{
+				scratch->m_meshBuilder.BuildMeshData(m_materials, chunkBounds, result->m_vertices, result->m_damage);
+			}
+			scratch->m_meshBuilder.BuildLodMeshData(m_materials, chunkBounds, lodMask, result->m_lodVertices);
+			m_meshResults.Publish(firstResultSlot + chunk, result);
+			AtomicOrBits(thisSection.m_meshResultChunks, 1 << chunk);
+		}
 	}
 }
 
-void Floor::SubmitRemeshJob(const Math::Box3& updateBounds, int32_t x, int32_t z)
+void Floor::RequestRemesh(SectionDesc& section, uint32_t dirtyChunks)
+{
+	// The scheduler picks the request up on the main thread
+	AtomicOrBits(section.m_dirtyChunks, dirtyChunks);
+	section.m_remeshRequested.Set(1);
+}
+
+void Floor::SubmitRemeshJob(int32_t x, int32_t z)
 {
-	auto updateJob = [this, updateBounds, x, z]
+	auto& thisSection = GetSection(x, z);
+	thisSection.m_remeshRequested.Set(0);		// Any requests from now on will need another job
+	thisSection.m_remeshInFlight.Set(1);
+	m_remeshJobsInFlight.Add(1);
+
+	// Only the levels the section draws now or will switch to next are built, the rest go stale until they are wanted.
+	// Meshes at built levels stay drawable until the new ones are uploaded
+	const uint32_t dirtyChunks = AtomicTakeBits(thisSection.m_dirtyChunks);
+	const uint32_t lodMask = (1u << thisSection.m_lod) | (1u << thisSection.m_nextLod);
+	for (uint32_t lod = 0; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		if (lodMask & (1u << lod))
+		{
+			thisSection.m_staleLodChunks[lod] &= ~dirtyChunks;
+		}
+		else
+		{
+			thisSection.m_staleLodChunks[lod] |= dirtyChunks;
+			thisSection.m_readyLodChunks[lod] &= ~dirtyChunks;
+		}
+	}
+
+	auto updateJob = [this, x, z, dirtyChunks, lodMask]
 	{
 		auto& thisSection = GetSection(x, z);
-		RemeshSection(x, z);
+		{
+			VoxelModel::ReadScope readScope(m_voxelData);
+			RemeshSection(x, z, dirtyChunks, lodMask);
+		}
+		thisSection.m_remeshInFlight.Set(0);
+		m_remeshJobsInFlight.Add(-1);
 	};
 
- 	m_jobSystem->PushJob(updateJob);
+ 	m_jobSystem->PushJob(updateJob, "Floor::Remesh");
 }
 
-void Floor::SubmitUpdateJob(const Math::Box3& updateBounds, int32_t x, int32_t z, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& iterator)
+void Floor::ScheduleRemeshJobs(const Render::Camera& camera)
 {
-	auto updateJob = [this, updateBounds, iterator, x, z]
+	int32_t jobsAvailable = c_maxRemeshJobsInFlight - m_remeshJobsInFlight.Get();
+	if (jobsAvailable <= 0)
 	{
-		auto& thisSection = GetSection(x, z);
+		return;
+	}
 
-		if (!thisSection.m_updateJobCounter.CAS(0,1))	// If there are update jobs currently running, we wait
+	// Gather all sections waiting to be meshed. Sections already being meshed wait for the
+	// current job to finish so results always arrive in order
+	const glm::vec3 cameraPos = camera.Position();
+	m_remeshCandidates.clear();
+	bool anyVisible = false;
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		auto& section = m_sections[s];
+		if (section.m_remeshRequested.Get() == 1 && section.m_remeshInFlight.Get() == 0)
 		{
-			thisSection.m_updatesPending.Add(-1);
-			m_totalWritesPending.Add(-1);
-			SubmitUpdateJob(updateBounds, x, z, iterator);
+			const uint32_t dirtyChunks = (uint32_t)section.m_dirtyChunks.Get();
+			uint32_t chunkCount = 0;
+			for (uint32_t c = 0; c < m_chunkCount; ++c)
+			{
+				chunkCount += (dirtyChunks >> c) & 1;
+			}
+
+			RemeshCandidate candidate;
+			candidate.m_sectionIndex = s;
+			candidate.m_chunkCount = chunkCount;
+			candidate.m_distance = glm::distance(cameraPos, glm::clamp(cameraPos, section.m_bounds.Min(), section.m_bounds.Max()));
+			candidate.m_visible = m_culler.IsVisible(section.m_bounds);
+			anyVisible |= candidate.m_visible;
+			m_remeshCandidates.push_back(candidate);
 		}
-		else
+	}
+
+	// Off-screen sections are deferred until they become visible. When there is no visible
+	// work left we let them use up the spare budget, so turning around doesn't show stale meshes
+	if (anyVisible)
+	{
+		m_remeshCandidates.erase(std::remove_if(m_remeshCandidates.begin(), m_remeshCandidates.end(), [](const RemeshCandidate& c)
 		{
+			return !c.m_visible;
+		}), m_remeshCandidates.end());
+	}
+
+	// Nearest first
+	std::sort(m_remeshCandidates.begin(), m_remeshCandidates.end(), [](const RemeshCandidate& c0, const RemeshCandidate& c1)
+	{
+		return c0.m_distance < c1.m_distance;
+	});
+
+	// Dispatch until we run out of jobs or chunk budget for this frame. We always dispatch at least
+	// one section, otherwise a single huge request would never fit
+	uint32_t chunksDispatched = 0;
+	for (const auto& candidate : m_remeshCandidates)
+	{
+		if (jobsAvailable <= 0 || (chunksDispatched > 0 && chunksDispatched + candidate.m_chunkCount > c_maxRemeshChunksPerFrame))
+		{
+			break;
+		}
+		SubmitRemeshJob(candidate.m_sectionIndex % m_sectionsPerSide, candidate.m_sectionIndex / m_sectionsPerSide);
+		chunksDispatched += candidate.m_chunkCount;
+		--jobsAvailable;
+	}
+}
+
+void Floor::SubmitDrainJob(int32_t x, int32_t z)
+{
+	auto drainJob = [this, x, z]
+	{
+		VoxelModel::ReadScope readScope(m_voxelData);
+		auto& thisSection = GetSection(x, z);
+		do
+		{
+			// Apply everything queued against this section in submission order, then request one remesh
 			Vox::ModelAreaDataWriter<VoxelModel> areaWriter(m_voxelData);
-			areaWriter.WriteArea(updateBounds, iterator);
+			int32_t editsApplied = 0;
+			uint32_t editsDrained = 0;
+			uint32_t dirtyChunks = 0, unsavedChunks = 0, repackChunks = 0, coldChunks = 0;
+			do
+			{
+				int32_t realEdits = 0;
+				editsDrained = thisSection.m_pendingEdits.Drain([this, &thisSection, &areaWriter, &dirtyChunks, &unsavedChunks, &repackChunks, &coldChunks, &realEdits](const FloorEditQueue::Edit& edit)
+				{
+					// Repack requests have no callback, they don't change anything
+					if (!edit.m_callback)
+					{
+						repackChunks = (1u << m_chunkCount) - 1;
+						coldChunks |= AtomicTakeBits(thisSection.m_coldChunks);
+						return;
+					}
+					++realEdits;
+
+					// Blocks frozen for a save are cloned before we write to them. We use a voxel of margin
+					// to be safe, and since faces on the edge of a neighbouring chunk can change we remesh those too
+					const uint32_t touchedChunks = ChunkMaskForBounds(thisSection, edit.m_bounds, m_voxelData.GetVoxelSize());
+					for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
+					{
+						if (touchedChunks & (1 << chunk))
+						{
+							m_saveSnapshot.BeginWrite(ChunkBlockIndex(thisSection, chunk));
+						}
+					}
+					areaWriter.WriteArea(edit.m_bounds, edit.m_callback);
+					for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
+					{
+						if (touchedChunks & (1 << chunk))
+						{
+							m_saveSnapshot.EndWrite(ChunkBlockIndex(thisSection, chunk));
+						}
+					}
+					dirtyChunks |= touchedChunks;
+					unsavedChunks |= ChunkMaskForBounds(thisSection, edit.m_bounds, glm::vec3(0.0f));
+				});
+				thisSection.m_editsApplied.Add(realEdits);
+				editsApplied += editsDrained;
+			} while (editsDrained > 0);
 
-			if (thisSection.m_updatesPending.Add(-1) == 1)	// If pending updates = 1, that's us, so we will now remesh
+			// Blocks go back to being a single value (i.e. all air) or a palette where possible.
+			// Anything we just wrote to is clearly not cold any more
+			coldChunks &= ~dirtyChunks;
+			for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
 			{
-				RemeshSection(x, z);
+				if (unsavedChunks & (1 << chunk))
+				{
+					m_voxelData.UpdateOccupancy(ChunkBlockIndex(thisSection, chunk));
+				}
+				if (coldChunks & (1 << chunk))
+				{
+					m_voxelData.CompressBlock(ChunkBlockIndex(thisSection, chunk));
+				}
+				else if ((unsavedChunks | repackChunks) & (1 << chunk))
+				{
+					m_voxelData.CompactBlock(ChunkBlockIndex(thisSection, chunk));
+				}
 			}
 
-			thisSection.m_updateJobCounter.Add(-1);	// we're done, someone else can update data now
-			m_totalWritesPending.Add(-1);
-		}
+			AtomicOrBits(thisSection.m_unsavedChunks, unsavedChunks);
+			RequestRemesh(thisSection, dirtyChunks);
+			m_totalWritesPending.Add(-editsApplied);
+			thisSection.m_drainJobActive.Set(0);
+
+			// An edit may have been pushed after the last drain, but before we released the section.
+			// Its producer saw us as active, so we are responsible for picking it up
+		} while (!thisSection.m_pendingEdits.IsEmpty() && thisSection.m_drainJobActive.CAS(0, 1));
 	};
 
+	m_jobSystem->PushJob(drainJob, "Floor::DrainEdits");
+}
+
+void Floor::SubmitUpdateJob(const Math::Box3& updateBounds, int32_t x, int32_t z, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& iterator)
+{
+	auto& thisSection = GetSection(x, z);
 	m_totalWritesPending.Add(1);
-	GetSection(x, z).m_updatesPending.Add(1);		// Keep track of how many updates are queued
-	m_jobSystem->PushJob(updateJob);
+	++thisSection.m_editsSubmitted;
+	thisSection.m_pendingEdits.Push(updateBounds, iterator);
+
+	// If a drain job is already running on this section it will pick up the new edit
+	if (thisSection.m_drainJobActive.CAS(0, 1))
+	{
+		SubmitDrainJob(x, z);
+	}
 }
 
-void Floor::SaveNow(const char* filename)
+void Floor::SubmitRepackRequests()
+{
+	// Packing goes through the edit queues, since only the drain job may replace a section's blocks
+	for (int32_t z = 0; z < m_sectionsPerSide; ++z)
+	{
+		for (int32_t x = 0; x < m_sectionsPerSide; ++x)
+		{
+			auto& thisSection = GetSection(x, z);
+			if (thisSection.m_repackRequested.Get() == 1 && thisSection.m_remeshInFlight.Get() == 0)
+			{
+				thisSection.m_repackRequested.Set(0);
+				m_totalWritesPending.Add(1);
+				thisSection.m_pendingEdits.Push(thisSection.m_bounds, FloorEditQueue::AreaCallback());
+				if (thisSection.m_drainJobActive.CAS(0, 1))
+				{
+					SubmitDrainJob(x, z);
+				}
+			}
+		}
+	}
+}
+
+void Floor::ScheduleColdCompression(uint32_t now)
 {
-	SDE_ASSERT(m_isSaving.Get() == 0, "Dont overlap saves");
+	// Oldest first, so we can stop at the first block that is neither idle nor needed for the budget
+	m_coldCandidates.clear();
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		for (uint32_t chunk = 0; chunk < m_chunkCount; ++chunk)
+		{
+			const glm::ivec3 blockIndex = ChunkBlockIndex(m_sections[s], chunk);
+			if (m_voxelData.IsBlockWarm(blockIndex))
+			{
+				m_coldCandidates.push_back({ s, chunk, m_voxelData.LastAccessTime(blockIndex), m_voxelData.BlockMemory(blockIndex) });
+			}
+		}
+	}
+	std::sort(m_coldCandidates.begin(), m_coldCandidates.end(), [](const ColdCandidate& c0, const ColdCandidate& c1)
+	{
+		return c0.m_lastAccess < c1.m_lastAccess;
+	});
+
+	// Blocks used this second are never compressed, even if we are over budget
+	size_t warmBytes = m_voxelData.WarmVoxelMemory();
+	for (const auto& candidate : m_coldCandidates)
+	{
+		const bool isIdle = (now - candidate.m_lastAccess) >= m_coldIdleSeconds;
+		if (candidate.m_lastAccess == now || (!isIdle && warmBytes <= m_warmBudgetBytes))
+		{
+			break;
+		}
+		auto& section = m_sections[candidate.m_sectionIndex];
+		AtomicOrBits(section.m_coldChunks, 1 << candidate.m_chunkIndex);
+		section.m_repackRequested.Set(1);
+		warmBytes -= std::min(warmBytes, candidate.m_bytes);
+	}
+}
+
+void Floor::RequestSave(const char* filename)
+{
+	// Requests made before the pending save starts (i.e. the save button held down) merge into it.
+	// The save includes every edit requested before now, anything later can carry on while it runs
 	m_saveFilename = filename;
+	FlushEdits();
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		m_sections[s].m_saveEditTarget = m_sections[s].m_editsSubmitted;
+	}
 	m_isSaving = 1;
 }
 
+bool Floor::SaveEditsApplied()
+{
+	for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
+	{
+		if (m_sections[s].m_editsApplied.Get() - m_sections[s].m_saveEditTarget < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void Floor::SaveNow(const char* filename)
+{
+	RequestSave(filename);
+}
+
 void Floor::ModifyDataAndSave(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& modifier, const char* filename)
 {
 	if (!bounds.Intersects(m_totalBounds))
@@ -199,26 +744,93 @@ void Floor::ModifyDataAndSave(const Math::Box3& bounds, const Vox::ModelAreaData
 		return;
 	}
 
-	SDE_ASSERT(m_isSaving.Get() == 0, "Dont overlap saves");
-	
-	m_saveFilename = filename;
 	ModifyData(bounds, modifier);
-	m_isSaving = 1;
+	RequestSave(filename);
 }
 
-void Floor::ModifyData(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& modifier)
+void Floor::TraceRaycastPackets(RaycastBatch& batch) const
 {
-	if (!bounds.Intersects(m_totalBounds))
+	typedef VoxelRaymarcher<VoxelModel> Raymarcher;
+	VoxelModel::ReadScope readScope(m_voxelData);
+	Raymarcher rayMarcher(m_voxelData);
+	glm::vec3 starts[Raymarcher::c_packetSize], ends[Raymarcher::c_packetSize];
+	Raymarcher::Hit hits[Raymarcher::c_packetSize];
+	for (int32_t packet = batch.m_nextPacket.Add(1); packet < (int32_t)batch.m_packetCount; packet = batch.m_nextPacket.Add(1))
 	{
+		const uint32_t firstRay = packet * Raymarcher::c_packetSize;
+		const uint32_t rayCount = std::min(batch.m_rayCount - firstRay, Raymarcher::c_packetSize);
+		for (uint32_t r = 0; r < rayCount; ++r)
+		{
+			starts[r] = batch.m_rays[firstRay + r].m_start;
+			ends[r] = batch.m_rays[firstRay + r].m_end;
+		}
+		rayMarcher.RaymarchPacket(starts, ends, rayCount, hits);
+		for (uint32_t r = 0; r < rayCount; ++r)
+		{
+			RaycastHit& result = batch.m_hits[firstRay + r];
+			result.m_hit = hits[r].m_hit;
+			result.m_voxelIndex = hits[r].m_hit ? hits[r].m_voxelIndex : glm::ivec3(0);
+			result.m_position = hits[r].m_hit ? hits[r].m_voxelPosition : batch.m_rays[firstRay + r].m_end;
+			result.m_voxelData = hits[r].m_hit ? hits[r].m_voxelData : 0;
+			result.m_material = GetVoxelMaterial(result.m_voxelData);
+			result.m_distance = hits[r].m_hit ? hits[r].m_distance : glm::distance(batch.m_rays[firstRay + r].m_start, batch.m_rays[firstRay + r].m_end);
+		}
+		batch.m_packetsDone.Add(1);
+	}
+}
+
+void Floor::Raycast(const RaycastRay* rays, uint32_t rayCount, RaycastHit* hitsOut)
+{
+	// Counted before the check, so a load (or block freeing) that starts after it waits for us
+	m_raycastsInFlight.Add(1);
+	if (m_isLoading.Get() == 1 || m_loadInProgress.Get() > 0)
+	{
+		for (uint32_t r = 0; r < rayCount; ++r)
+		{
+			hitsOut[r].m_hit = false;
+			hitsOut[r].m_voxelIndex = glm::ivec3(0);
+			hitsOut[r].m_position = rays[r].m_end;
+			hitsOut[r].m_voxelData = 0;
+			hitsOut[r].m_material = Materials::Air;
+			hitsOut[r].m_distance = glm::distance(rays[r].m_start, rays[r].m_end);
+		}
+		m_raycastsInFlight.Add(-1);
 		return;
 	}
 
-	if (m_isSaving.Get() == 1)	// No other modifications allowed
+	auto batch = std::make_shared<RaycastBatch>();
+	batch->m_rays = rays;
+	batch->m_hits = hitsOut;
+	batch->m_rayCount = rayCount;
+	batch->m_packetCount = (rayCount + VoxelRaymarcher<VoxelModel>::c_packetSize - 1) / VoxelRaymarcher<VoxelModel>::c_packetSize;
+	batch->m_nextPacket.Set(0);
+	batch->m_packetsDone.Set(0);
+
+	// We trace packets here too, so we only ever wait on packets a job has already started
+	const uint32_t jobCount = std::min(batch->m_packetCount / c_raycastPacketsPerJob, c_maxRaycastJobs);
+	for (uint32_t j = 0; j < jobCount; ++j)
+	{
+		m_jobSystem->PushJob([this, batch]()
+		{
+			TraceRaycastPackets(*batch);
+		}, "Floor::Raycast");
+	}
+	TraceRaycastPackets(*batch);
+	while (batch->m_packetsDone.Get() < (int32_t)batch->m_packetCount)
+	{
+		std::this_thread::yield();
+	}
+	m_raycastsInFlight.Add(-1);
+}
+
+void Floor::ModifyData(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& modifier)
+{
+	if (!bounds.Intersects(m_totalBounds))
 	{
 		return;
 	}
 
-	if (m_isLoading.Get() == 1)
+	if (m_isLoading.Get() == 1 || m_loadInProgress.Get() > 0)
 	{
 		return;
 	}
@@ -227,87 +839,431 @@ void Floor::ModifyData(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<
 	glm::vec3 minEditBounds = glm::clamp(bounds.Min(), m_totalBounds.Min(), m_totalBounds.Max());
 	glm::vec3 maxEditBounds = glm::clamp(bounds.Max(), m_totalBounds.Min(), m_totalBounds.Max());
 
-	// we need to know which sections are being modified
-	glm::ivec3 sectionMin = glm::floor(minEditBounds / m_sectionSize);
-	glm::ivec3 sectionMax = glm::ceil(maxEditBounds / m_sectionSize);
+	// the edit is applied when the frame's edits are flushed
+	BatchedEdit newEdit;
+	newEdit.m_bounds = Math::Box3(minEditBounds, maxEditBounds);
+	newEdit.m_modifier = modifier;
+	m_frameEdits.push_back(std::move(newEdit));
+}
+
+void Floor::SubmitSectionEdits(const SectionEditPiece* first, const SectionEditPiece* last)
+{
+	const int32_t sectionX = first->m_sectionIndex % m_sectionsPerSide;
+	const int32_t sectionZ = first->m_sectionIndex / m_sectionsPerSide;
+
+	// Merge overlapping edits into clusters. Each new piece swallows any clusters it overlaps,
+	// so clusters are always disjoint and can be written independently
+	m_editClusters.clear();
+	for (auto piece = first; piece != last; ++piece)
+	{
+		EditCluster newCluster;
+		newCluster.m_bounds = piece->m_bounds;
+		newCluster.m_edits.push_back(piece->m_editIndex);
+		for (size_t c = 0; c < m_editClusters.size();)
+		{
+			if (m_editClusters[c].m_bounds.Intersects(newCluster.m_bounds))
+			{
+				auto& overlapping = m_editClusters[c];
+				newCluster.m_bounds.Min() = glm::min(newCluster.m_bounds.Min(), overlapping.m_bounds.Min());
+				newCluster.m_bounds.Max() = glm::max(newCluster.m_bounds.Max(), overlapping.m_bounds.Max());
+				newCluster.m_edits.insert(newCluster.m_edits.end(), overlapping.m_edits.begin(), overlapping.m_edits.end());
+				m_editClusters.erase(m_editClusters.begin() + c);
+				c = 0;	// the cluster grew, it may now overlap ones we already tested
+			}
+			else
+			{
+				++c;
+			}
+		}
+		m_editClusters.push_back(std::move(newCluster));
+	}
+
+	// One area write per cluster, with the brushes applied in the order they were requested
+	for (auto& cluster : m_editClusters)
+	{
+		if (cluster.m_edits.size() == 1)
+		{
+			SubmitUpdateJob(cluster.m_bounds, sectionX, sectionZ, m_frameEdits[cluster.m_edits[0]].m_modifier);
+		}
+		else
+		{
+			std::sort(cluster.m_edits.begin(), cluster.m_edits.end());
+			std::vector<Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback> brushes;
+			brushes.reserve(cluster.m_edits.size());
+			for (auto editIndex : cluster.m_edits)
+			{
+				brushes.push_back(m_frameEdits[editIndex].m_modifier);
+			}
+			auto mergedModifier = [brushes](Vox::ModelAreaDataWriterParams<VoxelModel>& areaParams)
+			{
+				for (const auto& brush : brushes)
+				{
+					brush(areaParams);
+				}
+			};
+			SubmitUpdateJob(cluster.m_bounds, sectionX, sectionZ, mergedModifier);
+		}
+	}
+}
+
+void Floor::FlushEdits()
+{
+	if (m_frameEdits.size() == 0)
+	{
+		return;
+	}
+
+	// split the edits into pieces, one per section touched
+	m_sectionEditPieces.clear();
+	for (uint32_t e = 0; e < m_frameEdits.size(); ++e)
+	{
+		const Math::Box3& editBounds = m_frameEdits[e].m_bounds;
+		glm::ivec3 sectionMin = glm::floor(editBounds.Min() / m_sectionSize);
+		glm::ivec3 sectionMax = glm::ceil(editBounds.Max() / m_sectionSize);
+		for (int32_t z = sectionMin.z; z < sectionMax.z; ++z)
+		{
+			for (int32_t x = sectionMin.x; x < sectionMax.x; ++x)
+			{
+				// clamp modification bounds to the section
+				SectionEditPiece piece;
+				piece.m_sectionIndex = x + (z * m_sectionsPerSide);
+				piece.m_bounds = GetSection(x, z).m_bounds;
+				piece.m_bounds.Min() = glm::max(piece.m_bounds.Min(), editBounds.Min());
+				piece.m_bounds.Max() = glm::min(piece.m_bounds.Max(), editBounds.Max());
+				piece.m_editIndex = e;
+				m_sectionEditPieces.push_back(piece);
+			}
+		}
+	}
+
+	// group the pieces by section, keeping the order they were requested in
+	std::stable_sort(m_sectionEditPieces.begin(), m_sectionEditPieces.end(), [](const SectionEditPiece& p0, const SectionEditPiece& p1)
+	{
+		return p0.m_sectionIndex < p1.m_sectionIndex;
+	});
 
 	// push the update jobs (one per section)
-	for (int32_t z = sectionMin.z; z < sectionMax.z; ++z)
+	const SectionEditPiece* pieces = m_sectionEditPieces.data();
+	const size_t pieceCount = m_sectionEditPieces.size();
+	size_t sectionStart = 0;
+	for (size_t p = 1; p <= pieceCount; ++p)
 	{
-		for (int32_t x = sectionMin.x; x < sectionMax.x; ++x)
+		if (p == pieceCount || pieces[p].m_sectionIndex != pieces[sectionStart].m_sectionIndex)
 		{
-			// clamp modification bounds to the section
-			Math::Box3 sectionBounds = GetSection(x,z).m_bounds;
-			sectionBounds.Min() = glm::max(sectionBounds.Min(), minEditBounds);
-			sectionBounds.Max() = glm::min(sectionBounds.Max(), maxEditBounds);
-			SubmitUpdateJob(sectionBounds, x, z, modifier);
+			SubmitSectionEdits(pieces + sectionStart, pieces + p);
+			sectionStart = p;
 		}
 	}
+
+	m_frameEdits.clear();
+}
+
+void Floor::StreamLoad(const glm::vec3& cameraPos)
+{
+	auto scratch = m_loaderScratch.Borrow();
+	auto& loader = *scratch;
+	m_voxelData.RemoveAllBlocks();
+
+	// Blocks nearest the camera are decoded first
+	const bool fileLoaded = loader.BeginStreaming(m_voxelData, m_loadFilename.c_str(), JournalPath(m_loadFilename).c_str(), [this, &cameraPos](const glm::ivec3& blockIndex)
+	{
+		const glm::vec3 blockCenter = (glm::vec3(blockIndex) + 0.5f) * m_chunkSize;
+		return glm::distance(cameraPos, blockCenter);
+	});
+	if (!fileLoaded)
+	{
+		m_voxelData.PreallocateMemory(m_totalBounds);	// Keep the block structure intact, the floor is just empty
+	}
+
+	// Count how many blocks each section is waiting for, sections are meshed as soon as they are complete
+	const int32_t sectionCount = m_sectionsPerSide * m_sectionsPerSide;
+	std::vector<int32_t> blocksPending(sectionCount, 0);
+	std::vector<uint8_t> sectionLoaded(sectionCount, 0);
+	for (uint32_t b = 0; b < loader.StreamedBlockCount(); ++b)
+	{
+		const int32_t sectionIndex = SectionIndexForBlock(loader.StreamedBlockIndex(b));
+		if (sectionIndex >= 0)
+		{
+			++blocksPending[sectionIndex];
+		}
+	}
+
+	auto sectionComplete = [this, &sectionLoaded](int32_t sectionIndex)
+	{
+		sectionLoaded[sectionIndex] = 1;
+		RequestRemesh(m_sections[sectionIndex], (uint32_t)((1ull << m_chunkCount) - 1));
+
+		// Neighbours meshed before us had nothing to cull their border faces against
+		const int32_t x = sectionIndex % m_sectionsPerSide;
+		const int32_t z = sectionIndex / m_sectionsPerSide;
+		const glm::ivec2 neighbours[] = { { x - 1, z }, { x + 1, z }, { x, z - 1 }, { x, z + 1 } };
+		for (const auto& n : neighbours)
+		{
+			if (n.x >= 0 && n.x < m_sectionsPerSide && n.y >= 0 && n.y < m_sectionsPerSide && sectionLoaded[n.x + (n.y * m_sectionsPerSide)])
+			{
+				auto& neighbour = GetSection(n.x, n.y);
+				RequestRemesh(neighbour, ChunkMaskForBounds(neighbour, m_sections[sectionIndex].m_bounds, m_voxelData.GetVoxelSize()));
+			}
+		}
+	};
+
+	for (int32_t s = 0; s < sectionCount; ++s)
+	{
+		if (blocksPending[s] == 0)
+		{
+			sectionComplete(s);
+		}
+	}
+	while (loader.StreamNextBlock(m_voxelData, [this, &blocksPending, &sectionComplete](glm::ivec3 blockIndex)
+	{
+		m_voxelData.CompactBlock(blockIndex);
+		m_voxelData.UpdateOccupancy(blockIndex);
+		const int32_t sectionIndex = SectionIndexForBlock(blockIndex);
+		if (sectionIndex >= 0 && --blocksPending[sectionIndex] == 0)
+		{
+			sectionComplete(sectionIndex);
+		}
+	}));
+	loader.ReleaseFileData();
 }
 
-void Floor::Update()
+void Floor::Update(const Render::Camera& camera)
 {
+	// Jobs reading the model hold a ReadScope, so only blocks they can't see are freed. The loader
+	// replaces the whole model and frees everything itself
+	if (m_loadInProgress.Get() == 0)
+	{
+		m_voxelData.FreeRetiredBlocks();
+	}
+
+	// Blocks are stamped with this as they are accessed, so we can find the cold ones
+	const uint32_t accessTime = (uint32_t)((m_timer.GetTicks() - m_startTicks) / m_timer.GetFrequency());
+	m_voxelData.SetAccessTime(accessTime);
+
+	// The loader owns all blocks until it is done
+	if (m_isLoading.Get() == 0 && m_loadInProgress.Get() == 0)
+	{
+		if (accessTime - m_lastColdScan >= c_coldScanIntervalSeconds)
+		{
+			ScheduleColdCompression(accessTime);
+			m_lastColdScan = accessTime;
+		}
+		SubmitRepackRequests();
+	}
+
 	if (m_isSaving.Get()==1)
 	{
-		if (m_totalWritesPending.Get() == 0)
+		// Only wait for the edits requested before the save, new ones keep going while the save job runs
+		if (m_saveJobsInFlight.Get() == 0 && SaveEditsApplied())
 		{
+			// If the file on disk matches our data we only need to journal the blocks that changed since,
+			// otherwise the whole model is written. A journal is useless without the model file
+			std::vector<glm::ivec3> changedBlocks;
+			TakeUnsavedBlocks(changedBlocks);
+			const bool fullSave = m_journalBaseFilename != m_saveFilename || !FileExists(m_saveFilename);
+			m_journalBaseFilename = m_saveFilename;
+
+			// Freeze the blocks we are about to write, so edits from now on don't end up in the file
+			if (fullSave)
+			{
+				m_saveSnapshot.FreezeAll();
+			}
+			else
+			{
+				m_saveSnapshot.Freeze(changedBlocks);
+			}
+
 			// We will now issue a saving job.
-			auto savingJob = [this]()
+			auto savingJob = [this, fullSave, changedBlocks, saveFilename = m_saveFilename]()
 			{
-				VoxelModelSerialiser<VoxelModel> serialiser;
-				serialiser.WriteToFile(m_voxelData, m_saveFilename.c_str());
+				// The scratch goes back to the pool before the save counts as finished
+				{
+					VoxelModel::ReadScope readScope(m_voxelData);	// Blocks not frozen are copied straight from the model
+					auto scratch = m_serialiserScratch.Borrow();
+					auto& serialiser = *scratch;
+					auto snapshotBlocks = [this](const glm::ivec3& blockIndex)
+					{
+						return m_saveSnapshot.ReadBlock(blockIndex);
+					};
+					const std::string journalPath = JournalPath(saveFilename);
+					bool saved = true;
+					if (fullSave)
+					{
+						saved = serialiser.WriteToFile(m_voxelData, snapshotBlocks, saveFilename.c_str());
+						if (saved)
+						{
+							remove(journalPath.c_str());	// Any old journal no longer applies
+						}
+					}
+					else if (changedBlocks.size() > 0)
+					{
+						size_t journalSize = 0;
+						saved = serialiser.AppendToJournal(snapshotBlocks, changedBlocks, journalPath.c_str(), &journalSize);
+						if (saved && journalSize > c_maxJournalBytes)
+						{
+							auto compactionJob = [this, saveFilename, journalPath]()
+							{
+								{
+									auto scratch = m_serialiserScratch.Borrow();
+									scratch->CompactJournal(saveFilename.c_str(), journalPath.c_str());
+									scratch->ReleaseFileData();
+								}
+								m_saveJobsInFlight.Add(-1);
+							};
+							m_saveJobsInFlight.Add(1);
+							m_jobSystem->PushJob(compactionJob, "Floor::CompactJournal");
+						}
+					}
+					if (!saved)
+					{
+						// Nothing on disk can be trusted to match, the next save writes everything
+						SDE_LOGC(SDE, "Failed to save %s", saveFilename.c_str());
+						RestoreUnsavedBlocks(changedBlocks);
+						m_journalBaseFilename.clear();
+					}
+					serialiser.ReleaseFileData();
+				}
+				m_saveSnapshot.Release();
+				m_saveJobsInFlight.Add(-1);
 			};
+			m_saveJobsInFlight.Add(1);
 			m_jobSystem->PushJob(savingJob, "Floor::Save");
 			m_isSaving.Set(0);
 		}
 	}
 	else if (m_isLoading.Get() == 1)
 	{
-		if (m_totalWritesPending.Get() == 0)
+		// Wait for all jobs touching the voxel data (or the files) to finish before we replace it
+		if (m_totalWritesPending.Get() == 0 && m_frameEdits.size() == 0 && m_remeshJobsInFlight.Get() == 0 && m_saveJobsInFlight.Get() == 0 && m_raycastsInFlight.Get() == 0)
 		{
-			auto loadingJob = [this]()
+			// Everything loaded matches the file + its journal
+			std::vector<glm::ivec3> discardedBlocks;
+			TakeUnsavedBlocks(discardedBlocks);
+			m_journalBaseFilename = m_loadFilename;
+
+			// Drop any remesh requests for the old data, the load requests sections as they arrive
+			for (int32_t s = 0; s < m_sectionsPerSide * m_sectionsPerSide; ++s)
 			{
-				VoxelModelLoader<VoxelModel> loader;
-				auto bounds = m_voxelData.GetTotalBounds();
-				m_voxelData.RemoveAllBlocks();
-				loader.LoadFromFile(m_voxelData, m_loadFilename.c_str(), [](glm::ivec3 blockIndex)
-				{
-				});
-				for (int32_t z = 0; z < m_sectionsPerSide; ++z)
-				{
-					for (int32_t x = 0; x < m_sectionsPerSide; ++x)
-					{
-						Math::Box3 sectionBounds;
-						sectionBounds.Min() = glm::vec3(x * m_sectionSize.x, m_sectionSize.y, z * m_sectionSize.z);
-						sectionBounds.Max() = sectionBounds.Min() + m_sectionSize;
-						SubmitRemeshJob(sectionBounds, x, z);
-					}
-				}
-			};	
-			m_jobSystem->PushJob(loadingJob, "Floor::Load");
+				AtomicTakeBits(m_sections[s].m_dirtyChunks);
+				m_sections[s].m_remeshRequested.Set(0);
+				std::fill(std::begin(m_sections[s].m_staleLodChunks), std::end(m_sections[s].m_staleLodChunks), 0);
+			}
+
+			auto loadingJob = [this, cameraPos = camera.Position()]()
+			{
+				StreamLoad(cameraPos);
+				m_loadInProgress.Add(-1);
+			};
 			m_loadInProgress.Add(1);
+			m_jobSystem->PushJob(loadingJob, "Floor::Load");
 			m_isLoading.Set(0);
 		}
 	}
 }
 
-void Floor::Render(Render::Camera& camera, Render::RenderPass& targetPass)
+void Floor::SelectSectionLods(const glm::vec3& cameraPos)
 {
-	RebuildDirtyMeshes();
-	for (int32_t z = 0; z < m_sectionsPerSide; ++z)
+	// Every chunk in a section selects the same level, so apart from chunks still waiting on their new mesh only section borders can have mismatched neighbours
+	// While a load is pending or running only the loader requests remeshes, it rebuilds every level in use
+	const bool loading = m_isLoading.Get() == 1 || m_loadInProgress.Get() > 0;
+	const int32_t sectionCount = m_sectionsPerSide * m_sectionsPerSide;
+	for (int32_t s = 0; s < sectionCount; ++s)
 	{
-		for (int32_t x = 0; x < m_sectionsPerSide; ++x)
-		{		
-			auto& theMesh = GetSection(x,z).m_renderMesh;
-			if (theMesh.GetStreams().size() > 0)
-			{
-				const glm::mat4 mvp = camera.ProjectionMatrix() * camera.ViewMatrix();
-				
-				Render::UniformBuffer instanceUniforms;
-				instanceUniforms.SetValue("MVP", mvp);
+		auto& section = m_sections[s];
+		const float distance = glm::distance(cameraPos, glm::clamp(cameraPos, section.m_bounds.Min(), section.m_bounds.Max()));
+		section.m_lod = VoxelLod::SelectLod(section.m_lod, distance);
+		section.m_nextLod = VoxelLod::NextLod(section.m_lod, distance);
+
+		// Remeshes skip levels the section wasn't going to use, catch up on them once it might
+		const uint32_t staleChunks = section.m_staleLodChunks[section.m_lod] | section.m_staleLodChunks[section.m_nextLod];
+		if (staleChunks != 0 && !loading)
+		{
+			RequestRemesh(section, staleChunks);
+		}
 
-				targetPass.AddInstance(&theMesh, std::move(instanceUniforms));
+		// Chunks keep drawing their old level until the new one is ready, then anything else is freed
+		const uint32_t keepLevels = (1u << section.m_lod) | (1u << section.m_nextLod);
+		for (uint32_t c = 0; c < m_chunkCount; ++c)
+		{
+			const uint32_t chunkBit = 1u << c;
+			if (section.m_readyLodChunks[section.m_lod] & chunkBit)
+			{
+				section.m_chunkDrawnLod[c] = (uint8_t)section.m_lod;
 			}
+			const uint32_t keepChunkLevels = keepLevels | (1u << section.m_chunkDrawnLod[c]);
+			for (uint32_t lod = 0; lod < VoxelLod::c_lodCount; ++lod)
+			{
+				if ((keepChunkLevels & (1u << lod)) == 0 && (section.m_readyLodChunks[lod] & chunkBit))
+				{
+					FreeChunkMesh(section, c, lod);
+				}
+			}
+		}
+	}
+}
+
+void Floor::FreeChunkMesh(SectionDesc& section, uint32_t chunkIndex, uint32_t lod)
+{
+	// It gets rebuilt by a remesh if the section wants the level again
+	if (lod == 0)
+	{
+		ReplaceChunkMesh(section.m_chunkMeshes[chunkIndex], {});
+		section.m_chunkDamage[chunkIndex] = nullptr;
+	}
+	else
+	{
+		ReplaceChunkMesh(section.m_chunkLodMeshes[(chunkIndex * (VoxelLod::c_lodCount - 1)) + lod - 1], {});
+	}
+	section.m_readyLodChunks[lod] &= ~(1u << chunkIndex);
+	section.m_staleLodChunks[lod] |= 1u << chunkIndex;
+}
+
+void Floor::Render(Render::Camera& camera, Render::RenderPass& targetPass)
+{
+	m_culler.SetFromCamera(camera);
+
+	FlushEdits();
+	ScheduleRemeshJobs(camera);
+	RebuildDirtyMeshes(camera.Position());
+	SelectSectionLods(camera.Position());
+
+	// Cull all chunks against the frustum, then drop any without geometry at the level they draw
+	m_visibleChunks.clear();
+	m_culler.CullBoxes(m_chunkBounds, m_visibleChunks);
+	m_visibleChunks.erase(std::remove_if(m_visibleChunks.begin(), m_visibleChunks.end(), [this](uint32_t chunkIndex)
+	{
+		const auto& section = m_sections[chunkIndex / m_chunkCount];
+		const uint32_t drawnLod = section.m_chunkDrawnLod[chunkIndex % m_chunkCount];
+		const Render::Mesh* chunkMesh = ChunkMesh(section, chunkIndex % m_chunkCount, drawnLod);
+		return chunkMesh == nullptr || chunkMesh->GetStreams().size() == 0;
+	}), m_visibleChunks.end());
+
+	// Draw front to back so early-z can reject as much as possible
+	m_culler.SortFrontToBack(m_chunkBounds, camera.Position(), m_visibleChunks);
+
+	// Vertex positions are in voxels from the chunk origin, the shader needs the origin and voxel size
+	// LOD meshes have no damage lookup
+	const glm::mat4 mvp = camera.ProjectionMatrix() * camera.ViewMatrix();
+	const float voxelSize = m_voxelData.GetVoxelSize().x;
+	uint32_t chunksDrawn[VoxelLod::c_lodCount] = { 0 };
+	uint32_t trianglesDrawn[VoxelLod::c_lodCount] = { 0 };
+	for (auto chunkIndex : m_visibleChunks)
+	{
+		auto& section = m_sections[chunkIndex / m_chunkCount];
+		const uint32_t drawnLod = section.m_chunkDrawnLod[chunkIndex % m_chunkCount];
+		Render::Mesh* chunkMesh = ChunkMesh(section, chunkIndex % m_chunkCount, drawnLod);
+		Render::Texture* chunkDamage = drawnLod == 0 ? section.m_chunkDamage[chunkIndex % m_chunkCount].get() : nullptr;
+		Render::UniformBuffer instanceUniforms;
+		instanceUniforms.SetValue("MVP", mvp);
+		instanceUniforms.SetValue("ChunkOrigin", glm::vec4(m_chunkBounds.GetBox(chunkIndex).Min(), voxelSize));
+		instanceUniforms.SetValue("ChunkDamage", glm::vec4(chunkDamage != nullptr ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f));
+		if (chunkDamage != nullptr)
+		{
+			instanceUniforms.SetSampler("DamageLookup", chunkDamage->GetHandle());
 		}
+		targetPass.AddInstance(chunkMesh, std::move(instanceUniforms));
+		++chunksDrawn[drawnLod];
+		trianglesDrawn[drawnLod] += chunkMesh->GetChunks()[0].m_vertexCount / 3;
 	}
+	m_stats.UpdateDrawStats(chunksDrawn, trianglesDrawn);
 }
\ No newline at end of file
@@ -1,15 +1,27 @@
 #pragma once
 
 #include "floor_stats.h"
+#include "floor_edit_queue.h"
+#include "floor_mesh_results.h"
+#include "floor_mesh_scratch.h"
+#include "frustum_culler.h"
+#include "job_scratch_pool.h"
+#include "mesh_upload_scheduler.h"
 #include "voxel_definitions.h"
 #include "voxel_material.h"
+#include "voxel_mesh_builder.h"
+#include "voxel_model_snapshot.h"
+#include "voxel_model_serialiser.h"
+#include "vox_model_loader.h"
 #include "vox/model_area_data_writer.h"
 #include "render/mesh.h"
 #include "render/mesh_builder.h"
+#include "render/texture.h"
 #include "math/box3.h"
 #include "kernel/atomics.h"
-#include "kernel/mutex.h"
+#include "core/timer.h"
 #include <vector>
+#include <memory>
 
 namespace Render
 {
@@ -23,9 +35,10 @@ namespace SDE
 }
 
 // Represents a single floor in a building. Floors are organised as a single voxel model,
-// with a grid of sections representing individual meshes.
+// with a grid of sections. Each section is split into chunks that line up with the voxel
+// model blocks; every chunk has its own mesh so small edits only remesh the blocks they touch.
 // All updates are async, and there is no access to internal data on the main thread
-class Floor
+class Floor : public MeshUploadSink
 {
 public:
 	Floor();
@@ -33,17 +46,45 @@ public:
 
 	void Create(SDE::JobSystem* jobSystem, VoxelMaterialSet& materials, const glm::vec3& floorSize, int32_t sectionDimensions);
 	void Destroy();
-	void RebuildDirtyMeshes();
-	void Update();
+	void RebuildDirtyMeshes(const glm::vec3& cameraPos);
+	void Update(const Render::Camera& camera);
 	void Render(Render::Camera& camera, Render::RenderPass& targetPass);
 	void DisplayDebugGui(DebugGui::DebugGuiSystem& gui);
 
 	// Async stuff
+	// Modifications are batched for the frame and submitted from Render. Overlapping edits in a section
+	// are merged into one area write, so modifiers must only touch voxels inside their own bounds
 	bool LoadFile(const char* filename);
 	void SaveNow(const char* filename);
 	void ModifyData(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& modifier);
 	void ModifyDataAndSave(const Math::Box3& bounds, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& modifier, const char* filename);
 
+	// Chunk meshes are uploaded nearest first, limited by whichever budget runs out first
+	void SetUploadBudget(size_t maxBytesPerFrame, double maxSecondsPerFrame);
+
+	// Blocks nobody has accessed for idleSeconds are compressed, as are the least recently used ones
+	// while the warm (uncompressed) voxel memory is over budget
+	void SetColdStorage(uint32_t idleSeconds, size_t warmBudgetBytes);
+
+	// Hitscan queries (shots, line of sight) against the current voxel data, answered before this returns.
+	// Rays are traced 4 at a time, so keep coherent rays (i.e. a shotgun spread) next to each other.
+	// Big batches are shared with the job system. Everything misses while a load is replacing the data
+	struct RaycastRay
+	{
+		glm::vec3 m_start;
+		glm::vec3 m_end;
+	};
+	struct RaycastHit
+	{
+		bool m_hit;
+		glm::ivec3 m_voxelIndex;
+		glm::vec3 m_position;		// Center of the voxel
+		VoxelData m_voxelData;
+		Materials m_material;
+		float m_distance;			// From the ray start to where it entered the voxel
+	};
+	void Raycast(const RaycastRay* rays, uint32_t rayCount, RaycastHit* hitsOut);
+
 	// Test!
 	inline VoxelModel& GetModel() { return m_voxelData; }
 
@@ -51,32 +92,142 @@ private:
 	struct SectionDesc
 	{
 		Math::Box3 m_bounds;
-		Render::Mesh m_renderMesh;
-		Kernel::AtomicInt32 m_updateJobCounter;	// How many jobs are acting on this data
-		Kernel::AtomicInt32 m_updatesPending;	// How many update jobs have been queued. if it hits 0, we are safe to mesh it		
+		std::vector<std::unique_ptr<Render::Mesh>> m_chunkMeshes;	// null if the chunk has no geometry
+		std::vector<std::unique_ptr<Render::Texture>> m_chunkDamage;	// See VoxelDamageLookup, null if nothing in the chunk is damaged
+		std::vector<std::unique_ptr<Render::Mesh>> m_chunkLodMeshes;	// [(chunk * (c_lodCount - 1)) + lod - 1], null if empty at that level
+		std::vector<uint8_t> m_chunkDrawnLod;	// Level each chunk draws, lags m_lod until that level's mesh is ready (main thread only)
+		uint32_t m_lod;							// Level selected for the whole section (main thread only)
+		uint32_t m_nextLod;						// Level it is about to switch to, remeshes build both (main thread only)
+		uint32_t m_staleLodChunks[VoxelLod::c_lodCount];	// Per level, chunks whose mesh was skipped by a remesh or freed (main thread only)
+		uint32_t m_readyLodChunks[VoxelLod::c_lodCount];	// Per level, chunks with an uploaded mesh that is safe to draw (main thread only)
+		Kernel::AtomicInt32 m_dirtyChunks;		// Bitmask of chunks that need remeshing
+		Kernel::AtomicInt32 m_unsavedChunks;	// Bitmask of chunks (i.e. model blocks) changed since the last save
+		Kernel::AtomicInt32 m_remeshRequested;	// Set by jobs when dirty chunks are ready to be meshed
+		Kernel::AtomicInt32 m_remeshInFlight;	// 1 while a remesh job is running (only one at a time)
+		Kernel::AtomicInt32 m_meshResultChunks;	// Bitmask of chunks with a mesh result waiting for the main thread
+		Kernel::AtomicInt32 m_repackRequested;	// Set when the drain job should compact blocks even without edits (cold compression)
+		Kernel::AtomicInt32 m_coldChunks;		// Bitmask of chunks the drain job should move to the cold tier
+		FloorEditQueue m_pendingEdits;			// Edits waiting to be applied by the drain job
+		Kernel::AtomicInt32 m_drainJobActive;	// 1 while a drain job owns this section (only one at a time)
+		int32_t m_editsSubmitted;				// Edits pushed to the queue (main thread only)
+		Kernel::AtomicInt32 m_editsApplied;		// Edits written by the drain jobs
+		int32_t m_saveEditTarget;				// Edits that must be applied before a requested save can start
+	};
+
+	struct BatchedEdit
+	{
+		Math::Box3 m_bounds;
+		Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback m_modifier;
+	};
+
+	struct SectionEditPiece
+	{
+		int32_t m_sectionIndex;
+		Math::Box3 m_bounds;	// Edit bounds clamped to the section
+		uint32_t m_editIndex;	// Index into m_frameEdits
+	};
+
+	struct EditCluster
+	{
+		Math::Box3 m_bounds;
+		std::vector<uint32_t> m_edits;
+	};
+
+	struct RemeshCandidate
+	{
+		int32_t m_sectionIndex;
+		uint32_t m_chunkCount;	// How many dirty chunks (i.e. how much work)
+		float m_distance;		// Distance from the camera to the section bounds
+		bool m_visible;
+	};
+
+	// Shared with the raycast jobs. Jobs that start after all packets are taken never touch the rays or hits
+	struct RaycastBatch
+	{
+		const RaycastRay* m_rays;
+		RaycastHit* m_hits;
+		uint32_t m_rayCount;
+		uint32_t m_packetCount;
+		Kernel::AtomicInt32 m_nextPacket;
+		Kernel::AtomicInt32 m_packetsDone;
+	};
+
+	struct ColdCandidate
+	{
+		int32_t m_sectionIndex;
+		uint32_t m_chunkIndex;
+		uint32_t m_lastAccess;
+		size_t m_bytes;
 	};
 
-	void RemeshSection(int32_t x, int32_t z);
+	void FlushEdits();
+	void RequestSave(const char* filename);
+	bool SaveEditsApplied();
+	void SubmitSectionEdits(const SectionEditPiece* first, const SectionEditPiece* last);
+	uint32_t ChunkMaskForBounds(const SectionDesc& section, const Math::Box3& bounds, const glm::vec3& margin) const;
+	Math::Box3 ChunkBounds(const SectionDesc& section, uint32_t chunkIndex) const;
+	glm::ivec3 ChunkBlockIndex(const SectionDesc& section, uint32_t chunkIndex) const;
+	int32_t SectionIndexForBlock(const glm::ivec3& blockIndex) const;
+	void StreamLoad(const glm::vec3& cameraPos);
+	void TakeUnsavedBlocks(std::vector<glm::ivec3>& blocks);
+	void RestoreUnsavedBlocks(const std::vector<glm::ivec3>& blocks);	// Puts back blocks a failed save took
+	void RemeshSection(int32_t x, int32_t z, uint32_t dirtyChunks, uint32_t lodMask);
 	void SubmitUpdateJob(const Math::Box3& updateBounds, int32_t x, int32_t z, const Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback& iterator);
-	void SubmitRemeshJob(const Math::Box3& updateBounds, int32_t x, int32_t z);
+	void SubmitDrainJob(int32_t x, int32_t z);
+	void SubmitRepackRequests();
+	void ScheduleColdCompression(uint32_t now);
+	void TraceRaycastPackets(RaycastBatch& batch) const;
+	void RequestRemesh(SectionDesc& section, uint32_t dirtyChunks);
+	void ScheduleRemeshJobs(const Render::Camera& camera);
+	virtual size_t UploadMesh(uint32_t meshIndex) override;
+	size_t ReplaceChunkMesh(std::unique_ptr<Render::Mesh>& chunkMesh, const std::vector<PackedVoxelVertex>& vertices);
+	Render::Mesh* ChunkMesh(const SectionDesc& section, uint32_t chunkIndex, uint32_t lod) const;
+	void FreeChunkMesh(SectionDesc& section, uint32_t chunkIndex, uint32_t lod);
+	void SelectSectionLods(const glm::vec3& cameraPos);
+	virtual float MeshDistance(uint32_t meshIndex) const override;
+	void SubmitRemeshJob(int32_t x, int32_t z);
 	SectionDesc& GetSection(int32_t x, int32_t z);
-	void AddSectionMeshResult(int32_t x, int32_t z, Render::MeshBuilder& result);
 
-	Kernel::Mutex m_updatedMeshesLock;		// Meshing results protected by mutex (since main thread needs them)
-	std::unordered_map<int32_t, Render::MeshBuilder> m_updatedMeshes;	// map of sectionindex -> mesh builder results
-	std::vector<SectionDesc> m_sections;
+	JobScratchPool<FloorMeshScratch> m_meshScratch;
+	JobScratchPool<VoxelModelLoader<VoxelModel>> m_loaderScratch;			// Loads and saves release their file data when done,
+	JobScratchPool<VoxelModelSerialiser<VoxelModel>> m_serialiserScratch;	// only the small per-block buffers are kept
+	FloorMeshResults m_meshResults;		// Meshing results waiting for the main thread, indexed by (section index * chunks per section) + chunk
+	MeshUploadScheduler m_uploadScheduler;	// Mesh results waiting for upload (same indices)
+	glm::vec3 m_uploadCameraPos;
+	Core::Timer m_timer;				// Drives the voxel model access times (in seconds)
+	uint64_t m_startTicks;
+	uint32_t m_lastColdScan;
+	uint32_t m_coldIdleSeconds;
+	size_t m_warmBudgetBytes;
+	std::vector<BatchedEdit> m_frameEdits;			// Edits requested this frame (main thread only)
+	std::vector<SectionEditPiece> m_sectionEditPieces;
+	std::vector<EditCluster> m_editClusters;
+	std::vector<RemeshCandidate> m_remeshCandidates;
+	std::vector<ColdCandidate> m_coldCandidates;
+	FrustumCuller m_culler;				// Set up from the camera at the start of Render
+	CullingBoxList m_chunkBounds;		// Bounds of every chunk, indexed by (section index * chunks per section) + chunk
+	std::vector<uint32_t> m_visibleChunks;
+	std::unique_ptr<SectionDesc[]> m_sections;	// Not a vector, the edit queues cannot be moved
 	Math::Box3 m_totalBounds;
 	glm::vec3 m_sectionSize;
 	int32_t m_sectionsPerSide;
+	glm::vec3 m_chunkSize;				// Matches the voxel model block size
+	glm::ivec3 m_chunksPerSection;
+	uint32_t m_chunkCount;				// Chunks per section (max 32, they are tracked as a bitmask)
 	VoxelModel m_voxelData;
+	VoxelModelSnapshot<VoxelModel> m_saveSnapshot;	// Frozen view of the blocks being saved, edits clone blocks they touch
 	VoxelMaterialSet m_materials;
 	SDE::JobSystem* m_jobSystem;
-	Kernel::AtomicInt32 m_isSaving;
+	Kernel::AtomicInt32 m_isSaving;			// A save is requested and waiting to start, repeat requests merge into it
 	Kernel::AtomicInt32 m_isLoading;
 	Kernel::AtomicInt32 m_loadInProgress;
 	Kernel::AtomicInt32 m_totalWritesPending;
+	Kernel::AtomicInt32 m_remeshJobsInFlight;
+	Kernel::AtomicInt32 m_raycastsInFlight;	// Raycast calls (any thread) still reading the voxel data
+	Kernel::AtomicInt32 m_saveJobsInFlight;	// Saves + journal compaction
 	Kernel::AtomicInt32 m_totalVbBytes;
 	std::string m_saveFilename;
 	std::string m_loadFilename;
+	std::string m_journalBaseFilename;		// The model file on disk matching our data, changes since then go to its journal. Empty after a failed save
 	FloorStats m_stats;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "floor_edit_queue.h"
+
+FloorEditQueue::FloorEditQueue()
+	: m_head(nullptr)
+	, m_freeEdits(nullptr)
+	, m_editNodeCount(0)
+{
+}
+
+FloorEditQueue::~FloorEditQueue()
+{
+	Drain([](const Edit&) {});
+	while (m_freeEdits != nullptr)
+	{
+		Edit* next = m_freeEdits->m_next;
+		delete m_freeEdits;
+		m_freeEdits = next;
+	}
+}
+
+FloorEditQueue::Edit* FloorEditQueue::AllocateEdit()
+{
+	{
+		Kernel::ScopedMutex lock(m_freeLock);
+		if (m_freeEdits != nullptr)
+		{
+			Edit* edit = m_freeEdits;
+			m_freeEdits = edit->m_next;
+			return edit;
+		}
+		++m_editNodeCount;
+	}
+	return new Edit;
+}
+
+uint32_t FloorEditQueue::EditNodeCount()
+{
+	Kernel::ScopedMutex lock(m_freeLock);
+	return m_editNodeCount;
+}
+
+void FloorEditQueue::Push(const Math::Box3& bounds, const AreaCallback& callback)
+{
+	Edit* newEdit = AllocateEdit();
+	newEdit->m_bounds = bounds;
+	newEdit->m_callback = callback;
+	newEdit->m_next = m_head.load(std::memory_order_relaxed);
+	while (!m_head.compare_exchange_weak(newEdit->m_next, newEdit, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+bool FloorEditQueue::IsEmpty() const
+{
+	return m_head.load(std::memory_order_acquire) == nullptr;
+}
+
+uint32_t FloorEditQueue::Drain(const std::function<void(const Edit&)>& fn)
+{
+	// Take the entire list in one go, producers can keep pushing to the (now empty) head
+	Edit* edits = m_head.exchange(nullptr, std::memory_order_acquire);
+
+	// The list is newest-first, reverse it so edits are applied in submission order
+	Edit* ordered = nullptr;
+	while (edits != nullptr)
+	{
+		Edit* next = edits->m_next;
+		edits->m_next = ordered;
+		ordered = edits;
+		edits = next;
+	}
+
+	// Callbacks are released as we go, so whatever they captured doesn't live on in the free list
+	uint32_t editCount = 0;
+	Edit* drained = ordered;
+	Edit* drainedTail = nullptr;
+	while (ordered != nullptr)
+	{
+		fn(*ordered);
+		ordered->m_callback = nullptr;
+		drainedTail = ordered;
+		ordered = ordered->m_next;
+		++editCount;
+	}
+	if (drained != nullptr)
+	{
+		Kernel::ScopedMutex lock(m_freeLock);
+		drainedTail->m_next = m_freeEdits;
+		m_freeEdits = drained;
+	}
+	return editCount;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include "vox/model_area_data_writer.h"
+#include "math/box3.h"
+#include "kernel/mutex.h"
+#include <atomic>
+#include <functional>
+
+// Lock-free queue of pending voxel edits for a single floor section.
+// Any thread may push. Only one thread (the section drain job) may drain at a time.
+// Drained edits go on a free list for later pushes, so a steady stream of edits stops allocating nodes
+class FloorEditQueue
+{
+public:
+	typedef Vox::ModelAreaDataWriter<VoxelModel>::AreaCallback AreaCallback;
+
+	struct Edit
+	{
+		Math::Box3 m_bounds;
+		AreaCallback m_callback;
+		Edit* m_next;
+	};
+
+	FloorEditQueue();
+	~FloorEditQueue();
+
+	void Push(const Math::Box3& bounds, const AreaCallback& callback);
+	bool IsEmpty() const;
+	uint32_t EditNodeCount();	// Nodes allocated so far, queued or free
+
+	// Pops everything queued so far and passes each edit to fn in the order it was pushed
+	// Returns the number of edits processed
+	uint32_t Drain(const std::function<void(const Edit&)>& fn);
+
+private:
+	FloorEditQueue(const FloorEditQueue&) = delete;
+	FloorEditQueue& operator=(const FloorEditQueue&) = delete;
+
+	Edit* AllocateEdit();
+
+	std::atomic<Edit*> m_head;	// Most recently pushed edit (i.e. the list is in reverse order)
+	Kernel::Mutex m_freeLock;
+	Edit* m_freeEdits;
+	uint32_t m_editNodeCount;
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "floor_mesh_results.h"
+#include "kernel/assert.h"
+
+static size_t ResultBytes(const FloorMeshResults::Result& result)
+{
+	size_t bytes = (result.m_vertices.capacity() * sizeof(PackedVoxelVertex)) + result.m_damage.CapacityBytes();
+	for (const auto& lodVertices : result.m_lodVertices)
+	{
+		bytes += lodVertices.capacity() * sizeof(PackedVoxelVertex);
+	}
+	return bytes;
+}
+
+FloorMeshResults::FloorMeshResults()
+	: m_slotCount(0)
+	, m_retainedBytes(0)
+{
+}
+
+FloorMeshResults::~FloorMeshResults()
+{
+	Destroy();
+}
+
+void FloorMeshResults::Create(uint32_t slotCount)
+{
+	Destroy();
+	m_slots.reset(new Slot[slotCount]);
+	m_slotCount = slotCount;
+	for (uint32_t s = 0; s < slotCount; ++s)
+	{
+		m_slots[s].m_latest.store(nullptr, std::memory_order_relaxed);
+		m_slots[s].m_spare.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+void FloorMeshResults::Destroy()
+{
+	for (uint32_t s = 0; s < m_slotCount; ++s)
+	{
+		delete m_slots[s].m_latest.exchange(nullptr);
+		delete m_slots[s].m_spare.exchange(nullptr);
+	}
+	m_slots = nullptr;
+	m_slotCount = 0;
+	m_retainedBytes = 0;
+}
+
+FloorMeshResults::Result* FloorMeshResults::Acquire(uint32_t slot)
+{
+	SDE_ASSERT(slot < m_slotCount);
+	Result* result = m_slots[slot].m_spare.exchange(nullptr, std::memory_order_acquire);
+	if (result == nullptr)
+	{
+		return new Result;
+	}
+	m_retainedBytes.fetch_sub(ResultBytes(*result), std::memory_order_relaxed);
+	return result;
+}
+
+void FloorMeshResults::Publish(uint32_t slot, Result* result)
+{
+	SDE_ASSERT(slot < m_slotCount);
+	Result* superseded = m_slots[slot].m_latest.exchange(result, std::memory_order_acq_rel);
+	if (superseded != nullptr)
+	{
+		Recycle(slot, superseded);	// The main thread never saw it
+	}
+}
+
+FloorMeshResults::Result* FloorMeshResults::Consume(uint32_t slot)
+{
+	SDE_ASSERT(slot < m_slotCount);
+	return m_slots[slot].m_latest.exchange(nullptr, std::memory_order_acquire);
+}
+
+void FloorMeshResults::Recycle(uint32_t slot, Result* result)
+{
+	SDE_ASSERT(slot < m_slotCount);
+
+	// Keep the buffers for the next remesh of this chunk if the budget allows, otherwise release them now
+	size_t bytes = ResultBytes(*result);
+	if (m_retainedBytes.load(std::memory_order_relaxed) + bytes > c_maxRetainedBytes)
+	{
+		std::vector<PackedVoxelVertex>().swap(result->m_vertices);
+		result->m_damage.Release();
+		for (auto& lodVertices : result->m_lodVertices)
+		{
+			std::vector<PackedVoxelVertex>().swap(lodVertices);
+		}
+		bytes = ResultBytes(*result);
+	}
+	m_retainedBytes.fetch_add(bytes, std::memory_order_relaxed);
+	Result* extra = m_slots[slot].m_spare.exchange(result, std::memory_order_acq_rel);
+	if (extra != nullptr)
+	{
+		m_retainedBytes.fetch_sub(ResultBytes(*extra), std::memory_order_relaxed);
+		delete extra;
+	}
+}
\ No newline at end of file
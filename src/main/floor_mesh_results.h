@@ -0,0 +1,54 @@
+#pragma once
+
+#include "packed_voxel_vertex.h"
+#include "voxel_damage_lookup.h"
+#include "voxel_lod.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Lock-free handoff of meshing results from the remesh jobs to the main thread.
+// Each chunk has a 'latest result' slot; publishing a new result replaces any result the main
+// thread has not picked up yet. Results are recycled rather than freed, each slot keeps one spare.
+// Recycled results keep their buffers while the total kept is under c_maxRetainedBytes, so chunks that are
+// remeshed over and over (i.e. during combat) don't reallocate. Past that they are released.
+// Only one job may publish to a slot at a time, and only the main thread may consume
+class FloorMeshResults
+{
+public:
+	struct Result
+	{
+		std::vector<PackedVoxelVertex> m_vertices;
+		VoxelDamageLookup m_damage;
+		std::vector<PackedVoxelVertex> m_lodVertices[VoxelLod::c_lodCount - 1];	// Levels 1 and up, see VoxelMeshBuilder::LodVertices
+		uint32_t m_lodMask;		// Levels that were built, the chunk keeps its old meshes for the rest
+	};
+	static const size_t c_maxRetainedBytes = 8 * 1024 * 1024;
+
+	FloorMeshResults();
+	~FloorMeshResults();
+
+	void Create(uint32_t slotCount);
+	void Destroy();
+
+	// Returns an empty result to build into
+	Result* Acquire(uint32_t slot);
+	void Publish(uint32_t slot, Result* result);
+
+	// Returns the latest result for a slot, or null if there is nothing new. Pass it to Recycle when done
+	Result* Consume(uint32_t slot);
+	void Recycle(uint32_t slot, Result* result);
+
+private:
+	FloorMeshResults(const FloorMeshResults&) = delete;
+	FloorMeshResults& operator=(const FloorMeshResults&) = delete;
+
+	struct Slot
+	{
+		std::atomic<Result*> m_latest;	// Published, waiting for the main thread
+		std::atomic<Result*> m_spare;	// Recycled, ready for the next job
+	};
+	std::unique_ptr<Slot[]> m_slots;
+	std::atomic<size_t> m_retainedBytes;	// Buffers held by spare results
+	uint32_t m_slotCount;
+};
\ No newline at end of file
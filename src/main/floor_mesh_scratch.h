@@ -0,0 +1,11 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include "voxel_mesh_builder.h"
+
+// Borrowed by the floor remesh jobs (see JobScratchPool) so their buffers are reused instead of allocated each time
+struct FloorMeshScratch
+{
+	explicit FloorMeshScratch(const VoxelModel& model) : m_meshBuilder(model) {}
+	VoxelMeshBuilder m_meshBuilder;
+};
\ No newline at end of file
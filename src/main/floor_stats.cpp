@@ -1,24 +1,49 @@
 #include "floor_stats.h"
 #include "debug_gui/debug_gui_system.h"
+#include <cstring>
 
 FloorStats::FloorStats()
 	: m_writesPending(0)
 	, m_totalVertexBufferBytes(0)
 	, m_totalVoxelDataBytes(0)
+	, m_saveSnapshotBytes(0)
+	, m_uploadsPending(0)
+	, m_uploadBytesLastFrame(0)
+	, m_warmVoxelBytes(0)
+	, m_warmVoxelBudget(0)
 {
+	memset(&m_blockAllocatorStats, 0, sizeof(m_blockAllocatorStats));
+	memset(&m_storageStats, 0, sizeof(m_storageStats));
+	memset(m_chunksDrawn, 0, sizeof(m_chunksDrawn));
+	memset(m_trianglesDrawn, 0, sizeof(m_trianglesDrawn));
 }
 
 FloorStats::~FloorStats()
 {
 }
 
-void FloorStats::UpdateStats(const Math::Box3& bnds, const glm::vec3& secSize, int32_t wPending, size_t vbBytes, size_t vxBytes)
+void FloorStats::UpdateStats(const Math::Box3& bnds, const glm::vec3& secSize, int32_t wPending, size_t vbBytes, size_t vxBytes, size_t snapshotBytes,
+	size_t uploadsPending, size_t uploadBytes, const VoxelBlockAllocator::Stats& blockStats, size_t warmBytes, size_t warmBudget,
+	const SparseVoxelStorageStats& storageStats)
 {
 	m_bounds = bnds;
 	m_sectionSize = secSize;
 	m_writesPending = wPending;
 	m_totalVertexBufferBytes = vbBytes;
 	m_totalVoxelDataBytes = vxBytes;
+	m_saveSnapshotBytes = snapshotBytes;
+	m_uploadsPending = uploadsPending;
+	m_uploadBytesLastFrame = uploadBytes;
+	m_blockAllocatorStats = blockStats;
+	m_warmVoxelBytes = warmBytes;
+	m_warmVoxelBudget = warmBudget;
+	m_storageStats = storageStats;
+}
+
+void FloorStats::UpdateDrawStats(const uint32_t (&chunksDrawn)[VoxelLod::c_lodCount], const uint32_t (&trianglesDrawn)[VoxelLod::c_lodCount])
+{
+	memcpy(m_chunksDrawn, chunksDrawn, sizeof(m_chunksDrawn));
+	memcpy(m_trianglesDrawn, trianglesDrawn, sizeof(m_trianglesDrawn));
 }
 
 void FloorStats::showMemStat(DebugGui::DebugGuiSystem& gui, const char* txt, size_t val)
@@ -60,8 +85,34 @@ void FloorStats::DisplayDebugGui(DebugGui::DebugGuiSystem& gui)
 	sprintf_s(statsTxt, "Write jobs pending: %d", m_writesPending);
 	gui.Text(statsTxt);
 
+	sprintf_s(statsTxt, "Mesh uploads pending: %d", (int32_t)m_uploadsPending);
+	gui.Text(statsTxt);
+
+	for (uint32_t lod = 0; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		sprintf_s(statsTxt, "LOD %d: %d chunks, %d triangles drawn", lod, m_chunksDrawn[lod], m_trianglesDrawn[lod]);
+		gui.Text(statsTxt);
+	}
+
+	showMemStat(gui, "Uploaded Last Frame", m_uploadBytesLastFrame);
 	showMemStat(gui, "Vertex Buffer Memory", m_totalVertexBufferBytes);
 	showMemStat(gui, "Voxel Data Memory", m_totalVoxelDataBytes);
+	sprintf_s(statsTxt, "Packed blocks: %d unique, %d in use", m_storageStats.m_packedBlocks, m_storageStats.m_packedRefs);
+	gui.Text(statsTxt);
+	showMemStat(gui, "Packed Voxel Memory", m_storageStats.m_packedBytes);
+	showMemStat(gui, "Warm Voxel Memory", m_warmVoxelBytes);
+	showMemStat(gui, "Warm Voxel Budget", m_warmVoxelBudget);
+	showMemStat(gui, "Cold Voxel Memory", m_storageStats.m_coldBytes);
+	sprintf_s(statsTxt, "Cold blocks: %d (%d hits, %d misses)", m_storageStats.m_coldBlocks, m_storageStats.m_hits, m_storageStats.m_misses);
+	gui.Text(statsTxt);
+
+	sprintf_s(statsTxt, "Voxel blocks in use: %d (%d allocs, %d frees)", m_blockAllocatorStats.m_blocksInUse,
+		m_blockAllocatorStats.m_allocations, m_blockAllocatorStats.m_frees);
+	gui.Text(statsTxt);
+	sprintf_s(statsTxt, "Voxel block slabs: %d (%d huge pages)", m_blockAllocatorStats.m_slabCount, m_blockAllocatorStats.m_hugePageSlabs);
+	gui.Text(statsTxt);
+	showMemStat(gui, "Voxel Slab Memory", m_blockAllocatorStats.m_slabBytes);
+	showMemStat(gui, "Save Snapshot Memory", m_saveSnapshotBytes);
 
 	gui.EndWindow();
 }
\ No newline at end of file
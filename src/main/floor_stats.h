@@ -2,6 +2,9 @@
 
 #include "math/box3.h"
 #include "kernel/base_types.h"
+#include "voxel_block_allocator.h"
+#include "sparse_voxel_model.h"
+#include "voxel_lod.h"
 
 namespace DebugGui
 {
@@ -14,7 +17,10 @@ public:
 	FloorStats();
 	~FloorStats();
 
-	void UpdateStats(const Math::Box3& bnds, const glm::vec3& secSize, int32_t wPending, size_t vbBytes, size_t vxBytes);
+	void UpdateStats(const Math::Box3& bnds, const glm::vec3& secSize, int32_t wPending, size_t vbBytes, size_t vxBytes, size_t snapshotBytes,
+		size_t uploadsPending, size_t uploadBytes, const VoxelBlockAllocator::Stats& blockStats, size_t warmBytes, size_t warmBudget,
+		const SparseVoxelStorageStats& storageStats);
+	void UpdateDrawStats(const uint32_t (&chunksDrawn)[VoxelLod::c_lodCount], const uint32_t (&trianglesDrawn)[VoxelLod::c_lodCount]);
 	void DisplayDebugGui(DebugGui::DebugGuiSystem& gui);
 
 private:
@@ -24,5 +30,14 @@ private:
 	int32_t m_writesPending;
 	size_t m_totalVertexBufferBytes;
 	size_t m_totalVoxelDataBytes;
+	size_t m_saveSnapshotBytes;
+	size_t m_uploadsPending;
+	size_t m_uploadBytesLastFrame;
+	VoxelBlockAllocator::Stats m_blockAllocatorStats;
+	size_t m_warmVoxelBytes;
+	size_t m_warmVoxelBudget;
+	SparseVoxelStorageStats m_storageStats;
+	uint32_t m_chunksDrawn[VoxelLod::c_lodCount];		// Per LOD, last frame
+	uint32_t m_trianglesDrawn[VoxelLod::c_lodCount];
 	bool m_windowOpen;
 };
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "frustum_culler.h"
+#include "render/camera.h"
+#include "kernel/assert.h"
+#include <xmmintrin.h>
+#include <algorithm>
+
+CullingBoxList::CullingBoxList()
+	: m_count(0)
+{
+}
+
+void CullingBoxList::Clear()
+{
+	m_minX.clear();
+	m_minY.clear();
+	m_minZ.clear();
+	m_maxX.clear();
+	m_maxY.clear();
+	m_maxZ.clear();
+	m_count = 0;
+}
+
+void CullingBoxList::Reserve(uint32_t count)
+{
+	const uint32_t paddedCount = (count + 3) & ~3;
+	m_minX.reserve(paddedCount);
+	m_minY.reserve(paddedCount);
+	m_minZ.reserve(paddedCount);
+	m_maxX.reserve(paddedCount);
+	m_maxY.reserve(paddedCount);
+	m_maxZ.reserve(paddedCount);
+}
+
+uint32_t CullingBoxList::AddBox(const Math::Box3& box)
+{
+	// Keep the arrays a multiple of 4 long, so the simd loop never reads past the end.
+	// Padding entries are never reported as visible
+	if (m_count == m_minX.size())
+	{
+		m_minX.resize(m_count + 4, 0.0f);
+		m_minY.resize(m_count + 4, 0.0f);
+		m_minZ.resize(m_count + 4, 0.0f);
+		m_maxX.resize(m_count + 4, 0.0f);
+		m_maxY.resize(m_count + 4, 0.0f);
+		m_maxZ.resize(m_count + 4, 0.0f);
+	}
+	m_minX[m_count] = box.Min().x;
+	m_minY[m_count] = box.Min().y;
+	m_minZ[m_count] = box.Min().z;
+	m_maxX[m_count] = box.Max().x;
+	m_maxY[m_count] = box.Max().y;
+	m_maxZ[m_count] = box.Max().z;
+	return m_count++;
+}
+
+Math::Box3 CullingBoxList::GetBox(uint32_t index) const
+{
+	SDE_ASSERT(index < m_count);
+	return Math::Box3(glm::vec3(m_minX[index], m_minY[index], m_minZ[index]), glm::vec3(m_maxX[index], m_maxY[index], m_maxZ[index]));
+}
+
+FrustumCuller::FrustumCuller()
+{
+	for (auto& plane : m_planes)
+	{
+		plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);	// Everything visible
+	}
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
+
+void FrustumCuller::SetFromCamera(const Render::Camera& camera)
+{
+	SetFromMatrix(camera.ProjectionMatrix() * camera.ViewMatrix());
+}
+
+void FrustumCuller::SetFromMatrix(const glm::mat4& m)
+{
+	// Extract the clip planes directly from the view-projection matrix (Gribb/Hartmann)
+	// glm matrices are column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	m_planes[0] = row3 + row0;	// left
+	m_planes[1] = row3 - row0;	// right
+	m_planes[2] = row3 + row1;	// bottom
+	m_planes[3] = row3 - row1;	// top
+	m_planes[4] = row3 + row2;	// near
+	m_planes[5] = row3 - row2;	// far
+}
+
+bool FrustumCuller::IsVisible(const Math::Box3& box) const
+{
+	for (const auto& plane : m_planes)
+	{
+		// Test the corner furthest along the plane normal, if that is outside the whole box is
+		const glm::vec3 furthest(plane.x >= 0.0f ? box.Max().x : box.Min().x,
+			plane.y >= 0.0f ? box.Max().y : box.Min().y,
+			plane.z >= 0.0f ? box.Max().z : box.Min().z);
+		if ((plane.x * furthest.x) + (plane.y * furthest.y) + (plane.z * furthest.z) + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrustumCuller::CullBoxes(const CullingBoxList& boxes, std::vector<uint32_t>& visibleOut) const
+{
+	// The furthest corner only depends on the plane normal, so we can pick the min/max arrays
+	// per-plane and test 4 boxes at a time with no branches
+	const __m128 zero = _mm_setzero_ps();
+	for (uint32_t b = 0; b < boxes.Count(); b += 4)
+	{
+		__m128 outside = _mm_setzero_ps();
+		for (const auto& plane : m_planes)
+		{
+			const float* xs = plane.x >= 0.0f ? boxes.m_maxX.data() : boxes.m_minX.data();
+			const float* ys = plane.y >= 0.0f ? boxes.m_maxY.data() : boxes.m_minY.data();
+			const float* zs = plane.z >= 0.0f ? boxes.m_maxZ.data() : boxes.m_minZ.data();
+			__m128 distance = _mm_mul_ps(_mm_loadu_ps(xs + b), _mm_set1_ps(plane.x));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(ys + b), _mm_set1_ps(plane.y)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_loadu_ps(zs + b), _mm_set1_ps(plane.z)));
+			distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+		}
+
+		const uint32_t boxesInGroup = std::min(boxes.Count() - b, 4u);
+		const int32_t visibleMask = ~_mm_movemask_ps(outside) & ((1 << boxesInGroup) - 1);
+		for (uint32_t i = 0; i < boxesInGroup; ++i)
+		{
+			if (visibleMask & (1 << i))
+			{
+				visibleOut.push_back(b + i);
+			}
+		}
+	}
+}
+
+void FrustumCuller::SortFrontToBack(const CullingBoxList& boxes, const glm::vec3& eyePosition, std::vector<uint32_t>& indices)
+{
+	m_sortKeys.clear();
+	m_sortKeys.reserve(indices.size());
+	for (auto index : indices)
+	{
+		const Math::Box3 box = boxes.GetBox(index);
+		const glm::vec3 closest = glm::clamp(eyePosition, box.Min(), box.Max());
+		const glm::vec3 toBox = closest - eyePosition;
+		m_sortKeys.push_back({ glm::dot(toBox, toBox), index });
+	}
+
+	std::sort(m_sortKeys.begin(), m_sortKeys.end());
+	for (size_t i = 0; i < m_sortKeys.size(); ++i)
+	{
+		indices[i] = m_sortKeys[i].second;
+	}
+}
\ No newline at end of file
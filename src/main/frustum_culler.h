@@ -0,0 +1,53 @@
+#pragma once
+
+#include "math/box3.h"
+#include "kernel/base_types.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Render
+{
+	class Camera;
+}
+
+// A list of boxes stored as separate min/max arrays so the culler can test 4 at once
+class CullingBoxList
+{
+public:
+	CullingBoxList();
+
+	void Clear();
+	void Reserve(uint32_t count);
+	uint32_t AddBox(const Math::Box3& box);
+	Math::Box3 GetBox(uint32_t index) const;
+	inline uint32_t Count() const { return m_count; }
+
+private:
+	friend class FrustumCuller;
+	std::vector<float> m_minX, m_minY, m_minZ;	// Padded to a multiple of 4
+	std::vector<float> m_maxX, m_maxY, m_maxZ;
+	uint32_t m_count;
+};
+
+// Tests axis aligned boxes against a view frustum on the cpu
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	void SetFromCamera(const Render::Camera& camera);
+	void SetFromMatrix(const glm::mat4& viewProjection);
+
+	bool IsVisible(const Math::Box3& box) const;
+
+	// Appends the indices of all boxes that intersect the frustum to visibleOut
+	void CullBoxes(const CullingBoxList& boxes, std::vector<uint32_t>& visibleOut) const;
+
+	// Sorts box indices by distance from the eye to the closest point on each box
+	void SortFrontToBack(const CullingBoxList& boxes, const glm::vec3& eyePosition, std::vector<uint32_t>& indices);
+
+private:
+	glm::vec4 m_planes[6];	// xyz = normal (pointing inwards), w = distance
+	std::vector<std::pair<float, uint32_t>> m_sortKeys;
+};
\ No newline at end of file
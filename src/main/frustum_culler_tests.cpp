@@ -0,0 +1,99 @@
+#include "frustum_culler_tests.h"
+#include "frustum_culler.h"
+#include "render/camera.h"
+#include "sde/debug_camera_controller.h"
+#include "kernel/assert.h"
+#include <algorithm>
+
+namespace FrustumCullerTests
+{
+	// Camera in the middle of the floor, facing whichever way the debug controller starts
+	void SetupCamera(Render::Camera& camera, glm::vec3& position, glm::vec3& lookDir)
+	{
+		SDE::DebugCameraController controller;
+		controller.SetPosition(glm::vec3(64.0f, 4.0f, 64.0f));
+		camera.SetClipPlanes(0.1f, 256.0f);
+		camera.SetFOVAndAspectRatio(70.0f, 1280.0f / 720.0f);
+		controller.ApplyToCamera(camera);
+		position = camera.Position();
+		lookDir = glm::normalize(camera.Target() - camera.Position());
+	}
+
+	Math::Box3 BoxAt(const glm::vec3& center, float halfSize)
+	{
+		return Math::Box3(center - glm::vec3(halfSize), center + glm::vec3(halfSize));
+	}
+
+	void VisibilityTest()
+	{
+		Render::Camera camera;
+		glm::vec3 position, lookDir;
+		SetupCamera(camera, position, lookDir);
+
+		FrustumCuller culler;
+		culler.SetFromCamera(camera);
+		SDE_ASSERT(culler.IsVisible(BoxAt(position + lookDir * 10.0f, 1.0f)));		// In front
+		SDE_ASSERT(!culler.IsVisible(BoxAt(position - lookDir * 10.0f, 1.0f)));		// Behind
+		SDE_ASSERT(!culler.IsVisible(BoxAt(position + lookDir * 300.0f, 1.0f)));	// Past the far plane
+		SDE_ASSERT(culler.IsVisible(BoxAt(position, 4.0f)));						// Camera inside the box
+	}
+
+	void BatchMatchesSingleTest()
+	{
+		Render::Camera camera;
+		glm::vec3 position, lookDir;
+		SetupCamera(camera, position, lookDir);
+
+		FrustumCuller culler;
+		culler.SetFromCamera(camera);
+
+		// Odd count so the last simd group is partially filled
+		CullingBoxList boxes;
+		const glm::vec3 sideDir = glm::normalize(glm::cross(lookDir, glm::vec3(0.0f, 1.0f, 0.0f)));
+		for (int32_t i = 0; i < 11; ++i)
+		{
+			const float offset = (float)(i - 5) * 12.0f;
+			boxes.AddBox(BoxAt(position + (lookDir * offset) + (sideDir * (float)i), 0.5f));
+		}
+
+		std::vector<uint32_t> visible;
+		culler.CullBoxes(boxes, visible);
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < boxes.Count(); ++i)
+		{
+			const bool isVisible = std::find(visible.begin(), visible.end(), i) != visible.end();
+			SDE_ASSERT(isVisible == culler.IsVisible(boxes.GetBox(i)));
+			visibleCount += isVisible ? 1 : 0;
+		}
+		SDE_ASSERT(visibleCount == visible.size());
+		SDE_ASSERT(visibleCount > 0 && visibleCount < boxes.Count());
+	}
+
+	void FrontToBackTest()
+	{
+		Render::Camera camera;
+		glm::vec3 position, lookDir;
+		SetupCamera(camera, position, lookDir);
+
+		FrustumCuller culler;
+		culler.SetFromCamera(camera);
+
+		CullingBoxList boxes;
+		boxes.AddBox(BoxAt(position + lookDir * 50.0f, 1.0f));
+		boxes.AddBox(BoxAt(position + lookDir * 5.0f, 1.0f));
+		boxes.AddBox(BoxAt(position + lookDir * 20.0f, 1.0f));
+
+		std::vector<uint32_t> visible;
+		culler.CullBoxes(boxes, visible);
+		SDE_ASSERT(visible.size() == 3);
+		culler.SortFrontToBack(boxes, position, visible);
+		SDE_ASSERT(visible[0] == 1 && visible[1] == 2 && visible[2] == 0);
+	}
+
+	void RunTests()
+	{
+		VisibilityTest();
+		BatchMatchesSingleTest();
+		FrontToBackTest();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace FrustumCullerTests
+{
+	void RunTests();
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "kernel/mutex.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Scratch objects (buffers, builders, loaders) for jobs to borrow instead of allocating their own.
+// A job borrows one for as long as it runs and hands it back with whatever capacity it grew, so once
+// there is one per worker thread that needs it the pool stops allocating entirely.
+// The job system doesn't tell jobs which worker they are on, this stands in for per-worker storage
+template<class ScratchType>
+class JobScratchPool
+{
+public:
+	typedef std::function<std::unique_ptr<ScratchType>()> Factory;
+
+	// Returns the scratch object to the pool when it goes out of scope
+	class Lease
+	{
+	public:
+		Lease(JobScratchPool& pool, ScratchType* scratch) : m_pool(&pool), m_scratch(scratch) {}
+		Lease(Lease&& other) : m_pool(other.m_pool), m_scratch(other.m_scratch) { other.m_scratch = nullptr; }
+		~Lease();
+		inline ScratchType& operator*() const { return *m_scratch; }
+		inline ScratchType* operator->() const { return m_scratch; }
+
+	private:
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		JobScratchPool* m_pool;
+		ScratchType* m_scratch;
+	};
+
+	JobScratchPool();
+	~JobScratchPool();
+
+	void Create(const Factory& factory);
+	void Destroy();		// Everything must have been returned
+
+	Lease Borrow();
+	uint32_t ScratchCount();
+
+private:
+	JobScratchPool(const JobScratchPool&) = delete;
+	JobScratchPool& operator=(const JobScratchPool&) = delete;
+	void Return(ScratchType* scratch);
+
+	Kernel::Mutex m_lock;
+	Factory m_factory;
+	std::vector<std::unique_ptr<ScratchType>> m_all;
+	std::vector<ScratchType*> m_free;		// Always has room for everything in m_all, returning never allocates
+};
+
+#include "job_scratch_pool.inl"
\ No newline at end of file
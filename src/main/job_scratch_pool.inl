@@ -0,0 +1,68 @@
+#include "kernel/assert.h"
+
+template<class ScratchType>
+JobScratchPool<ScratchType>::Lease::~Lease()
+{
+	if (m_scratch != nullptr)
+	{
+		m_pool->Return(m_scratch);
+	}
+}
+
+template<class ScratchType>
+JobScratchPool<ScratchType>::JobScratchPool()
+{
+}
+
+template<class ScratchType>
+JobScratchPool<ScratchType>::~JobScratchPool()
+{
+	Destroy();
+}
+
+template<class ScratchType>
+void JobScratchPool<ScratchType>::Create(const Factory& factory)
+{
+	Kernel::ScopedMutex lock(m_lock);
+	SDE_ASSERT(m_all.empty(), "Already created");
+	m_factory = factory;
+}
+
+template<class ScratchType>
+void JobScratchPool<ScratchType>::Destroy()
+{
+	Kernel::ScopedMutex lock(m_lock);
+	SDE_ASSERT(m_free.size() == m_all.size(), "Scratch still borrowed");
+	m_free.clear();
+	m_all.clear();
+}
+
+template<class ScratchType>
+typename JobScratchPool<ScratchType>::Lease JobScratchPool<ScratchType>::Borrow()
+{
+	Kernel::ScopedMutex lock(m_lock);
+	if (m_free.empty())
+	{
+		SDE_ASSERT(m_factory != nullptr, "Pool not created");
+		m_all.push_back(m_factory());
+		m_free.reserve(m_all.size());
+		return Lease(*this, m_all.back().get());
+	}
+	ScratchType* scratch = m_free.back();
+	m_free.pop_back();
+	return Lease(*this, scratch);
+}
+
+template<class ScratchType>
+void JobScratchPool<ScratchType>::Return(ScratchType* scratch)
+{
+	Kernel::ScopedMutex lock(m_lock);
+	m_free.push_back(scratch);
+}
+
+template<class ScratchType>
+uint32_t JobScratchPool<ScratchType>::ScratchCount()
+{
+	Kernel::ScopedMutex lock(m_lock);
+	return (uint32_t)m_all.size();
+}
\ No newline at end of file
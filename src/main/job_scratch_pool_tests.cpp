@@ -0,0 +1,169 @@
+#include "job_scratch_pool_tests.h"
+#include "job_scratch_pool.h"
+#include "floor_edit_queue.h"
+#include "floor_mesh_results.h"
+#include "floor_mesh_scratch.h"
+#include "voxel_brush.h"
+#include "voxel_material.h"
+#include "kernel/assert.h"
+
+namespace JobScratchPoolTests
+{
+	size_t BrushScratchBytes()
+	{
+		auto scratch = VoxelBrushList::RowScratchPool().Borrow();
+		return scratch->m_xPositions.capacity() * sizeof(float) + (scratch->m_row.capacity() + scratch->m_originalRow.capacity()) * sizeof(VoxelData)
+			+ scratch->m_rowBrushes.capacity() * sizeof(const VoxelBrush*);
+	}
+
+	// Queues the brushes against the block and applies them, the same way the floor drain jobs do
+	void ApplyBrushes(VoxelModel& model, FloorEditQueue& queue, const VoxelBrushList& brushes)
+	{
+		queue.Push(brushes.Bounds(), brushes);
+		Vox::ModelAreaDataWriter<VoxelModel> areaWriter(model);
+		const uint32_t editsDrained = queue.Drain([&areaWriter](const FloorEditQueue::Edit& edit)
+		{
+			areaWriter.WriteArea(edit.m_bounds, edit.m_callback);
+		});
+		SDE_ASSERT(editsDrained == 1);
+	}
+
+	void PoolReuseTest()
+	{
+		JobScratchPool<int> pool;
+		pool.Create([]()
+		{
+			return std::make_unique<int>(0);
+		});
+		int* first = nullptr;
+		int* second = nullptr;
+		{
+			auto a = pool.Borrow();
+			auto b = pool.Borrow();
+			first = &*a;
+			second = &*b;
+			SDE_ASSERT(first != second);
+			*a = 1;
+		}
+		SDE_ASSERT(pool.ScratchCount() == 2);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			auto c = pool.Borrow();
+			SDE_ASSERT(&*c == first || &*c == second);
+		}
+		SDE_ASSERT(pool.ScratchCount() == 2);
+		pool.Destroy();
+	}
+
+	// Edit a block through the edit queue and brushes, then remesh it the same way the floor remesh jobs and main
+	// thread pass the results around. Once warmed up every pass must get the same edit node, scratch and result
+	// back, and none of their buffers may grow
+	void SteadyRemeshTest()
+	{
+		const uint32_t c_stateCount = 4;
+		const uint32_t c_warmupPasses = c_stateCount;
+		const uint32_t c_steadyPasses = 5 * c_stateCount;
+
+		VoxelModel model;
+		model.SetVoxelSize(glm::vec3(0.125f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(4.0f)));
+		auto block = model.BlockAt(glm::ivec3(0));
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t x = 0; x < 32; ++x)
+			{
+				for (uint32_t y = 0; y < 8; ++y)
+				{
+					block->VoxelAt(x, y, z) = PackVoxel(y < 2 ? Materials::Floor : Materials::Walls, 0);
+				}
+			}
+		}
+		VoxelMaterialSet materials;
+		const Math::Box3 chunkBounds(glm::vec3(0.0f), glm::vec3(4.0f));
+		const float voxelSize = model.GetVoxelSize().x;
+		FloorEditQueue editQueue;
+		VoxelBrushList brushes;
+
+		JobScratchPool<FloorMeshScratch> pool;
+		pool.Create([&model]()
+		{
+			return std::make_unique<FloorMeshScratch>(model);
+		});
+		FloorMeshResults results;
+		results.Create(1);
+
+		uint32_t vertexCount = 0;
+		FloorMeshScratch* steadyScratch = nullptr;
+		size_t steadyScratchBytes = 0;
+		size_t steadyBrushBytes = 0;
+		FloorMeshResults::Result* steadyResult = nullptr;
+		size_t steadyResultBytes = 0;
+		for (uint32_t pass = 0; pass < c_warmupPasses + c_steadyPasses; ++pass)
+		{
+			// Shots carve holes and damage voxels around them
+			const uint32_t state = pass % c_stateCount;
+			const float holeX = (4.0f + (state * 6.0f)) * voxelSize;
+			const glm::vec3 holeMin(holeX, 7.0f * voxelSize, 10.0f * voxelSize);
+			const glm::vec3 holeMax(holeX + (4.0f * voxelSize), 8.0f * voxelSize, 14.0f * voxelSize);
+			const glm::vec3 damageMin(holeMin.x, 6.0f * voxelSize, holeMin.z);
+			brushes.Clear();
+			brushes.Add(VoxelBrush::MakeBox(holeMin, holeMax, VoxelBrush::Operation::Subtract));
+			for (uint32_t d = 0; d < 1 + state % 3; ++d)
+			{
+				brushes.Add(VoxelBrush::MakeBox(damageMin, glm::vec3(holeMax.x, holeMin.y, holeMax.z), VoxelBrush::Operation::Damage));
+			}
+			ApplyBrushes(model, editQueue, brushes);
+			SDE_ASSERT(model.ReadVoxel(glm::ivec3(0), 4 + (state * 6), 7, 10) == 0, "The brushes carved the hole");
+
+			{
+				auto scratch = pool.Borrow();
+				FloorMeshResults::Result* result = results.Acquire(0);
+				scratch->m_meshBuilder.BuildMeshData(materials, chunkBounds, result->m_vertices, result->m_damage);
+				scratch->m_meshBuilder.BuildLodMeshData(materials, chunkBounds, VoxelLod::c_allLevels, result->m_lodVertices);
+				size_t resultBytes = result->m_vertices.capacity();
+				for (const auto& lodVertices : result->m_lodVertices)
+				{
+					resultBytes += lodVertices.capacity();
+				}
+				resultBytes *= sizeof(PackedVoxelVertex);
+				if (pass == c_warmupPasses)
+				{
+					steadyScratch = &*scratch;
+					steadyScratchBytes = scratch->m_meshBuilder.ScratchBytes();
+					steadyResult = result;
+					steadyResultBytes = resultBytes;
+					steadyBrushBytes = BrushScratchBytes();
+				}
+				else if (pass > c_warmupPasses)
+				{
+					SDE_ASSERT(&*scratch == steadyScratch && scratch->m_meshBuilder.ScratchBytes() == steadyScratchBytes, "Mesh builder scratch grew after warming up");
+					SDE_ASSERT(result == steadyResult && resultBytes == steadyResultBytes, "Result buffers grew after warming up");
+					SDE_ASSERT(BrushScratchBytes() == steadyBrushBytes, "Brush row buffers grew after warming up");
+				}
+				results.Publish(0, result);
+			}
+			FloorMeshResults::Result* uploaded = results.Consume(0);
+			SDE_ASSERT(uploaded != nullptr && !uploaded->m_damage.IsEmpty());
+			vertexCount = (uint32_t)uploaded->m_vertices.size();
+			results.Recycle(0, uploaded);
+
+			// Restore the block so every state starts from the same data
+			brushes.Clear();
+			brushes.Add(VoxelBrush::MakeBox(damageMin, holeMax, VoxelBrush::Operation::Union, PackVoxel(Materials::Walls, 0)));
+			ApplyBrushes(model, editQueue, brushes);
+		}
+		SDE_ASSERT(vertexCount > 0 && steadyScratchBytes > 0 && steadyBrushBytes > 0);
+		SDE_ASSERT(pool.ScratchCount() == 1);
+		SDE_ASSERT(editQueue.EditNodeCount() == 1, "Edit nodes are reused once drained");
+		SDE_ASSERT(VoxelBrushList::RowScratchPool().ScratchCount() == 1);
+
+		results.Destroy();
+		pool.Destroy();
+	}
+
+	void RunTests()
+	{
+		PoolReuseTest();
+		SteadyRemeshTest();
+	}
+}
\ No newline at end of file
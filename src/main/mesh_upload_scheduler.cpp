@@ -0,0 +1,82 @@
+#include "mesh_upload_scheduler.h"
+#include <algorithm>
+
+MeshUploadScheduler::MeshUploadScheduler()
+	: m_maxBytesPerFrame(4 * 1024 * 1024)
+	, m_maxSecondsPerFrame(0.002)
+	, m_lastFrameBytes(0)
+{
+}
+
+MeshUploadScheduler::~MeshUploadScheduler()
+{
+}
+
+void MeshUploadScheduler::SetBudget(size_t maxBytesPerFrame, double maxSecondsPerFrame)
+{
+	m_maxBytesPerFrame = maxBytesPerFrame;
+	m_maxSecondsPerFrame = maxSecondsPerFrame;
+}
+
+void MeshUploadScheduler::AddPending(uint32_t meshIndex)
+{
+	if (meshIndex >= m_isPending.size())
+	{
+		m_isPending.resize(meshIndex + 1, 0);
+	}
+	if (m_isPending[meshIndex] == 0)
+	{
+		m_isPending[meshIndex] = 1;
+		m_pending.push_back({ meshIndex, 0.0f });
+	}
+}
+
+void MeshUploadScheduler::Clear()
+{
+	for (const auto& upload : m_pending)
+	{
+		m_isPending[upload.m_meshIndex] = 0;
+	}
+	m_pending.clear();
+}
+
+uint32_t MeshUploadScheduler::UploadPending(MeshUploadSink& sink)
+{
+	m_lastFrameBytes = 0;
+	if (m_pending.size() == 0)
+	{
+		return 0;
+	}
+
+	// The camera moves, so the order is rebuilt every frame
+	for (auto& upload : m_pending)
+	{
+		upload.m_distance = sink.MeshDistance(upload.m_meshIndex);
+	}
+	std::sort(m_pending.begin(), m_pending.end(), [](const PendingUpload& u0, const PendingUpload& u1)
+	{
+		return u0.m_distance < u1.m_distance;
+	});
+
+	const uint64_t startTicks = m_timer.GetTicks();
+	const double ticksToSeconds = 1.0 / (double)m_timer.GetFrequency();
+	uint32_t uploaded = 0;
+	while (uploaded < m_pending.size())
+	{
+		if (uploaded > 0)
+		{
+			const double elapsedSeconds = (double)(m_timer.GetTicks() - startTicks) * ticksToSeconds;
+			if (m_lastFrameBytes >= m_maxBytesPerFrame || elapsedSeconds >= m_maxSecondsPerFrame)
+			{
+				break;
+			}
+		}
+		const uint32_t meshIndex = m_pending[uploaded].m_meshIndex;
+		m_isPending[meshIndex] = 0;
+		m_lastFrameBytes += sink.UploadMesh(meshIndex);
+		++uploaded;
+	}
+	m_pending.erase(m_pending.begin(), m_pending.begin() + uploaded);
+
+	return uploaded;
+}
\ No newline at end of file
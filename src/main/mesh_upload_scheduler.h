@@ -0,0 +1,53 @@
+#pragma once
+
+#include "kernel/base_types.h"
+#include "core/timer.h"
+#include <vector>
+
+// Whatever owns the meshes being uploaded. Meshes are referred to by index only
+class MeshUploadSink
+{
+public:
+	virtual ~MeshUploadSink() { }
+
+	// Upload the latest data for a mesh, returns the number of bytes sent to the gpu
+	virtual size_t UploadMesh(uint32_t meshIndex) = 0;
+
+	// Used to order the uploads, nearest first
+	virtual float MeshDistance(uint32_t meshIndex) const = 0;
+};
+
+// Spreads mesh uploads over multiple frames. Each frame uploads the nearest pending meshes until
+// either the byte or time budget runs out; anything left over is carried into the next frame.
+// At least one mesh is uploaded per frame so we always make progress
+class MeshUploadScheduler
+{
+public:
+	MeshUploadScheduler();
+	~MeshUploadScheduler();
+
+	void SetBudget(size_t maxBytesPerFrame, double maxSecondsPerFrame);
+
+	// Adding a mesh that is already pending does nothing, it only gets uploaded once
+	void AddPending(uint32_t meshIndex);
+	void Clear();
+
+	// Returns the number of meshes uploaded
+	uint32_t UploadPending(MeshUploadSink& sink);
+
+	inline size_t QueueDepth() const { return m_pending.size(); }
+	inline size_t LastFrameBytes() const { return m_lastFrameBytes; }
+
+private:
+	struct PendingUpload
+	{
+		uint32_t m_meshIndex;
+		float m_distance;
+	};
+	std::vector<PendingUpload> m_pending;
+	std::vector<uint8_t> m_isPending;	// Indexed by mesh index
+	size_t m_maxBytesPerFrame;
+	double m_maxSecondsPerFrame;
+	size_t m_lastFrameBytes;
+	Core::Timer m_timer;
+};
\ No newline at end of file
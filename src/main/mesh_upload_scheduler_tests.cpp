@@ -0,0 +1,142 @@
+#include "mesh_upload_scheduler_tests.h"
+#include "mesh_upload_scheduler.h"
+#include "kernel/assert.h"
+#include <vector>
+
+namespace MeshUploadSchedulerTests
+{
+	// Records the uploads instead of touching the gpu
+	class StubMeshSink : public MeshUploadSink
+	{
+	public:
+		StubMeshSink(uint32_t meshCount, size_t bytesPerMesh)
+			: m_distances(meshCount, 0.0f)
+			, m_bytesPerMesh(bytesPerMesh)
+			, m_secondsPerUpload(0.0)
+		{
+		}
+		virtual ~StubMeshSink() { }
+		virtual size_t UploadMesh(uint32_t meshIndex)
+		{
+			// Simulate a slow upload
+			const uint64_t startTicks = m_timer.GetTicks();
+			while ((double)(m_timer.GetTicks() - startTicks) / (double)m_timer.GetFrequency() < m_secondsPerUpload)
+			{
+			}
+			m_uploads.push_back(meshIndex);
+			return m_bytesPerMesh;
+		}
+		virtual float MeshDistance(uint32_t meshIndex) const
+		{
+			return m_distances[meshIndex];
+		}
+
+		std::vector<float> m_distances;
+		std::vector<uint32_t> m_uploads;
+		size_t m_bytesPerMesh;
+		double m_secondsPerUpload;
+		Core::Timer m_timer;
+	};
+
+	void ByteBudgetTest()
+	{
+		StubMeshSink sink(10, 1000);
+		MeshUploadScheduler scheduler;
+		scheduler.SetBudget(2500, 1000.0);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			scheduler.AddPending(i);
+		}
+
+		// We stop once the budget is used up, so the last upload can go over it
+		SDE_ASSERT(scheduler.UploadPending(sink) == 3);
+		SDE_ASSERT(scheduler.LastFrameBytes() == 3000);
+		SDE_ASSERT(scheduler.QueueDepth() == 7);
+
+		// Leftovers carry over until everything is uploaded
+		uint32_t frames = 1;
+		while (scheduler.QueueDepth() > 0)
+		{
+			scheduler.UploadPending(sink);
+			++frames;
+		}
+		SDE_ASSERT(frames == 4);
+		SDE_ASSERT(sink.m_uploads.size() == 10);
+		SDE_ASSERT(scheduler.UploadPending(sink) == 0);
+	}
+
+	void NearestFirstTest()
+	{
+		StubMeshSink sink(8, 100);
+		MeshUploadScheduler scheduler;
+		scheduler.SetBudget(200, 1000.0);
+		const float distances[] = { 50.0f, 10.0f, 70.0f, 0.0f, 30.0f, 20.0f, 60.0f, 40.0f };
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			sink.m_distances[i] = distances[i];
+			scheduler.AddPending(i);
+		}
+
+		scheduler.UploadPending(sink);
+		SDE_ASSERT(sink.m_uploads.size() == 2);
+		SDE_ASSERT(sink.m_uploads[0] == 3 && sink.m_uploads[1] == 1);
+
+		// The camera moved, the order is rebuilt
+		sink.m_distances[2] = 1.0f;
+		scheduler.UploadPending(sink);
+		SDE_ASSERT(sink.m_uploads[2] == 2 && sink.m_uploads[3] == 5);
+	}
+
+	void DuplicatesTest()
+	{
+		StubMeshSink sink(4, 100);
+		MeshUploadScheduler scheduler;
+		scheduler.SetBudget(1024 * 1024, 1000.0);
+		scheduler.AddPending(2);
+		scheduler.AddPending(2);
+		scheduler.AddPending(1);
+		scheduler.AddPending(2);
+		SDE_ASSERT(scheduler.QueueDepth() == 2);
+		SDE_ASSERT(scheduler.UploadPending(sink) == 2);
+
+		// Once uploaded it can be queued again
+		scheduler.AddPending(2);
+		SDE_ASSERT(scheduler.QueueDepth() == 1);
+	}
+
+	void AlwaysProgressTest()
+	{
+		StubMeshSink sink(4, 100);
+		MeshUploadScheduler scheduler;
+		scheduler.SetBudget(0, 0.0);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			scheduler.AddPending(i);
+		}
+		SDE_ASSERT(scheduler.UploadPending(sink) == 1);
+		SDE_ASSERT(scheduler.QueueDepth() == 3);
+	}
+
+	void TimeBudgetTest()
+	{
+		StubMeshSink sink(100, 1);
+		sink.m_secondsPerUpload = 0.001;
+		MeshUploadScheduler scheduler;
+		scheduler.SetBudget(1024 * 1024, 0.003);
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			scheduler.AddPending(i);
+		}
+		const uint32_t uploaded = scheduler.UploadPending(sink);
+		SDE_ASSERT(uploaded >= 3 && uploaded < 100);
+	}
+
+	void RunTests()
+	{
+		ByteBudgetTest();
+		NearestFirstTest();
+		DuplicatesTest();
+		AlwaysProgressTest();
+		TimeBudgetTest();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "kernel/base_types.h"
+#include <glm/glm.hpp>
+
+// 8 byte vertex for voxel chunk meshes, read by voxel_floor_vertex.txt
+// The mesh api only has float attributes, so each word is an integer below 2^24 stored in a float (exact, no nans or denormals)
+//	m_position: x | y << 6 | z << 12 | normal << 18		Voxel corner inside the chunk (0 - 32), normal is the quad normal index (0 - 5)
+//	m_material: texture layer | r << 8 | g << 13 | b << 18	Material colour quantised to 5 bits per channel
+struct PackedVoxelVertex
+{
+	float m_position;
+	float m_material;
+};
+static_assert(sizeof(PackedVoxelVertex) == 8, "Packed vertex should be 2 words");
+
+namespace PackedVoxelVertexFormat
+{
+	static const uint32_t c_maxCorner = 63;			// 6 bits per axis
+	static const uint32_t c_verticesPerQuad = 6;	// 2 triangles, no index buffers in the mesh api
+	static const uint32_t c_unpackedVertexBytes = (3 + 4 + 3 + 1) * sizeof(float);	// Old format, position/colour/uv/normal streams
+
+	inline float PackPosition(const glm::uvec3& corner, uint32_t normal)
+	{
+		return (float)(corner.x | (corner.y << 6) | (corner.z << 12) | (normal << 18));
+	}
+
+	inline float PackMaterial(uint32_t textureLayer, const glm::vec4& colour)
+	{
+		const glm::uvec3 rgb = glm::uvec3(glm::clamp(glm::vec3(colour), 0.0f, 1.0f) * 31.0f + 0.5f);
+		return (float)((textureLayer & 0xff) | (rgb.x << 8) | (rgb.y << 13) | (rgb.z << 18));
+	}
+
+	inline void UnpackPosition(float packed, glm::uvec3& corner, uint32_t& normal)
+	{
+		const uint32_t bits = (uint32_t)packed;
+		corner = glm::uvec3(bits & 63, (bits >> 6) & 63, (bits >> 12) & 63);
+		normal = bits >> 18;
+	}
+
+	inline void UnpackMaterial(float packed, uint32_t& textureLayer, glm::vec3& colour)
+	{
+		const uint32_t bits = (uint32_t)packed;
+		textureLayer = bits & 0xff;
+		colour = glm::vec3((bits >> 8) & 31, (bits >> 13) & 31, (bits >> 18) & 31) / 31.0f;
+	}
+
+	inline size_t VertexBytesForQuads(size_t quadCount)
+	{
+		return quadCount * c_verticesPerQuad * sizeof(PackedVoxelVertex);
+	}
+
+	inline size_t UnpackedVertexBytesForQuads(size_t quadCount)
+	{
+		return quadCount * c_verticesPerQuad * c_unpackedVertexBytes;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "packed_voxel_vertex_tests.h"
+#include "voxel_mesh_builder.h"
+#include "voxel_material.h"
+#include "kernel/assert.h"
+#include <cmath>
+#include <vector>
+
+namespace PackedVoxelVertexTests
+{
+	// Packed words must be plain integers a float holds exactly, anything else gets mangled on the way to the gpu
+	bool IsExactInteger(float f)
+	{
+		return f >= 0.0f && f < (float)(1 << 24) && std::floor(f) == f;
+	}
+
+	void PositionRoundTripTest()
+	{
+		for (uint32_t normal = 0; normal < 6; ++normal)
+		{
+			for (uint32_t z = 0; z <= 32; ++z)
+			{
+				for (uint32_t y = 0; y <= 32; ++y)
+				{
+					for (uint32_t x = 0; x <= 32; ++x)
+					{
+						const float packed = PackedVoxelVertexFormat::PackPosition(glm::uvec3(x, y, z), normal);
+						SDE_ASSERT(IsExactInteger(packed));
+						glm::uvec3 corner;
+						uint32_t unpackedNormal;
+						PackedVoxelVertexFormat::UnpackPosition(packed, corner, unpackedNormal);
+						SDE_ASSERT(corner == glm::uvec3(x, y, z) && unpackedNormal == normal);
+					}
+				}
+			}
+		}
+	}
+
+	void MaterialRoundTripTest()
+	{
+		for (uint32_t layer = 0; layer < 256; ++layer)
+		{
+			const glm::vec4 colour((float)layer / 255.0f, 1.0f - ((float)layer / 255.0f), 0.5f, 1.0f);
+			const float packed = PackedVoxelVertexFormat::PackMaterial(layer, colour);
+			SDE_ASSERT(IsExactInteger(packed));
+			uint32_t unpackedLayer;
+			glm::vec3 unpackedColour;
+			PackedVoxelVertexFormat::UnpackMaterial(packed, unpackedLayer, unpackedColour);
+			SDE_ASSERT(unpackedLayer == layer);
+			SDE_ASSERT(glm::all(glm::lessThanEqual(glm::abs(unpackedColour - glm::vec3(colour)), glm::vec3(0.5f / 31.0f + 0.0001f))));
+		}
+
+		// Out of range colours are clamped rather than spilling into the other channels
+		uint32_t layer;
+		glm::vec3 colour;
+		PackedVoxelVertexFormat::UnpackMaterial(PackedVoxelVertexFormat::PackMaterial(3, glm::vec4(2.0f, -1.0f, 1.0f, 1.0f)), layer, colour);
+		SDE_ASSERT(layer == 3 && colour == glm::vec3(1.0f, 0.0f, 1.0f));
+	}
+
+	void QuadTest()
+	{
+		VoxelMaterial material;
+		material.Colour() = glm::vec4(1.0f);
+		material.TextureIndex() = 4.0f;
+		const glm::uvec3 corners[4] = { glm::uvec3(0, 0, 0), glm::uvec3(32, 0, 0), glm::uvec3(32, 0, 32), glm::uvec3(0, 0, 32) };
+		std::vector<PackedVoxelVertex> vertices;
+		VoxelMeshBuilder::AppendQuad(corners, 3, material, vertices);
+		SDE_ASSERT(vertices.size() == PackedVoxelVertexFormat::c_verticesPerQuad);
+
+		const uint32_t expectedCorners[] = { 0, 1, 2, 0, 2, 3 };
+		for (uint32_t v = 0; v < vertices.size(); ++v)
+		{
+			glm::uvec3 corner;
+			uint32_t normal, layer;
+			glm::vec3 colour;
+			PackedVoxelVertexFormat::UnpackPosition(vertices[v].m_position, corner, normal);
+			PackedVoxelVertexFormat::UnpackMaterial(vertices[v].m_material, layer, colour);
+			SDE_ASSERT(corner == corners[expectedCorners[v]] && normal == 3);
+			SDE_ASSERT(layer == 4 && colour == glm::vec3(1.0f));
+		}
+	}
+
+	void ByteCountTest()
+	{
+		SDE_ASSERT(sizeof(PackedVoxelVertex) == 8);
+		SDE_ASSERT(PackedVoxelVertexFormat::c_unpackedVertexBytes == 44);
+		SDE_ASSERT(PackedVoxelVertexFormat::VertexBytesForQuads(1) == 48);
+		SDE_ASSERT(PackedVoxelVertexFormat::UnpackedVertexBytesForQuads(1) == 264);
+		SDE_ASSERT(PackedVoxelVertexFormat::UnpackedVertexBytesForQuads(1000) >= 5 * PackedVoxelVertexFormat::VertexBytesForQuads(1000));
+	}
+
+	void RunTests()
+	{
+		PositionRoundTripTest();
+		MaterialRoundTripTest();
+		QuadTest();
+		ByteCountTest();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "kernel/base_types.h"
+#include <vector>
+
+// Block of voxels stored as a small palette + 1/2/4 bit indices (x-major, same order as SparseVoxelBlock).
+// Blocks with more than 16 distinct values cannot be encoded and must stay as full blocks
+template<class VoxelData, uint32_t Dimensions>
+class PaletteVoxelBlock
+{
+public:
+	static const uint32_t c_maxPaletteSize = 16;
+	static const uint32_t c_voxelCount = Dimensions * Dimensions * Dimensions;
+
+	PaletteVoxelBlock();
+	~PaletteVoxelBlock();
+
+	// Returns false if there are too many distinct values
+	bool Encode(const VoxelData* voxels);
+	void Decode(VoxelData* voxels) const;
+
+	// Decodes one x-axis row of Dimensions voxels
+	void DecodeRow(uint32_t y, uint32_t z, VoxelData* row) const;
+	inline VoxelData VoxelAt(uint32_t x, uint32_t y, uint32_t z) const;
+
+	// Adding a new value may re-encode the indices with more bits. Returns false if the palette is full
+	bool SetVoxel(uint32_t x, uint32_t y, uint32_t z, VoxelData value);
+
+	// Encoding is deterministic, so blocks with the same voxels have the same palette + indices
+	uint64_t Hash() const;
+	bool operator==(const PaletteVoxelBlock& other) const;
+
+	inline uint32_t PaletteSize() const { return m_paletteSize; }
+	inline uint32_t BitsPerIndex() const { return m_bitsPerIndex; }
+	size_t MemoryBytes() const;
+
+private:
+	static uint32_t BitsForPaletteSize(uint32_t paletteSize);
+	void Repack(uint32_t newBitsPerIndex);
+	inline uint32_t IndexAt(uint32_t voxelIndex) const;
+	inline void SetIndex(uint32_t voxelIndex, uint32_t paletteIndex);
+
+	VoxelData m_palette[c_maxPaletteSize];
+	uint32_t m_paletteSize;
+	uint32_t m_bitsPerIndex;
+	std::vector<uint64_t> m_indices;	// Indices never straddle words, 64 is a multiple of every width
+};
+
+#include "palette_voxel_block.inl"
\ No newline at end of file
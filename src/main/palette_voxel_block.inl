@@ -0,0 +1,216 @@
+#include "kernel/assert.h"
+
+template<class VoxelData, uint32_t Dimensions>
+PaletteVoxelBlock<VoxelData, Dimensions>::PaletteVoxelBlock()
+	: m_paletteSize(0)
+	, m_bitsPerIndex(1)
+{
+	static_assert((Dimensions * Dimensions) % 64 == 0, "Rows of indices must pack into whole words");
+}
+
+template<class VoxelData, uint32_t Dimensions>
+PaletteVoxelBlock<VoxelData, Dimensions>::~PaletteVoxelBlock()
+{
+}
+
+template<class VoxelData, uint32_t Dimensions>
+uint32_t PaletteVoxelBlock<VoxelData, Dimensions>::BitsForPaletteSize(uint32_t paletteSize)
+{
+	return paletteSize <= 2 ? 1 : (paletteSize <= 4 ? 2 : 4);
+}
+
+template<class VoxelData, uint32_t Dimensions>
+size_t PaletteVoxelBlock<VoxelData, Dimensions>::MemoryBytes() const
+{
+	return sizeof(*this) + (m_indices.capacity() * sizeof(uint64_t));
+}
+
+template<class VoxelData, uint32_t Dimensions>
+inline uint32_t PaletteVoxelBlock<VoxelData, Dimensions>::IndexAt(uint32_t voxelIndex) const
+{
+	const uint32_t bitOffset = voxelIndex * m_bitsPerIndex;
+	const uint64_t mask = (1ull << m_bitsPerIndex) - 1;
+	return (uint32_t)((m_indices[bitOffset >> 6] >> (bitOffset & 63)) & mask);
+}
+
+template<class VoxelData, uint32_t Dimensions>
+inline void PaletteVoxelBlock<VoxelData, Dimensions>::SetIndex(uint32_t voxelIndex, uint32_t paletteIndex)
+{
+	const uint32_t bitOffset = voxelIndex * m_bitsPerIndex;
+	const uint64_t mask = ((1ull << m_bitsPerIndex) - 1) << (bitOffset & 63);
+	uint64_t& word = m_indices[bitOffset >> 6];
+	word = (word & ~mask) | (((uint64_t)paletteIndex << (bitOffset & 63)) & mask);
+}
+
+template<class VoxelData, uint32_t Dimensions>
+bool PaletteVoxelBlock<VoxelData, Dimensions>::Encode(const VoxelData* voxels)
+{
+	// Build the palette first, so we know how many bits we need. The lookup is tiny, a linear search is fine
+	uint32_t paletteSize = 0;
+	VoxelData lastValue = voxels[0];
+	m_palette[paletteSize++] = lastValue;
+	for (uint32_t v = 1; v < c_voxelCount; ++v)
+	{
+		if (voxels[v] == lastValue)		// Runs are common, skip the search
+		{
+			continue;
+		}
+		lastValue = voxels[v];
+		uint32_t p = 0;
+		while (p < paletteSize && m_palette[p] != lastValue)
+		{
+			++p;
+		}
+		if (p == paletteSize)
+		{
+			if (paletteSize == c_maxPaletteSize)
+			{
+				return false;
+			}
+			m_palette[paletteSize++] = lastValue;
+		}
+	}
+
+	m_paletteSize = paletteSize;
+	m_bitsPerIndex = BitsForPaletteSize(paletteSize);
+	m_indices.assign((c_voxelCount * m_bitsPerIndex) / 64, 0);
+	m_indices.shrink_to_fit();
+
+	uint32_t lastIndex = 0;
+	lastValue = m_palette[0];
+	for (uint32_t v = 0; v < c_voxelCount; ++v)
+	{
+		if (voxels[v] != lastValue)
+		{
+			lastValue = voxels[v];
+			lastIndex = 0;
+			while (m_palette[lastIndex] != lastValue)
+			{
+				++lastIndex;
+			}
+		}
+		const uint32_t bitOffset = v * m_bitsPerIndex;
+		m_indices[bitOffset >> 6] |= (uint64_t)lastIndex << (bitOffset & 63);
+	}
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions>
+void PaletteVoxelBlock<VoxelData, Dimensions>::DecodeRow(uint32_t y, uint32_t z, VoxelData* row) const
+{
+	// Rows start on an index boundary, so we can walk the words directly
+	const uint32_t firstVoxel = (y * Dimensions) + (z * Dimensions * Dimensions);
+	const uint32_t bitOffset = firstVoxel * m_bitsPerIndex;
+	const uint64_t* word = &m_indices[bitOffset >> 6];
+	const uint32_t indicesPerWord = 64 / m_bitsPerIndex;
+	const uint64_t mask = (1ull << m_bitsPerIndex) - 1;
+	uint64_t bits = *word >> (bitOffset & 63);
+	uint32_t remainingInWord = indicesPerWord - ((bitOffset & 63) / m_bitsPerIndex);
+	for (uint32_t x = 0; x < Dimensions; ++x)
+	{
+		if (remainingInWord == 0)
+		{
+			bits = *(++word);
+			remainingInWord = indicesPerWord;
+		}
+		row[x] = m_palette[bits & mask];
+		bits >>= m_bitsPerIndex;
+		--remainingInWord;
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions>
+void PaletteVoxelBlock<VoxelData, Dimensions>::Decode(VoxelData* voxels) const
+{
+	for (uint32_t z = 0; z < Dimensions; ++z)
+	{
+		for (uint32_t y = 0; y < Dimensions; ++y)
+		{
+			DecodeRow(y, z, voxels + (y * Dimensions) + (z * Dimensions * Dimensions));
+		}
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions>
+inline VoxelData PaletteVoxelBlock<VoxelData, Dimensions>::VoxelAt(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_palette[IndexAt(x + (y * Dimensions) + (z * Dimensions * Dimensions))];
+}
+
+template<class VoxelData, uint32_t Dimensions>
+void PaletteVoxelBlock<VoxelData, Dimensions>::Repack(uint32_t newBitsPerIndex)
+{
+	std::vector<uint64_t> oldIndices;
+	oldIndices.swap(m_indices);
+	const uint32_t oldBitsPerIndex = m_bitsPerIndex;
+	const uint64_t oldMask = (1ull << oldBitsPerIndex) - 1;
+
+	m_bitsPerIndex = newBitsPerIndex;
+	m_indices.assign((c_voxelCount * m_bitsPerIndex) / 64, 0);
+	for (uint32_t v = 0; v < c_voxelCount; ++v)
+	{
+		const uint32_t oldBitOffset = v * oldBitsPerIndex;
+		const uint64_t index = (oldIndices[oldBitOffset >> 6] >> (oldBitOffset & 63)) & oldMask;
+		const uint32_t newBitOffset = v * m_bitsPerIndex;
+		m_indices[newBitOffset >> 6] |= index << (newBitOffset & 63);
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions>
+bool PaletteVoxelBlock<VoxelData, Dimensions>::SetVoxel(uint32_t x, uint32_t y, uint32_t z, VoxelData value)
+{
+	SDE_ASSERT(m_paletteSize > 0, "Encode the block first");
+	uint32_t paletteIndex = 0;
+	while (paletteIndex < m_paletteSize && m_palette[paletteIndex] != value)
+	{
+		++paletteIndex;
+	}
+	if (paletteIndex == m_paletteSize)
+	{
+		if (m_paletteSize == c_maxPaletteSize)
+		{
+			return false;
+		}
+		m_palette[m_paletteSize++] = value;
+		const uint32_t bitsNeeded = BitsForPaletteSize(m_paletteSize);
+		if (bitsNeeded != m_bitsPerIndex)
+		{
+			Repack(bitsNeeded);
+		}
+	}
+	SetIndex(x + (y * Dimensions) + (z * Dimensions * Dimensions), paletteIndex);
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions>
+uint64_t PaletteVoxelBlock<VoxelData, Dimensions>::Hash() const
+{
+	// FNV-1a over the palette and index words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t p = 0; p < m_paletteSize; ++p)
+	{
+		hash = (hash ^ (uint64_t)m_palette[p]) * 1099511628211ull;
+	}
+	for (const uint64_t word : m_indices)
+	{
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	return hash;
+}
+
+template<class VoxelData, uint32_t Dimensions>
+bool PaletteVoxelBlock<VoxelData, Dimensions>::operator==(const PaletteVoxelBlock& other) const
+{
+	if (m_paletteSize != other.m_paletteSize || m_bitsPerIndex != other.m_bitsPerIndex)
+	{
+		return false;
+	}
+	for (uint32_t p = 0; p < m_paletteSize; ++p)
+	{
+		if (m_palette[p] != other.m_palette[p])
+		{
+			return false;
+		}
+	}
+	return m_indices == other.m_indices;
+}
\ No newline at end of file
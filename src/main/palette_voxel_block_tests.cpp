@@ -0,0 +1,129 @@
+#include "palette_voxel_block_tests.h"
+#include "palette_voxel_block.h"
+#include "kernel/assert.h"
+#include <vector>
+
+namespace PaletteVoxelBlockTests
+{
+	typedef PaletteVoxelBlock<uint8_t, 32> TestBlock;
+
+	// Fills a block with valueCount distinct values in a pattern that doesn't line up with the rows
+	std::vector<uint8_t> MakeVoxels(uint32_t valueCount)
+	{
+		std::vector<uint8_t> voxels(TestBlock::c_voxelCount);
+		for (uint32_t v = 0; v < TestBlock::c_voxelCount; ++v)
+		{
+			voxels[v] = (uint8_t)(((v * 7) / 5) % valueCount) * 13;
+		}
+		return voxels;
+	}
+
+	bool MatchesVoxels(const TestBlock& block, const std::vector<uint8_t>& voxels)
+	{
+		uint8_t row[32];
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				block.DecodeRow(y, z, row);
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					const uint8_t expected = voxels[x + (y * 32) + (z * 32 * 32)];
+					if (row[x] != expected || block.VoxelAt(x, y, z) != expected)
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	void EncodeDecodeTest()
+	{
+		const uint32_t valueCounts[] = { 1, 2, 3, 4, 5, 16 };
+		const uint32_t expectedBits[] = { 1, 1, 2, 2, 4, 4 };
+		for (uint32_t t = 0; t < 6; ++t)
+		{
+			const std::vector<uint8_t> voxels = MakeVoxels(valueCounts[t]);
+			TestBlock block;
+			SDE_ASSERT(block.Encode(voxels.data()));
+			SDE_ASSERT(block.PaletteSize() == valueCounts[t]);
+			SDE_ASSERT(block.BitsPerIndex() == expectedBits[t]);
+			SDE_ASSERT(MatchesVoxels(block, voxels));
+
+			std::vector<uint8_t> decoded(TestBlock::c_voxelCount);
+			block.Decode(decoded.data());
+			SDE_ASSERT(decoded == voxels);
+		}
+	}
+
+	void TooManyValuesTest()
+	{
+		const std::vector<uint8_t> voxels = MakeVoxels(17);
+		TestBlock block;
+		SDE_ASSERT(!block.Encode(voxels.data()));
+	}
+
+	void PaletteGrowthTest()
+	{
+		// Writing new values re-encodes with more bits without touching the existing voxels
+		std::vector<uint8_t> voxels = MakeVoxels(2);
+		TestBlock block;
+		SDE_ASSERT(block.Encode(voxels.data()));
+		SDE_ASSERT(block.BitsPerIndex() == 1);
+		for (uint32_t value = 1; value < 15; ++value)
+		{
+			const uint32_t x = value, y = value * 2, z = 31 - value;
+			SDE_ASSERT(block.SetVoxel(x, y, z, (uint8_t)(value + 200)));
+			voxels[x + (y * 32) + (z * 32 * 32)] = (uint8_t)(value + 200);
+		}
+		SDE_ASSERT(block.PaletteSize() == 16);
+		SDE_ASSERT(block.BitsPerIndex() == 4);
+		SDE_ASSERT(MatchesVoxels(block, voxels));
+
+		// Full palette, existing values can still be written
+		SDE_ASSERT(!block.SetVoxel(0, 0, 0, 255));
+		SDE_ASSERT(block.SetVoxel(0, 0, 0, 201));
+	}
+
+	void MemoryTest()
+	{
+		// Index bytes are 1/8, 1/4 or 1/2 of a full block
+		const size_t fullBlockBytes = TestBlock::c_voxelCount;
+		const uint32_t valueCounts[] = { 2, 4, 16 };
+		const size_t expectedIndexBytes[] = { fullBlockBytes / 8, fullBlockBytes / 4, fullBlockBytes / 2 };
+		for (uint32_t t = 0; t < 3; ++t)
+		{
+			const std::vector<uint8_t> voxels = MakeVoxels(valueCounts[t]);
+			TestBlock block;
+			SDE_ASSERT(block.Encode(voxels.data()));
+			SDE_ASSERT(block.MemoryBytes() == sizeof(TestBlock) + expectedIndexBytes[t]);
+		}
+	}
+
+	void EqualityTest()
+	{
+		// Identical voxels encode identically, so they can be shared
+		std::vector<uint8_t> voxels = MakeVoxels(5);
+		TestBlock block0, block1, block2;
+		SDE_ASSERT(block0.Encode(voxels.data()));
+		SDE_ASSERT(block1.Encode(voxels.data()));
+		SDE_ASSERT(block0 == block1);
+		SDE_ASSERT(block0.Hash() == block1.Hash());
+
+		voxels[1000] = voxels[1000] == 0 ? 13 : 0;
+		SDE_ASSERT(block2.Encode(voxels.data()));
+		SDE_ASSERT(!(block0 == block2));
+		SDE_ASSERT(block0.Hash() != block2.Hash());
+	}
+
+	void RunTests()
+	{
+		EncodeDecodeTest();
+		TooManyValuesTest();
+		PaletteGrowthTest();
+		MemoryTest();
+		EqualityTest();
+	}
+}
\ No newline at end of file
@@ -8,6 +8,16 @@ inline float Sphere(const glm::vec3& voxelPosition, const glm::vec3& center, flo
 	return radius - glm::distance(voxelPosition, center);
 }
 
+// Sphere swept from a to b
+inline float Capsule(const glm::vec3& voxelPosition, const glm::vec3& a, const glm::vec3& b, float radius)
+{
+	const glm::vec3 pa = voxelPosition - a;
+	const glm::vec3 ba = b - a;
+	const float baLengthSq = glm::dot(ba, ba);
+	const float h = baLengthSq > 0.0f ? glm::clamp(glm::dot(pa, ba) / baLengthSq, 0.0f, 1.0f) : 0.0f;
+	return radius - glm::length(pa - (ba * h));
+}
+
 inline float Box(const glm::vec3& voxelPosition, const glm::vec3& boxMin, const glm::vec3& boxMax)
 {
 	const glm::vec3 bpos = (boxMax + boxMin) * 0.5f;
@@ -0,0 +1,151 @@
+#include "shot_pipeline.h"
+#include "floor.h"
+#include "voxel_brush.h"
+#include "sde/job_system.h"
+#include <thread>
+
+static const float c_maxEditGroupSize = 2.0f;	// Impacts are only merged into one edit while the group stays this small
+
+ShotPipeline::ShotPipeline()
+	: m_jobSystem(nullptr)
+	, m_floor(nullptr)
+	, m_shotsInFlight(0)
+{
+}
+
+ShotPipeline::~ShotPipeline()
+{
+	Destroy();
+}
+
+void ShotPipeline::Create(SDE::JobSystem* jobSystem, Floor* floor)
+{
+	SDE_ASSERT(jobSystem != nullptr && floor != nullptr);
+	m_jobSystem = jobSystem;
+	m_floor = floor;
+}
+
+void ShotPipeline::Destroy()
+{
+	// The jobs write into m_resolved and read the floor, so neither can go away under them
+	while (m_shotsInFlight.Get() > 0)
+	{
+		std::this_thread::yield();
+	}
+	Kernel::ScopedMutex lock(m_resolvedLock);
+	m_resolved.clear();
+	m_applying.clear();
+	m_floor = nullptr;
+}
+
+void ShotPipeline::Fire(const ShotRequest& request)
+{
+	SDE_ASSERT(m_floor != nullptr);
+	if (request.m_pellets == 0)
+	{
+		return;
+	}
+
+	m_shotsInFlight.Add(1);
+	m_jobSystem->PushJob([this, request]()
+	{
+		ResolvedShot result;
+		ResolveShot(request, result);
+		{
+			Kernel::ScopedMutex lock(m_resolvedLock);
+			m_resolved.push_back(std::move(result));
+		}
+		m_shotsInFlight.Add(-1);
+	}, "ShotPipeline::Resolve");
+}
+
+void ShotPipeline::ResolveShot(const ShotRequest& request, ResolvedShot& result)
+{
+	// rand() is not ours to call from a job, so the jitter comes from the request seed
+	uint32_t seed = request.m_seed;
+	auto nextRandom = [&seed]()
+	{
+		seed = (seed * 1664525u) + 1013904223u;
+		return (float)(seed >> 8) / (float)(1 << 24);
+	};
+
+	std::vector<Floor::RaycastRay> rays(request.m_pellets);
+	std::vector<Floor::RaycastHit> hits(request.m_pellets);
+	for (auto& ray : rays)
+	{
+		glm::vec3 jitter = glm::vec3(nextRandom(), nextRandom(), nextRandom()) * request.m_spread;
+		jitter -= request.m_spread * 0.5f;
+		ray.m_start = request.m_origin;
+		ray.m_end = request.m_origin + glm::normalize(request.m_direction + jitter) * request.m_range;
+	}
+	m_floor->Raycast(rays.data(), request.m_pellets, hits.data());
+
+	// Pellets landing near each other share an edit, so a spread into one wall is a single write
+	result.m_damageRadius = request.m_damageRadius;
+	for (const auto& hit : hits)
+	{
+		if (!hit.m_hit)
+		{
+			continue;
+		}
+		Impact impact;
+		impact.m_position = hit.m_position;
+		impact.m_material = hit.m_material;
+		result.m_impacts.push_back(impact);
+
+		const Math::Box3 hitBounds(hit.m_position - request.m_damageRadius, hit.m_position + request.m_damageRadius);
+		bool grouped = false;
+		for (auto& group : result.m_edits)
+		{
+			const glm::vec3 newMin = glm::min(group.m_bounds.Min(), hitBounds.Min());
+			const glm::vec3 newMax = glm::max(group.m_bounds.Max(), hitBounds.Max());
+			if (group.m_bounds.Intersects(hitBounds) && glm::all(glm::lessThanEqual(newMax - newMin, glm::vec3(c_maxEditGroupSize))))
+			{
+				group.m_bounds = Math::Box3(newMin, newMax);
+				group.m_centers.push_back(hit.m_position);
+				grouped = true;
+				break;
+			}
+		}
+		if (!grouped)
+		{
+			ImpactGroup newGroup;
+			newGroup.m_bounds = hitBounds;
+			newGroup.m_centers.push_back(hit.m_position);
+			result.m_edits.push_back(std::move(newGroup));
+		}
+	}
+}
+
+uint32_t ShotPipeline::ApplyResults(const ImpactCallback& onImpact)
+{
+	SDE_ASSERT(m_floor != nullptr);
+	{
+		Kernel::ScopedMutex lock(m_resolvedLock);
+		std::swap(m_resolved, m_applying);
+	}
+
+	for (auto& shot : m_applying)
+	{
+		for (auto& group : shot.m_edits)
+		{
+			// A voxel in range of several pellets is damaged once per pellet
+			VoxelBrushList edit;
+			for (const auto& center : group.m_centers)
+			{
+				edit.Add(VoxelBrush::MakeSphere(center, shot.m_damageRadius, VoxelBrush::Operation::Damage));
+			}
+			m_floor->ModifyData(group.m_bounds, edit);
+		}
+		if (onImpact != nullptr)
+		{
+			for (const auto& impact : shot.m_impacts)
+			{
+				onImpact(impact.m_position, impact.m_material);
+			}
+		}
+	}
+	const uint32_t shotsApplied = (uint32_t)m_applying.size();
+	m_applying.clear();
+	return shotsApplied;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include "kernel/atomics.h"
+#include "kernel/mutex.h"
+#include "math/box3.h"
+#include <functional>
+#include <vector>
+
+namespace SDE
+{
+	class JobSystem;
+}
+
+class Floor;
+
+// Resolves shots on the job system. Fire only records the request; a job builds the pellet rays,
+// traces them as one batch and groups the impacts into voxel edits. Nothing touches the floor edits
+// or particles until the main thread calls ApplyResults (the sync point), so a shot fired this frame lands next frame
+class ShotPipeline
+{
+public:
+	ShotPipeline();
+	~ShotPipeline();
+
+	struct ShotRequest
+	{
+		glm::vec3 m_origin;
+		glm::vec3 m_direction;		// Normalised
+		float m_range;
+		uint32_t m_pellets;
+		float m_spread;				// Max. jitter added to the direction per axis
+		float m_damageRadius;
+		uint32_t m_seed;			// Pellet jitter is generated from this on the job
+	};
+	typedef std::function<void(const glm::vec3& position, Materials material)> ImpactCallback;
+
+	void Create(SDE::JobSystem* jobSystem, Floor* floor);
+	void Destroy();		// Waits for shots in flight, anything unapplied is dropped
+
+	void Fire(const ShotRequest& request);
+
+	// Main thread only. Queues the edits for all shots resolved so far and calls onImpact for each hit
+	// Returns the number of shots applied
+	uint32_t ApplyResults(const ImpactCallback& onImpact);
+
+	inline int32_t ShotsInFlight() const { return m_shotsInFlight.Get(); }
+
+private:
+	ShotPipeline(const ShotPipeline&) = delete;
+	ShotPipeline& operator=(const ShotPipeline&) = delete;
+
+	struct Impact
+	{
+		glm::vec3 m_position;
+		Materials m_material;
+	};
+	struct ImpactGroup		// Impacts close enough to share one edit
+	{
+		Math::Box3 m_bounds;
+		std::vector<glm::vec3> m_centers;
+	};
+	struct ResolvedShot
+	{
+		float m_damageRadius;
+		std::vector<Impact> m_impacts;
+		std::vector<ImpactGroup> m_edits;
+	};
+	void ResolveShot(const ShotRequest& request, ResolvedShot& result);
+
+	SDE::JobSystem* m_jobSystem;
+	Floor* m_floor;
+	Kernel::AtomicInt32 m_shotsInFlight;
+	Kernel::Mutex m_resolvedLock;
+	std::vector<ResolvedShot> m_resolved;		// Guarded by m_resolvedLock
+	std::vector<ResolvedShot> m_applying;		// Main thread only, swapped with m_resolved
+};
\ No newline at end of file
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "kernel/base_types.h"
+#include "kernel/atomics.h"
+#include "kernel/mutex.h"
+#include "math/box3.h"
+#include "palette_voxel_block.h"
+#include "voxel_block_layout.h"
+#include "job_scratch_pool.h"
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Fixed size block of voxels. Storage order comes from the Layout (see voxel_block_layout.h), use VoxelAt
+// or the linear helpers rather than walking Voxels() directly
+template<class VoxelData, uint32_t Dimensions, class Layout = VoxelLayoutLinear>
+class SparseVoxelBlock
+{
+public:
+	typedef VoxelData VoxelDataType;
+	typedef Layout LayoutType;
+	enum { VoxelDimensions = Dimensions };
+	static const uint32_t c_voxelCount = Dimensions * Dimensions * Dimensions;
+
+	inline VoxelData& VoxelAt(uint32_t x, uint32_t y, uint32_t z) { return m_voxels[Layout::template Index<Dimensions>(x, y, z)]; }
+	inline const VoxelData& VoxelAt(uint32_t x, uint32_t y, uint32_t z) const { return m_voxels[Layout::template Index<Dimensions>(x, y, z)]; }
+	inline VoxelData* Voxels() { return m_voxels; }		// Storage order
+	inline const VoxelData* Voxels() const { return m_voxels; }
+
+	// x-major copies. LinearVoxels returns the storage directly for linear layouts, otherwise it fills scratch
+	void ReadRow(uint32_t y, uint32_t z, VoxelData* row) const;
+	const VoxelData* LinearVoxels(std::vector<VoxelData>& scratch) const;
+	void WriteLinear(const VoxelData* voxels);
+
+	void Fill(VoxelData value);
+	bool IsUniform(VoxelData& value) const;
+
+private:
+	VoxelData m_voxels[c_voxelCount];
+};
+
+// Compact storage counters
+struct SparseVoxelStorageStats
+{
+	uint32_t m_packedBlocks;	// Unique packed blocks
+	uint32_t m_packedRefs;		// Blocks using them
+	size_t m_packedBytes;
+	uint32_t m_coldBlocks;
+	size_t m_coldBytes;
+	uint32_t m_hits;			// Cold blocks decoded, including copies that leave them cold (totals since startup)
+	uint32_t m_misses;			// Cold blocks decompressed back into full blocks
+};
+
+// Drop-in replacement for Vox::Model where blocks containing a single value (i.e. air or solid wall)
+// are stored as that value instead of a full block. With palette compression enabled, blocks with few
+// distinct values are stored as a palette + packed indices instead. Packed blocks are immutable and
+// deduplicated by content, identical blocks share one copy. Blocks are expanded to full blocks
+// when something asks for a BlockType (BlockAt), and compacted again by CompactBlock. ReadVoxel,
+// DecodeRow and CopyBlock read any representation in place, so they never expand anything.
+// Blocks can also be compressed into a cold tier (RLE) with CompressBlock. Cold blocks are decompressed
+// by the first BlockAt/ReadVoxel/DecodeRow. Accesses stamp each block with the time from SetAccessTime, so
+// the owner can find blocks nobody has looked at for a while.
+// Expanding and compacting are lock-free and safe while jobs read/write other blocks; readers of a
+// compacted block may still hold the old one, so it is retired instead of freed. Jobs using the model hold
+// a ReadScope, and FreeRetiredBlocks only frees blocks retired before the oldest running scope started.
+// The bounds/block table (PreallocateMemory/RemoveAllBlocks) must not change while jobs are running
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout = VoxelLayoutLinear>
+class SparseVoxelModel
+{
+public:
+	typedef SparseVoxelBlock<VoxelData, Dimensions, Layout> BlockType;
+	typedef PaletteVoxelBlock<VoxelData, Dimensions> PackedBlockType;
+	static_assert(sizeof(VoxelData) == 1, "Uniform blocks are tagged with their value, only byte voxels are supported");
+	static_assert(Dimensions % 4 == 0, "Occupancy masks need whole 4x4x4 bricks");
+
+	SparseVoxelModel();
+	~SparseVoxelModel();
+
+	void SetVoxelSize(const glm::vec3& size);
+	void SetPaletteCompression(bool enabled) { m_paletteCompression = enabled; }
+	inline const glm::vec3& GetVoxelSize() const { return m_voxelSize; }
+	inline const Math::Box3& GetTotalBounds() const { return m_totalBounds; }
+
+	// Builds the block table for the bounds. All blocks start out uniform air, so this costs no voxel memory
+	void PreallocateMemory(const Math::Box3& bounds);
+	void RemoveAllBlocks();
+	size_t TotalVoxelMemory() const;
+
+	// Block indices are inclusive, clamped to the model bounds
+	void GetBlockIterationParameters(const Math::Box3& bounds, glm::ivec3& blockStart, glm::ivec3& blockEnd) const;
+
+	// Read access, uniform blocks return a shared block for their value, packed blocks are expanded
+	const BlockType* BlockAt(const glm::ivec3& blockIndex) const;
+
+	// Write access, uniform and packed blocks are expanded
+	BlockType* BlockAt(const glm::ivec3& blockIndex);
+
+	// Reads without expanding. Out of range blocks read as 0
+	VoxelData ReadVoxel(const glm::ivec3& blockIndex, uint32_t x, uint32_t y, uint32_t z) const;
+	void DecodeRow(const glm::ivec3& blockIndex, uint32_t y, uint32_t z, VoxelData* row) const;
+	bool CopyBlock(const glm::ivec3& blockIndex, BlockType& target) const;
+
+	// Stores the block as a single value or a palette if possible. Must not overlap writes to the block
+	// Returns true if the block is (now) not a full block
+	bool CompactBlock(const glm::ivec3& blockIndex);
+
+	// Moves a full or packed block to the cold tier, unless it would not get smaller. Must not overlap writes to the block
+	bool CompressBlock(const glm::ivec3& blockIndex);
+	void SetAccessTime(uint32_t time) { m_accessTime.Set((int32_t)time); }
+	uint32_t LastAccessTime(const glm::ivec3& blockIndex) const;
+	bool IsBlockWarm(const glm::ivec3& blockIndex) const;		// i.e. full or packed
+	size_t BlockMemory(const glm::ivec3& blockIndex) const;		// Memory freed if the block went away, 0 for uniform/shared blocks
+	size_t WarmVoxelMemory() const;
+	SparseVoxelStorageStats GetStorageStats() const;
+	bool IsBlockUniform(const glm::ivec3& blockIndex) const;
+
+	// Held by anything using blocks from another thread than the one calling FreeRetiredBlocks
+	class ReadScope
+	{
+	public:
+		explicit ReadScope(const SparseVoxelModel& model) : m_model(model), m_slot(model.BeginRead()) {}
+		~ReadScope() { m_model.EndRead(m_slot); }
+	private:
+		ReadScope(const ReadScope&) = delete;
+		ReadScope& operator=(const ReadScope&) = delete;
+		const SparseVoxelModel& m_model;
+		uint32_t m_slot;
+	};
+
+	// Frees the retired blocks no running ReadScope can see. One thread at a time
+	void FreeRetiredBlocks();
+
+	// Which 4x4x4 bricks of each block contain anything (non-zero), used to skip empty space. Masks are not
+	// tracked automatically, writers call UpdateOccupancy on the blocks they changed once they are done.
+	// Brick bits are x + (y * c_bricksPerAxis) + (z * c_bricksPerAxis^2). Out of range blocks read as empty
+	static const uint32_t c_occupancyBrickSize = 4;
+	static const uint32_t c_bricksPerAxis = Dimensions / c_occupancyBrickSize;
+	static const uint32_t c_occupancyWords = ((c_bricksPerAxis * c_bricksPerAxis * c_bricksPerAxis) + 63) / 64;
+	void UpdateOccupancy(const glm::ivec3& blockIndex);
+	bool ReadOccupancy(const glm::ivec3& blockIndex, uint64_t* masks) const;
+
+	inline uint32_t ExpandedBlockCount() const { return (uint32_t)m_expandedBlocks.Get(); }
+	inline uint32_t PackedBlockCount() const { return (uint32_t)m_packedBlocks.Get(); }		// Unique blocks only
+
+private:
+	SparseVoxelModel(const SparseVoxelModel&) = delete;
+	SparseVoxelModel& operator=(const SparseVoxelModel&) = delete;
+
+	// RLE data of a full block
+	struct ColdBlock
+	{
+		std::vector<uint8_t> m_data;
+	};
+
+	// Packed blocks live in a store keyed by content, writers expand (i.e. copy) them so they are never modified
+	struct SharedPackedBlock
+	{
+		PackedBlockType m_block;
+		uint64_t m_hash;
+		int32_t m_refs;		// Guarded by m_packedStoreLock
+	};
+
+	// Block table entries are a full block pointer, a uniform value, a packed block pointer or a cold block pointer, tagged in the low 2 bits
+	enum EntryTag : uintptr_t
+	{
+		FullEntry = 0,
+		UniformTag = 1,
+		PackedTag = 2,
+		ColdTag = 3,
+		TagMask = 3
+	};
+	static inline bool IsFullEntry(uintptr_t entry) { return (entry & TagMask) == FullEntry; }
+	static inline bool IsUniformEntry(uintptr_t entry) { return (entry & TagMask) == UniformTag; }
+	static inline bool IsPackedEntry(uintptr_t entry) { return (entry & TagMask) == PackedTag; }
+	static inline bool IsColdEntry(uintptr_t entry) { return (entry & TagMask) == ColdTag; }
+	static inline const ColdBlock* ColdBlockPtr(uintptr_t entry) { return reinterpret_cast<const ColdBlock*>(entry & ~(uintptr_t)TagMask); }
+	static inline uintptr_t UniformEntry(VoxelData value) { return ((uintptr_t)value << 2) | UniformTag; }
+	static inline VoxelData UniformValue(uintptr_t entry) { return (VoxelData)(entry >> 2); }
+	static inline SharedPackedBlock* SharedPacked(uintptr_t entry) { return reinterpret_cast<SharedPackedBlock*>(entry & ~(uintptr_t)TagMask); }
+	static inline const PackedBlockType* PackedBlock(uintptr_t entry) { return &SharedPacked(entry)->m_block; }
+	static inline BlockType* FullBlock(uintptr_t entry) { return reinterpret_cast<BlockType*>(entry); }
+
+	int32_t BlockTableIndex(const glm::ivec3& blockIndex) const;
+	const BlockType* SharedUniformBlock(VoxelData value) const;
+	BlockType* ExpandBlock(int32_t tableIndex) const;
+	void DecodeEntry(uintptr_t entry, BlockType& target) const;
+	SharedPackedBlock* AcquirePackedBlock(std::unique_ptr<SharedPackedBlock>& newBlock);
+	void ReleasePackedBlock(SharedPackedBlock* block) const;
+	inline void TouchBlock(int32_t tableIndex) const;
+	void RetireEntry(uintptr_t entry) const;
+	uint32_t BeginRead() const;
+	void EndRead(uint32_t slot) const;
+	void FreeEntry(uintptr_t entry) const;
+	void Clear();
+
+	glm::vec3 m_voxelSize;
+	glm::vec3 m_blockSize;
+	Math::Box3 m_totalBounds;
+	glm::ivec3 m_firstBlock;
+	glm::ivec3 m_blockCounts;
+	bool m_paletteCompression;
+	std::unique_ptr<std::atomic<uintptr_t>[]> m_blocks;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_lastAccess;		// Access time of each block
+	std::unique_ptr<std::atomic<uint64_t>[]> m_occupancy;		// c_occupancyWords per block
+	Kernel::AtomicInt32 m_accessTime;
+	mutable std::atomic<BlockType*> m_uniformBlocks[256];	// One shared read-only block per uniform value, created on demand
+	// Retired entries are tagged with the epoch they were retired in. Each ReadScope publishes the epoch it
+	// started in, FreeRetiredBlocks moves the epoch on and frees the entries older than every published one
+	struct RetiredEntry
+	{
+		uintptr_t m_entry;
+		uint32_t m_epoch;
+	};
+	static const uint32_t c_maxReaders = 64;
+	mutable std::atomic<uint32_t> m_epoch;
+	mutable std::atomic<uint32_t> m_readerEpochs[c_maxReaders];	// 0 if the slot is free
+	mutable Kernel::Mutex m_retiredLock;
+	mutable std::vector<RetiredEntry> m_retiredEntries;		// Replaced blocks that readers may still be using
+	std::vector<RetiredEntry> m_freeScratch;				// FreeRetiredBlocks only
+	mutable Kernel::AtomicInt32 m_expandedBlocks;
+	mutable Kernel::Mutex m_packedStoreLock;
+	mutable std::unordered_multimap<uint64_t, SharedPackedBlock*> m_packedStore;
+	mutable Kernel::AtomicInt32 m_packedBlocks;
+	mutable Kernel::AtomicInt32 m_packedRefs;
+	mutable Kernel::AtomicInt32 m_packedBytes;
+	mutable Kernel::AtomicInt32 m_coldBlocks;
+	mutable Kernel::AtomicInt32 m_coldBytes;
+	mutable Kernel::AtomicInt32 m_coldHits;
+	mutable Kernel::AtomicInt32 m_coldMisses;
+	mutable JobScratchPool<std::vector<uint8_t>> m_decodeScratch;	// Linear/RLE decode buffers, one per concurrent decode
+	mutable Kernel::AtomicInt32 m_sharedBlocks;
+};
+
+#include "sparse_voxel_model.inl"
\ No newline at end of file
@@ -0,0 +1,795 @@
+#include "kernel/assert.h"
+#include "core/run_length_encoding.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+template<class VoxelData, uint32_t Dimensions, class Layout>
+void SparseVoxelBlock<VoxelData, Dimensions, Layout>::ReadRow(uint32_t y, uint32_t z, VoxelData* row) const
+{
+	if (Layout::c_isLinear)
+	{
+		const VoxelData* src = &VoxelAt(0, y, z);
+		std::copy(src, src + Dimensions, row);
+	}
+	else
+	{
+		for (uint32_t x = 0; x < Dimensions; ++x)
+		{
+			row[x] = VoxelAt(x, y, z);
+		}
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Layout>
+const VoxelData* SparseVoxelBlock<VoxelData, Dimensions, Layout>::LinearVoxels(std::vector<VoxelData>& scratch) const
+{
+	if (Layout::c_isLinear)
+	{
+		return m_voxels;
+	}
+	scratch.resize(c_voxelCount);
+	for (uint32_t z = 0; z < Dimensions; ++z)
+	{
+		for (uint32_t y = 0; y < Dimensions; ++y)
+		{
+			ReadRow(y, z, scratch.data() + (y * Dimensions) + (z * Dimensions * Dimensions));
+		}
+	}
+	return scratch.data();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Layout>
+void SparseVoxelBlock<VoxelData, Dimensions, Layout>::WriteLinear(const VoxelData* voxels)
+{
+	if (Layout::c_isLinear)
+	{
+		std::copy(voxels, voxels + c_voxelCount, m_voxels);
+		return;
+	}
+	for (uint32_t z = 0; z < Dimensions; ++z)
+	{
+		for (uint32_t y = 0; y < Dimensions; ++y)
+		{
+			for (uint32_t x = 0; x < Dimensions; ++x)
+			{
+				VoxelAt(x, y, z) = *voxels++;
+			}
+		}
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Layout>
+void SparseVoxelBlock<VoxelData, Dimensions, Layout>::Fill(VoxelData value)
+{
+	std::fill(m_voxels, m_voxels + c_voxelCount, value);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Layout>
+bool SparseVoxelBlock<VoxelData, Dimensions, Layout>::IsUniform(VoxelData& value) const
+{
+	value = m_voxels[0];
+	for (uint32_t v = 1; v < c_voxelCount; ++v)
+	{
+		if (m_voxels[v] != value)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::SparseVoxelModel()
+	: m_voxelSize(1.0f)
+	, m_blockSize((float)Dimensions)
+	, m_firstBlock(0)
+	, m_blockCounts(0)
+	, m_paletteCompression(false)
+	, m_accessTime(0)
+	, m_expandedBlocks(0)
+	, m_packedBlocks(0)
+	, m_packedRefs(0)
+	, m_packedBytes(0)
+	, m_coldBlocks(0)
+	, m_coldBytes(0)
+	, m_coldHits(0)
+	, m_coldMisses(0)
+	, m_sharedBlocks(0)
+	, m_epoch(1)
+{
+	for (auto& uniformBlock : m_uniformBlocks)
+	{
+		uniformBlock.store(nullptr, std::memory_order_relaxed);
+	}
+	for (auto& readerEpoch : m_readerEpochs)
+	{
+		readerEpoch.store(0, std::memory_order_relaxed);
+	}
+	m_decodeScratch.Create([]()
+	{
+		auto decoded = std::make_unique<std::vector<uint8_t>>();
+		decoded->reserve(sizeof(BlockType));
+		return decoded;
+	});
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::~SparseVoxelModel()
+{
+	Clear();
+	for (auto& uniformBlock : m_uniformBlocks)
+	{
+		BlockType* block = uniformBlock.exchange(nullptr);
+		if (block != nullptr)
+		{
+			Allocator::FreeBlock(block);
+		}
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::SetVoxelSize(const glm::vec3& size)
+{
+	SDE_ASSERT(m_blocks == nullptr, "Set the voxel size before allocating blocks");
+	m_voxelSize = size;
+	m_blockSize = size * (float)Dimensions;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::PreallocateMemory(const Math::Box3& bounds)
+{
+	Clear();
+	m_totalBounds = bounds;
+	m_firstBlock = glm::ivec3(glm::floor(bounds.Min() / m_blockSize));
+	const glm::ivec3 lastBlock = glm::max(glm::ivec3(glm::ceil(bounds.Max() / m_blockSize)) - glm::ivec3(1), m_firstBlock);
+	m_blockCounts = (lastBlock - m_firstBlock) + glm::ivec3(1);
+
+	const int32_t totalBlocks = m_blockCounts.x * m_blockCounts.y * m_blockCounts.z;
+	m_blocks.reset(new std::atomic<uintptr_t>[totalBlocks]);
+	m_lastAccess.reset(new std::atomic<uint32_t>[totalBlocks]);
+	m_occupancy.reset(new std::atomic<uint64_t>[totalBlocks * c_occupancyWords]);
+	for (int32_t b = 0; b < totalBlocks; ++b)
+	{
+		m_blocks[b].store(UniformEntry(0), std::memory_order_relaxed);
+		m_lastAccess[b].store((uint32_t)m_accessTime.Get(), std::memory_order_relaxed);
+		for (uint32_t w = 0; w < c_occupancyWords; ++w)
+		{
+			m_occupancy[(b * c_occupancyWords) + w].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::RemoveAllBlocks()
+{
+	// The bounds are kept, the block table goes until the next PreallocateMemory
+	Clear();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::Clear()
+{
+	const int32_t totalBlocks = m_blocks != nullptr ? m_blockCounts.x * m_blockCounts.y * m_blockCounts.z : 0;
+	for (int32_t b = 0; b < totalBlocks; ++b)
+	{
+		FreeEntry(m_blocks[b].load());
+	}
+	m_blocks = nullptr;
+	m_lastAccess = nullptr;
+	m_occupancy = nullptr;
+	m_blockCounts = glm::ivec3(0);
+	FreeRetiredBlocks();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+size_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::TotalVoxelMemory() const
+{
+	const size_t blockTableBytes = m_blockCounts.x * m_blockCounts.y * m_blockCounts.z * (sizeof(uintptr_t) + sizeof(uint32_t) + (c_occupancyWords * sizeof(uint64_t)));
+	const size_t sharedBlockBytes = (size_t)m_sharedBlocks.Get() * sizeof(BlockType);
+	return blockTableBytes + sharedBlockBytes + WarmVoxelMemory() + (size_t)m_coldBytes.Get();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+size_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::WarmVoxelMemory() const
+{
+	return ((size_t)m_expandedBlocks.Get() * sizeof(BlockType)) + (size_t)m_packedBytes.Get();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+SparseVoxelStorageStats SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::GetStorageStats() const
+{
+	SparseVoxelStorageStats stats;
+	stats.m_packedBlocks = (uint32_t)m_packedBlocks.Get();
+	stats.m_packedRefs = (uint32_t)m_packedRefs.Get();
+	stats.m_packedBytes = (size_t)m_packedBytes.Get();
+	stats.m_coldBlocks = (uint32_t)m_coldBlocks.Get();
+	stats.m_coldBytes = (size_t)m_coldBytes.Get();
+	stats.m_hits = (uint32_t)m_coldHits.Get();
+	stats.m_misses = (uint32_t)m_coldMisses.Get();
+	return stats;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::GetBlockIterationParameters(const Math::Box3& bounds, glm::ivec3& blockStart, glm::ivec3& blockEnd) const
+{
+	const glm::ivec3 lastBlock = m_firstBlock + m_blockCounts - glm::ivec3(1);
+	blockStart = glm::clamp(glm::ivec3(glm::floor(bounds.Min() / m_blockSize)), m_firstBlock, lastBlock);
+	blockEnd = glm::clamp(glm::ivec3(glm::ceil(bounds.Max() / m_blockSize)) - glm::ivec3(1), blockStart, lastBlock);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+int32_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockTableIndex(const glm::ivec3& blockIndex) const
+{
+	const glm::ivec3 local = blockIndex - m_firstBlock;
+	if (m_blocks == nullptr || glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(local, m_blockCounts)))
+	{
+		return -1;
+	}
+	return local.x + (local.y * m_blockCounts.x) + (local.z * m_blockCounts.x * m_blockCounts.y);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::FreeEntry(uintptr_t entry) const
+{
+	if (IsFullEntry(entry))
+	{
+		Allocator::FreeBlock(FullBlock(entry));
+		m_expandedBlocks.Add(-1);
+	}
+	else if (IsPackedEntry(entry))
+	{
+		ReleasePackedBlock(SharedPacked(entry));
+	}
+	else if (IsColdEntry(entry))
+	{
+		const ColdBlock* coldBlock = ColdBlockPtr(entry);
+		m_coldBytes.Add(-(int32_t)(sizeof(ColdBlock) + coldBlock->m_data.capacity()));
+		m_coldBlocks.Add(-1);
+		delete coldBlock;
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+typename SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::SharedPackedBlock* SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::AcquirePackedBlock(std::unique_ptr<SharedPackedBlock>& newBlock)
+{
+	// Returns a reference to an identical block if we have one, otherwise newBlock goes in the store
+	newBlock->m_hash = newBlock->m_block.Hash();
+	Kernel::ScopedMutex lock(m_packedStoreLock);
+	m_packedRefs.Add(1);
+	auto matches = m_packedStore.equal_range(newBlock->m_hash);
+	for (auto it = matches.first; it != matches.second; ++it)
+	{
+		if (it->second->m_block == newBlock->m_block)
+		{
+			++it->second->m_refs;
+			return it->second;
+		}
+	}
+	newBlock->m_refs = 1;
+	m_packedBlocks.Add(1);
+	m_packedBytes.Add((int32_t)(sizeof(SharedPackedBlock) - sizeof(PackedBlockType) + newBlock->m_block.MemoryBytes()));
+	m_packedStore.insert(std::make_pair(newBlock->m_hash, newBlock.get()));
+	return newBlock.release();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::ReleasePackedBlock(SharedPackedBlock* block) const
+{
+	Kernel::ScopedMutex lock(m_packedStoreLock);
+	m_packedRefs.Add(-1);
+	if (--block->m_refs > 0)
+	{
+		return;
+	}
+	auto matches = m_packedStore.equal_range(block->m_hash);
+	for (auto it = matches.first; it != matches.second; ++it)
+	{
+		if (it->second == block)
+		{
+			m_packedStore.erase(it);
+			break;
+		}
+	}
+	m_packedBlocks.Add(-1);
+	m_packedBytes.Add(-(int32_t)(sizeof(SharedPackedBlock) - sizeof(PackedBlockType) + block->m_block.MemoryBytes()));
+	delete block;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+inline void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::TouchBlock(int32_t tableIndex) const
+{
+	// Only write when the time has moved on, so readers mostly leave the cache line alone
+	const uint32_t now = (uint32_t)m_accessTime.Get();
+	if (m_lastAccess[tableIndex].load(std::memory_order_relaxed) != now)
+	{
+		m_lastAccess[tableIndex].store(now, std::memory_order_relaxed);
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::DecodeEntry(uintptr_t entry, BlockType& target) const
+{
+	if (IsUniformEntry(entry))
+	{
+		target.Fill(UniformValue(entry));
+	}
+	else if (IsPackedEntry(entry))
+	{
+		if (Layout::c_isLinear)
+		{
+			PackedBlock(entry)->Decode(target.Voxels());
+		}
+		else
+		{
+			auto decoded = m_decodeScratch.Borrow();
+			decoded->resize(sizeof(BlockType));
+			VoxelData* linearVoxels = reinterpret_cast<VoxelData*>(decoded->data());
+			PackedBlock(entry)->Decode(linearVoxels);
+			target.WriteLinear(linearVoxels);
+		}
+	}
+	else if (IsColdEntry(entry))
+	{
+		m_coldHits.Add(1);
+		const ColdBlock* coldBlock = ColdBlockPtr(entry);
+		auto decoded = m_decodeScratch.Borrow();
+		decoded->clear();
+		Core::RunLengthDecoder rld;
+		rld.ReadData(coldBlock->m_data.data(), coldBlock->m_data.size(), *decoded);
+		SDE_ASSERT(decoded->size() == sizeof(BlockType), "Bad cold block");
+		memcpy(target.Voxels(), decoded->data(), sizeof(BlockType));
+	}
+	else
+	{
+		target = *FullBlock(entry);
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::RetireEntry(uintptr_t entry) const
+{
+	// Readers may still have the old block, so it sticks around until FreeRetiredBlocks
+	if (!IsUniformEntry(entry))
+	{
+		Kernel::ScopedMutex lock(m_retiredLock);
+		m_retiredEntries.push_back({ entry, m_epoch.load() });
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+uint32_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BeginRead() const
+{
+	for (;;)
+	{
+		for (uint32_t slot = 0; slot < c_maxReaders; ++slot)
+		{
+			uint32_t freeSlot = 0;
+			uint32_t epoch = m_epoch.load();
+			if (m_readerEpochs[slot].compare_exchange_strong(freeSlot, epoch))
+			{
+				// FreeRetiredBlocks may have moved the epoch on before it could see us. Anything it freed was
+				// retired before then, so we are safe once we have published the current epoch
+				for (uint32_t current = m_epoch.load(); current != epoch; current = m_epoch.load())
+				{
+					epoch = current;
+					m_readerEpochs[slot].store(epoch);
+				}
+				return slot;
+			}
+		}
+		std::this_thread::yield();		// All slots busy, someone will finish soon
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::EndRead(uint32_t slot) const
+{
+	m_readerEpochs[slot].store(0, std::memory_order_release);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+const typename SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockType* SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::SharedUniformBlock(VoxelData value) const
+{
+	BlockType* sharedBlock = m_uniformBlocks[value].load(std::memory_order_acquire);
+	if (sharedBlock == nullptr)
+	{
+		// First use of this value, if another thread beat us we use theirs
+		BlockType* newBlock = reinterpret_cast<BlockType*>(Allocator::AllocateBlock(sizeof(BlockType)));
+		newBlock->Fill(value);
+		if (m_uniformBlocks[value].compare_exchange_strong(sharedBlock, newBlock, std::memory_order_acq_rel))
+		{
+			m_sharedBlocks.Add(1);
+			sharedBlock = newBlock;
+		}
+		else
+		{
+			Allocator::FreeBlock(newBlock);
+		}
+	}
+	return sharedBlock;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+typename SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockType* SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::ExpandBlock(int32_t tableIndex) const
+{
+	// Readers see either the compact entry or the identical expanded copy. If another thread
+	// expands it first we use theirs
+	uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	BlockType* newBlock = nullptr;
+	while (!IsFullEntry(entry))
+	{
+		if (newBlock == nullptr)
+		{
+			newBlock = reinterpret_cast<BlockType*>(Allocator::AllocateBlock(sizeof(BlockType)));
+		}
+		DecodeEntry(entry, *newBlock);
+		if (m_blocks[tableIndex].compare_exchange_strong(entry, reinterpret_cast<uintptr_t>(newBlock), std::memory_order_acq_rel))
+		{
+			m_expandedBlocks.Add(1);
+			if (IsColdEntry(entry))
+			{
+				m_coldMisses.Add(1);
+			}
+			RetireEntry(entry);
+			return newBlock;
+		}
+	}
+	if (newBlock != nullptr)
+	{
+		Allocator::FreeBlock(newBlock);
+	}
+	return FullBlock(entry);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+const typename SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockType* SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockAt(const glm::ivec3& blockIndex) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return nullptr;
+	}
+	TouchBlock(tableIndex);
+	const uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	if (IsUniformEntry(entry))
+	{
+		return SharedUniformBlock(UniformValue(entry));
+	}
+	else if (!IsFullEntry(entry))
+	{
+		return ExpandBlock(tableIndex);
+	}
+	return FullBlock(entry);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+typename SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockType* SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockAt(const glm::ivec3& blockIndex)
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return nullptr;
+	}
+	TouchBlock(tableIndex);
+	return ExpandBlock(tableIndex);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+VoxelData SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::ReadVoxel(const glm::ivec3& blockIndex, uint32_t x, uint32_t y, uint32_t z) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return 0;
+	}
+	TouchBlock(tableIndex);
+	const uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	if (IsUniformEntry(entry))
+	{
+		return UniformValue(entry);
+	}
+	else if (IsPackedEntry(entry))
+	{
+		return PackedBlock(entry)->VoxelAt(x, y, z);
+	}
+	else if (IsColdEntry(entry))
+	{
+		return ExpandBlock(tableIndex)->VoxelAt(x, y, z);
+	}
+	return FullBlock(entry)->VoxelAt(x, y, z);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::DecodeRow(const glm::ivec3& blockIndex, uint32_t y, uint32_t z, VoxelData* row) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	uintptr_t entry = UniformEntry(0);
+	if (tableIndex >= 0)
+	{
+		TouchBlock(tableIndex);
+		entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+		if (IsColdEntry(entry))
+		{
+			entry = reinterpret_cast<uintptr_t>(ExpandBlock(tableIndex));
+		}
+	}
+	if (IsUniformEntry(entry))
+	{
+		std::fill(row, row + Dimensions, UniformValue(entry));
+	}
+	else if (IsPackedEntry(entry))
+	{
+		PackedBlock(entry)->DecodeRow(y, z, row);
+	}
+	else
+	{
+		FullBlock(entry)->ReadRow(y, z, row);
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::CopyBlock(const glm::ivec3& blockIndex, BlockType& target) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return false;
+	}
+	// Cold blocks stay cold, this is used to copy whole models out (i.e. saving)
+	DecodeEntry(m_blocks[tableIndex].load(std::memory_order_acquire), target);
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::IsBlockUniform(const glm::ivec3& blockIndex) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	return tableIndex < 0 || IsUniformEntry(m_blocks[tableIndex].load(std::memory_order_acquire));
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::CompactBlock(const glm::ivec3& blockIndex)
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return false;
+	}
+	uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	if (!IsFullEntry(entry))
+	{
+		return true;
+	}
+
+	uintptr_t compactEntry = 0;
+	VoxelData uniformValue;
+	const BlockType* block = FullBlock(entry);
+	if (block->IsUniform(uniformValue))
+	{
+		compactEntry = UniformEntry(uniformValue);
+	}
+	else if (m_paletteCompression)
+	{
+		std::unique_ptr<SharedPackedBlock> packedBlock = std::make_unique<SharedPackedBlock>();
+		std::vector<VoxelData> scratch;
+		if (!packedBlock->m_block.Encode(block->LinearVoxels(scratch)))
+		{
+			return false;
+		}
+		compactEntry = reinterpret_cast<uintptr_t>(AcquirePackedBlock(packedBlock)) | PackedTag;
+	}
+	else
+	{
+		return false;
+	}
+
+	// Only the writer compacts, but readers may expand a packed block at the same time
+	if (!m_blocks[tableIndex].compare_exchange_strong(entry, compactEntry, std::memory_order_acq_rel))
+	{
+		if (IsPackedEntry(compactEntry))
+		{
+			ReleasePackedBlock(SharedPacked(compactEntry));
+		}
+		return false;
+	}
+	RetireEntry(entry);
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::CompressBlock(const glm::ivec3& blockIndex)
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return false;
+	}
+	uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	if (IsColdEntry(entry) || IsUniformEntry(entry))
+	{
+		return IsColdEntry(entry);
+	}
+
+	// Packed blocks are decoded first, the RLE stream is always a full block. Shared blocks are already cheap
+	std::unique_ptr<BlockType> packedScratch;
+	const BlockType* block = nullptr;
+	if (IsPackedEntry(entry))
+	{
+		{
+			Kernel::ScopedMutex lock(m_packedStoreLock);
+			if (SharedPacked(entry)->m_refs > 1)
+			{
+				return false;
+			}
+		}
+		packedScratch = std::make_unique<BlockType>();
+		DecodeEntry(entry, *packedScratch);
+		block = packedScratch.get();
+	}
+	else
+	{
+		block = FullBlock(entry);
+	}
+
+	ColdBlock* coldBlock = new ColdBlock();
+	Core::RunLengthEncoder rle;
+	rle.WriteData(reinterpret_cast<const uint8_t*>(block->Voxels()), sizeof(BlockType), coldBlock->m_data);	// Storage order, it never leaves the model
+	rle.Flush(coldBlock->m_data);
+	coldBlock->m_data.shrink_to_fit();
+	if (sizeof(ColdBlock) + coldBlock->m_data.capacity() >= BlockMemory(blockIndex))
+	{
+		delete coldBlock;		// Noisy data, not worth it
+		return false;
+	}
+
+	// Readers may expand a packed block at the same time
+	if (!m_blocks[tableIndex].compare_exchange_strong(entry, reinterpret_cast<uintptr_t>(coldBlock) | ColdTag, std::memory_order_acq_rel))
+	{
+		delete coldBlock;
+		return false;
+	}
+	m_coldBlocks.Add(1);
+	m_coldBytes.Add((int32_t)(sizeof(ColdBlock) + coldBlock->m_data.capacity()));
+	RetireEntry(entry);
+	return true;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+uint32_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::LastAccessTime(const glm::ivec3& blockIndex) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	return tableIndex >= 0 ? m_lastAccess[tableIndex].load(std::memory_order_relaxed) : 0;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::IsBlockWarm(const glm::ivec3& blockIndex) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return false;
+	}
+	const uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	return IsFullEntry(entry) || IsPackedEntry(entry);
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+size_t SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::BlockMemory(const glm::ivec3& blockIndex) const
+{
+	// Only safe where blocks can't be freed underneath us (see FreeRetiredBlocks)
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	const uintptr_t entry = tableIndex >= 0 ? m_blocks[tableIndex].load(std::memory_order_acquire) : UniformEntry(0);
+	if (IsFullEntry(entry))
+	{
+		return sizeof(BlockType);
+	}
+	else if (IsPackedEntry(entry))
+	{
+		// Shared blocks don't go away when one user drops them
+		Kernel::ScopedMutex lock(m_packedStoreLock);
+		return SharedPacked(entry)->m_refs > 1 ? 0 : PackedBlock(entry)->MemoryBytes();
+	}
+	else if (IsColdEntry(entry))
+	{
+		return sizeof(ColdBlock) + ColdBlockPtr(entry)->m_data.capacity();
+	}
+	return 0;
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::FreeRetiredBlocks()
+{
+	// Entries retired before the oldest running reader started can't be in use any more
+	const uint32_t epoch = m_epoch.fetch_add(1) + 1;
+	uint32_t oldestReader = epoch;
+	for (const auto& readerEpoch : m_readerEpochs)
+	{
+		const uint32_t readerStart = readerEpoch.load();
+		if (readerStart != 0 && readerStart < oldestReader)
+		{
+			oldestReader = readerStart;
+		}
+	}
+	{
+		Kernel::ScopedMutex lock(m_retiredLock);
+		auto stillVisible = std::stable_partition(m_retiredEntries.begin(), m_retiredEntries.end(), [oldestReader](const RetiredEntry& retired)
+		{
+			return retired.m_epoch >= oldestReader;
+		});
+		m_freeScratch.assign(stillVisible, m_retiredEntries.end());
+		m_retiredEntries.erase(stillVisible, m_retiredEntries.end());
+	}
+	for (const auto& retired : m_freeScratch)
+	{
+		FreeEntry(retired.m_entry);
+	}
+	m_freeScratch.clear();
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+void SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::UpdateOccupancy(const glm::ivec3& blockIndex)
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	if (tableIndex < 0)
+	{
+		return;
+	}
+	const uintptr_t entry = m_blocks[tableIndex].load(std::memory_order_acquire);
+	if (IsColdEntry(entry))
+	{
+		return;		// Compression never changes the contents, the old masks are still right
+	}
+
+	uint64_t masks[c_occupancyWords] = { 0 };
+	const uint32_t brickCount = c_bricksPerAxis * c_bricksPerAxis * c_bricksPerAxis;
+	if (IsUniformEntry(entry))
+	{
+		for (uint32_t brick = 0; brick < brickCount && UniformValue(entry) != 0; ++brick)
+		{
+			masks[brick >> 6] |= 1ull << (brick & 63);
+		}
+	}
+	else
+	{
+		VoxelData row[Dimensions];
+		for (uint32_t z = 0; z < Dimensions; ++z)
+		{
+			for (uint32_t y = 0; y < Dimensions; ++y)
+			{
+				if (IsPackedEntry(entry))
+				{
+					PackedBlock(entry)->DecodeRow(y, z, row);
+				}
+				else
+				{
+					FullBlock(entry)->ReadRow(y, z, row);
+				}
+				const uint32_t rowBrick = ((y / c_occupancyBrickSize) * c_bricksPerAxis) + ((z / c_occupancyBrickSize) * c_bricksPerAxis * c_bricksPerAxis);
+				for (uint32_t x = 0; x < Dimensions; ++x)
+				{
+					if (row[x] != 0)
+					{
+						const uint32_t brick = rowBrick + (x / c_occupancyBrickSize);
+						masks[brick >> 6] |= 1ull << (brick & 63);
+					}
+				}
+			}
+		}
+	}
+	for (uint32_t w = 0; w < c_occupancyWords; ++w)
+	{
+		m_occupancy[(tableIndex * c_occupancyWords) + w].store(masks[w], std::memory_order_relaxed);
+	}
+}
+
+template<class VoxelData, uint32_t Dimensions, class Allocator, class Layout>
+bool SparseVoxelModel<VoxelData, Dimensions, Allocator, Layout>::ReadOccupancy(const glm::ivec3& blockIndex, uint64_t* masks) const
+{
+	const int32_t tableIndex = BlockTableIndex(blockIndex);
+	for (uint32_t w = 0; w < c_occupancyWords; ++w)
+	{
+		masks[w] = tableIndex < 0 ? 0 : m_occupancy[(tableIndex * c_occupancyWords) + w].load(std::memory_order_relaxed);
+	}
+	return tableIndex >= 0;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "sparse_voxel_model_tests.h"
+#include "voxel_definitions.h"
+#include "kernel/assert.h"
+#include <memory>
+
+namespace SparseVoxelModelTests
+{
+	// Expands the block then compacts it again, which retires the expanded copy
+	void ReplaceBlock(VoxelModel& model, const glm::ivec3& blockIndex)
+	{
+		model.BlockAt(blockIndex)->Fill(PackVoxel(Materials::Walls, 0));
+		SDE_ASSERT(model.CompactBlock(blockIndex));
+	}
+
+	// Retired blocks stay until every reader that could have seen them is done, newer readers don't hold them up
+	void RetireEpochTest()
+	{
+		VoxelModel model;
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(64.0f, 32.0f, 32.0f)));
+		const glm::ivec3 first(0, 0, 0), second(1, 0, 0);
+
+		auto oldReader = std::make_unique<VoxelModel::ReadScope>(model);
+		ReplaceBlock(model, first);
+		model.FreeRetiredBlocks();
+		SDE_ASSERT(model.ExpandedBlockCount() == 1, "A reader older than the block still needs it");
+
+		auto newReader = std::make_unique<VoxelModel::ReadScope>(model);
+		oldReader = nullptr;
+		model.FreeRetiredBlocks();
+		SDE_ASSERT(model.ExpandedBlockCount() == 0, "Only newer readers are left");
+
+		ReplaceBlock(model, second);
+		model.FreeRetiredBlocks();
+		SDE_ASSERT(model.ExpandedBlockCount() == 1);
+		newReader = nullptr;
+		model.FreeRetiredBlocks();
+		SDE_ASSERT(model.ExpandedBlockCount() == 0);
+
+		// With readers coming and going all the time, nothing waits for a moment with no readers at all
+		std::unique_ptr<VoxelModel::ReadScope> readers[2];
+		for (uint32_t frame = 0; frame < 8; ++frame)
+		{
+			readers[frame & 1] = std::make_unique<VoxelModel::ReadScope>(model);
+			ReplaceBlock(model, first);
+			model.FreeRetiredBlocks();
+			SDE_ASSERT(model.ExpandedBlockCount() <= 2);
+		}
+		model.RemoveAllBlocks();
+	}
+
+	void RunTests()
+	{
+		RetireEpochTest();
+	}
+}
\ No newline at end of file
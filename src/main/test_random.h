@@ -0,0 +1,31 @@
+#pragma once
+
+#include "kernel/base_types.h"
+#include "math/box3.h"
+
+// Tiny LCG for the tests and benchmarks, so every run (and platform) sees the same sequence.
+// Each caller picks its own seed
+struct TestRandom
+{
+	explicit TestRandom(uint32_t seed) : m_state(seed) {}
+
+	uint32_t NextInt()
+	{
+		m_state = (m_state * 1664525u) + 1013904223u;
+		return m_state >> 8;
+	}
+	float Next()
+	{
+		return (float)NextInt() / (float)(1 << 24);
+	}
+	glm::vec3 NextPoint(const glm::vec3& minP, const glm::vec3& maxP)
+	{
+		return minP + ((maxP - minP) * glm::vec3(Next(), Next(), Next()));
+	}
+	glm::vec3 NextPoint(const Math::Box3& bounds)
+	{
+		return NextPoint(bounds.Min(), bounds.Max());
+	}
+
+	uint32_t m_state;
+};
\ No newline at end of file
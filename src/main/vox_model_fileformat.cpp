@@ -0,0 +1,26 @@
+#include "vox_model_fileformat.h"
+#include "kernel/file_io.h"
+#include "kernel/assert.h"
+#include <cstdio>
+#include <string>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+bool ReplaceModelFile(const char* filepath, const std::vector<uint8_t>& data)
+{
+	const std::string tempPath = std::string(filepath) + ".tmp";
+	if (!Kernel::FileIO::SaveBinaryFile(tempPath.c_str(), data))
+	{
+		SDE_LOGC(SDE, "Failed to write %s", tempPath.c_str());
+		remove(tempPath.c_str());
+		return false;
+	}
+	if (!MoveFileExA(tempPath.c_str(), filepath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		SDE_LOGC(SDE, "Failed to replace %s (error %d)", filepath, (int32_t)GetLastError());
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 #include "kernel/base_types.h"
+#include <vector>
 
 enum VoxelModelFileVersions
 {
 	Version_BaseRLE,	// Basic RLE-encoding per-block
-	Version_Current = Version_BaseRLE
+	Version_SharedRLE,	// Identical blocks share one RLE payload
+	Version_Current = Version_SharedRLE
 };
 
 struct ModelDataHeader
@@ -23,4 +25,76 @@ struct ModelBlockHeader
 	int32_t m_blockY;
 	int32_t m_blockZ;
 	uint32_t m_dataSize;
-};
\ No newline at end of file
+};
+
+// In model files, a block whose data size has this bit set has no data of its own. The other bits are
+// the index of an earlier block (in file order) with the same contents. Journals never use it
+static const uint32_t c_sharedBlockDataFlag = 0x80000000;
+
+struct ModelBlockRecord
+{
+	const ModelBlockHeader* m_header;
+	const uint8_t* m_data;		// Resolved, so shared blocks point at the original data
+	uint32_t m_dataSize;
+};
+
+// Reads the block at readOffset and moves past it. Model files pass every record read so far, to resolve shared data.
+// A record that runs past the end of the buffer (e.g. a journal append that was cut short) comes back with a null
+// header and moves readOffset to the end, callers should stop reading there
+inline ModelBlockRecord ReadModelBlockRecord(const std::vector<uint8_t>& buffer, size_t& readOffset, std::vector<ModelBlockRecord>* previousRecords)
+{
+	ModelBlockRecord record = { nullptr, nullptr, 0 };
+	if (readOffset + sizeof(ModelBlockHeader) > buffer.size())
+	{
+		readOffset = buffer.size();
+		return record;
+	}
+	const ModelBlockHeader* header = reinterpret_cast<const ModelBlockHeader*>(buffer.data() + readOffset);
+	const bool isShared = (header->m_dataSize & c_sharedBlockDataFlag) != 0 && previousRecords != nullptr;
+	const size_t ownDataSize = isShared ? 0 : header->m_dataSize;
+	if (readOffset + sizeof(ModelBlockHeader) + ownDataSize > buffer.size())
+	{
+		readOffset = buffer.size();
+		return record;
+	}
+	record.m_header = header;
+	readOffset += sizeof(ModelBlockHeader);
+	if (isShared)
+	{
+		const uint32_t sourceIndex = record.m_header->m_dataSize & ~c_sharedBlockDataFlag;
+		const bool validIndex = sourceIndex < previousRecords->size();
+		record.m_data = validIndex ? (*previousRecords)[sourceIndex].m_data : nullptr;
+		record.m_dataSize = validIndex ? (*previousRecords)[sourceIndex].m_dataSize : 0;
+	}
+	else
+	{
+		record.m_data = buffer.data() + readOffset;
+		record.m_dataSize = record.m_header->m_dataSize;
+		readOffset += record.m_dataSize;
+	}
+	if (previousRecords != nullptr)
+	{
+		previousRecords->push_back(record);
+	}
+	return record;
+}
+
+enum VoxelModelJournalVersions
+{
+	JournalVersion_BaseRLE,	// Same block encoding as the model file
+	JournalVersion_Current = JournalVersion_BaseRLE
+};
+
+// Journals sit next to a model file and are only ever appended to. They contain a header followed
+// by ModelBlockHeader + RLE data entries; later entries replace earlier ones and the model file.
+// An entry with a data size of 0 means the block is now empty
+struct ModelJournalHeader
+{
+	char m_magic[8];
+	uint32_t m_version;
+	uint32_t m_blockDimensions;
+};
+
+// Writes the data to filepath + ".tmp" and then moves it over filepath, so an interrupted save
+// leaves the old file intact. Returns false (and leaves the old file) if either step fails
+bool ReplaceModelFile(const char* filepath, const std::vector<uint8_t>& data);
\ No newline at end of file
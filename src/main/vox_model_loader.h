@@ -1,5 +1,8 @@
 #pragma once
 
+#include "vox_model_fileformat.h"
+#include <functional>
+
 template<class ModelType>
 class VoxelModelLoader
 {
@@ -8,11 +11,38 @@ public:
 	~VoxelModelLoader();
 
 	typedef std::function<void(glm::ivec3)> OnBlockLoadedCallback;
+	typedef std::function<float(const glm::ivec3&)> BlockPriorityCallback;	// Lower values are loaded first
 	bool LoadFromFile(ModelType& srcModel, const char* filepath, const OnBlockLoadedCallback& callback);
 
+	// Applies a journal written by VoxelModelSerialiser on top of an already loaded model
+	bool LoadJournal(ModelType& srcModel, const char* journalPath, const OnBlockLoadedCallback& callback);
+
+	// Streaming loads. The model file + journal are indexed up front (the model is allocated at this point),
+	// then blocks are decoded one at a time in priority order. Only the latest entry for each block is loaded
+	bool BeginStreaming(ModelType& srcModel, const char* filepath, const char* journalPath, const BlockPriorityCallback& priority);
+	bool StreamNextBlock(ModelType& srcModel, const OnBlockLoadedCallback& callback);	// false once all blocks are loaded
+	uint32_t StreamedBlockCount() const { return (uint32_t)m_streamedBlocks.size(); }
+	const glm::ivec3& StreamedBlockIndex(uint32_t index) const { return m_streamedBlocks[index].m_blockIndex; }
+
+	// Frees the file and journal data (and the streaming index into them) once a load is done, only the block scratch is kept
+	void ReleaseFileData();
+
 private:
-	void ParseBlock(ModelType& srcModel, size_t& readOffset, const OnBlockLoadedCallback& callback);
+	struct StreamedBlock
+	{
+		glm::ivec3 m_blockIndex;
+		ModelBlockRecord m_record;		// Points into m_rawBuffer or m_journalBuffer
+		float m_priority;
+	};
+
+	bool ReadModelHeader(ModelType& srcModel);
+	bool ValidateJournal(const std::vector<uint8_t>& journal);
+	void ParseBlock(ModelType& srcModel, const ModelBlockRecord& record, const OnBlockLoadedCallback& callback);
 	std::vector<uint8_t> m_rawBuffer;
+	std::vector<uint8_t> m_journalBuffer;
+	std::vector<StreamedBlock> m_streamedBlocks;
+	std::vector<uint8_t> m_decodedBlock;		// Kept between blocks (and loads, if the loader is reused)
+	uint32_t m_nextStreamedBlock;
 };
 
 #include "vox_model_loader.inl"
\ No newline at end of file
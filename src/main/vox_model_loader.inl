@@ -2,9 +2,13 @@
 #include "vox/model_data_writer.h"
 #include "core/run_length_encoding.h"
 #include "kernel/file_io.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
 
 template<class ModelType>
 VoxelModelLoader<ModelType>::VoxelModelLoader()
+	: m_nextStreamedBlock(0)
 {
 
 }
@@ -15,25 +19,40 @@ VoxelModelLoader<ModelType>::~VoxelModelLoader()
 }
 
 template<class ModelType>
-void VoxelModelLoader<ModelType>::ParseBlock(ModelType& srcModel, size_t& readOffset, const OnBlockLoadedCallback& callback)
+void VoxelModelLoader<ModelType>::ParseBlock(ModelType& srcModel, const ModelBlockRecord& record, const OnBlockLoadedCallback& callback)
 {
 	const uint32_t dimensions = typename ModelType::BlockType::VoxelDimensions;
 
-	ModelBlockHeader* blockHeader = reinterpret_cast<ModelBlockHeader*>(m_rawBuffer.data() + readOffset);
-	readOffset += sizeof(ModelBlockHeader);
-
+	const ModelBlockHeader* blockHeader = record.m_header;
 	Vox::ModelDataWriter<ModelType> dataWriter(srcModel);
 	glm::ivec3 blockIndex(blockHeader->m_blockX, blockHeader->m_blockY, blockHeader->m_blockZ);
 
+	// Journal entries with no data clear the block (as do broken shared blocks)
+	if (record.m_dataSize == 0 || record.m_data == nullptr)
+	{
+		const typename ModelType::BlockType::VoxelDataType emptyVoxel = 0;
+		for (uint32_t z = 0; z < dimensions; ++z)
+		{
+			for (uint32_t y = 0; y < dimensions; ++y)
+			{
+				for (uint32_t x = 0; x < dimensions; ++x)
+				{
+					dataWriter.WriteVoxel(blockIndex, glm::ivec3(x, y, z), emptyVoxel);
+				}
+			}
+		}
+		callback(blockIndex);
+		return;
+	}
+
 	// Now decode the entire block at once
 	Core::RunLengthDecoder rld;
-	std::vector<uint8_t> decodedBlock;
-	decodedBlock.reserve(blockHeader->m_dataSize);
-	rld.ReadData(m_rawBuffer.data() + readOffset, blockHeader->m_dataSize, decodedBlock);
-	readOffset += blockHeader->m_dataSize;
+	m_decodedBlock.clear();
+	m_decodedBlock.reserve(sizeof(typename ModelType::BlockType::VoxelDataType) * dimensions * dimensions * dimensions);
+	rld.ReadData(record.m_data, record.m_dataSize, m_decodedBlock);
 
-	auto vData = reinterpret_cast<typename ModelType::BlockType::VoxelDataType*>(decodedBlock.data());
-	SDE_ASSERT(decodedBlock.size() == sizeof(typename ModelType::BlockType::VoxelDataType) * dimensions * dimensions * dimensions);
+	auto vData = reinterpret_cast<typename ModelType::BlockType::VoxelDataType*>(m_decodedBlock.data());
+	SDE_ASSERT(m_decodedBlock.size() == sizeof(typename ModelType::BlockType::VoxelDataType) * dimensions * dimensions * dimensions);
 
 	glm::ivec3 voxelIndex;
 	for (uint32_t z = 0; z < dimensions; ++z)
@@ -54,43 +73,219 @@ void VoxelModelLoader<ModelType>::ParseBlock(ModelType& srcModel, size_t& readOf
 }
 
 template<class ModelType>
-bool VoxelModelLoader<ModelType>::LoadFromFile(ModelType& srcModel, const char* filepath, const OnBlockLoadedCallback& callback)
+bool VoxelModelLoader<ModelType>::ReadModelHeader(ModelType& srcModel)
 {
-	uint32_t dimensions = typename ModelType::BlockType::VoxelDimensions;
-	if (!Kernel::FileIO::LoadBinaryFile(filepath, m_rawBuffer))
-	{
-		return false;
-	}
 	SDE_ASSERT(m_rawBuffer.size() > sizeof(ModelDataHeader));
 
 	ModelDataHeader* header = (ModelDataHeader*)m_rawBuffer.data();
 	if (strcmp(header->m_magic, "VoxM") != 0)
 	{
-		SDE_ASSERT("Wrong format");
+		SDE_ASSERT(false, "Wrong format");
 		return false;
 	}
-	if (header->m_version != Version_Current)
+	if (header->m_version > Version_Current)
 	{
-		SDE_ASSERT("Old version");
+		SDE_ASSERT(false, "Newer version");
 		return false;
 	}
 	if (header->m_blockDimensions != typename ModelType::BlockType::VoxelDimensions)
 	{
-		SDE_ASSERT("Incompatible voxel data dimensions");
+		SDE_ASSERT(false, "Incompatible voxel data dimensions");
 		return false;
 	}
 	srcModel.SetVoxelSize(glm::vec3(header->m_voxelSize[0], header->m_voxelSize[1], header->m_voxelSize[2]));
 	srcModel.PreallocateMemory(Math::Box3(glm::vec3(header->m_totalBounds[0], header->m_totalBounds[1], header->m_totalBounds[2]),
 			glm::vec3(header->m_totalBounds[3], header->m_totalBounds[4], header->m_totalBounds[5])));		
 
+	return true;
+}
+
+template<class ModelType>
+bool VoxelModelLoader<ModelType>::ValidateJournal(const std::vector<uint8_t>& journal)
+{
+	if (journal.size() < sizeof(ModelJournalHeader))
+	{
+		return false;
+	}
+
+	const ModelJournalHeader* header = (const ModelJournalHeader*)journal.data();
+	if (strcmp(header->m_magic, "VoxJ") != 0)
+	{
+		SDE_ASSERT(false, "Wrong format");
+		return false;
+	}
+	if (header->m_version != JournalVersion_Current)
+	{
+		SDE_ASSERT(false, "Old version");
+		return false;
+	}
+	if (header->m_blockDimensions != typename ModelType::BlockType::VoxelDimensions)
+	{
+		SDE_ASSERT(false, "Incompatible voxel data dimensions");
+		return false;
+	}
+	return true;
+}
+
+template<class ModelType>
+bool VoxelModelLoader<ModelType>::LoadFromFile(ModelType& srcModel, const char* filepath, const OnBlockLoadedCallback& callback)
+{
+	if (!Kernel::FileIO::LoadBinaryFile(filepath, m_rawBuffer))
+	{
+		return false;
+	}
+	if (!ReadModelHeader(srcModel))
+	{
+		return false;
+	}
+
+	const ModelDataHeader* header = (const ModelDataHeader*)m_rawBuffer.data();
+	std::vector<ModelBlockRecord> records;
+	records.reserve(header->m_blockCount);
+	size_t readOffset = sizeof(ModelDataHeader);
+	for (uint32_t b = 0; b < header->m_blockCount; ++b)
+	{
+		const ModelBlockRecord record = ReadModelBlockRecord(m_rawBuffer, readOffset, &records);
+		if (record.m_header == nullptr)
+		{
+			SDE_LOGC(SDE, "Model file %s is truncated, only %d of %d blocks loaded", filepath, b, header->m_blockCount);
+			break;
+		}
+		ParseBlock(srcModel, record, callback);
+	}
+	SDE_ASSERT(readOffset <= m_rawBuffer.size());
+
+	return true;
+}
+
+template<class ModelType>
+bool VoxelModelLoader<ModelType>::LoadJournal(ModelType& srcModel, const char* journalPath, const OnBlockLoadedCallback& callback)
+{
+	if (!Kernel::FileIO::LoadBinaryFile(journalPath, m_journalBuffer) || !ValidateJournal(m_journalBuffer))
+	{
+		return false;	// No journal is fine, the model file is up to date
+	}
+
+	// Entries are applied in order, so later edits to a block win. An append that was cut short leaves a
+	// partial entry at the end, everything before it is still good
+	size_t readOffset = sizeof(ModelJournalHeader);
+	while (readOffset + sizeof(ModelBlockHeader) <= m_journalBuffer.size())
+	{
+		const ModelBlockRecord record = ReadModelBlockRecord(m_journalBuffer, readOffset, nullptr);
+		if (record.m_header == nullptr)
+		{
+			break;
+		}
+		ParseBlock(srcModel, record, callback);
+	}
+	SDE_ASSERT(readOffset <= m_journalBuffer.size());
+
+	return true;
+}
+
+template<class ModelType>
+bool VoxelModelLoader<ModelType>::BeginStreaming(ModelType& srcModel, const char* filepath, const char* journalPath, const BlockPriorityCallback& priority)
+{
+	m_streamedBlocks.clear();
+	m_nextStreamedBlock = 0;
+	if (!Kernel::FileIO::LoadBinaryFile(filepath, m_rawBuffer))
+	{
+		return false;
+	}
+	if (!ReadModelHeader(srcModel))
+	{
+		return false;
+	}
+
+	// Index the block entries without decoding anything. Journal entries replace the model file ones
+	typedef std::tuple<int32_t, int32_t, int32_t> BlockKey;
+	std::map<BlockKey, StreamedBlock> latestBlocks;
+	auto indexBlock = [&latestBlocks](const ModelBlockRecord& record)
+	{
+		const ModelBlockHeader* blockHeader = record.m_header;
+		const BlockKey key(blockHeader->m_blockX, blockHeader->m_blockY, blockHeader->m_blockZ);
+		if (record.m_dataSize == 0)
+		{
+			latestBlocks.erase(key);	// The block was preallocated empty, nothing to load
+		}
+		else
+		{
+			StreamedBlock& entry = latestBlocks[key];
+			entry.m_blockIndex = glm::ivec3(blockHeader->m_blockX, blockHeader->m_blockY, blockHeader->m_blockZ);
+			entry.m_record = record;
+			entry.m_priority = 0.0f;
+		}
+	};
+
+	const ModelDataHeader* header = (const ModelDataHeader*)m_rawBuffer.data();
+	std::vector<ModelBlockRecord> modelRecords;
+	modelRecords.reserve(header->m_blockCount);
 	size_t readOffset = sizeof(ModelDataHeader);
 	for (uint32_t b = 0; b < header->m_blockCount; ++b)
 	{
-		ParseBlock(srcModel, readOffset, callback);
+		const ModelBlockRecord record = ReadModelBlockRecord(m_rawBuffer, readOffset, &modelRecords);
+		if (record.m_header == nullptr)
+		{
+			SDE_LOGC(SDE, "Model file %s is truncated, only %d of %d blocks loaded", filepath, b, header->m_blockCount);
+			break;
+		}
+		indexBlock(record);
 	}
 	SDE_ASSERT(readOffset <= m_rawBuffer.size());
 
+	m_journalBuffer.clear();
+	if (journalPath != nullptr && Kernel::FileIO::LoadBinaryFile(journalPath, m_journalBuffer) && ValidateJournal(m_journalBuffer))
+	{
+		readOffset = sizeof(ModelJournalHeader);
+		while (readOffset + sizeof(ModelBlockHeader) <= m_journalBuffer.size())
+		{
+			const ModelBlockRecord record = ReadModelBlockRecord(m_journalBuffer, readOffset, nullptr);
+			if (record.m_header == nullptr)
+			{
+				break;	// Partial entry from an interrupted append
+			}
+			indexBlock(record);
+		}
+		SDE_ASSERT(readOffset <= m_journalBuffer.size());
+	}
+
+	m_streamedBlocks.reserve(latestBlocks.size());
+	for (const auto& it : latestBlocks)
+	{
+		m_streamedBlocks.push_back(it.second);
+	}
+	if (priority != nullptr)
+	{
+		for (auto& block : m_streamedBlocks)
+		{
+			block.m_priority = priority(block.m_blockIndex);
+		}
+		std::sort(m_streamedBlocks.begin(), m_streamedBlocks.end(), [](const StreamedBlock& b0, const StreamedBlock& b1)
+		{
+			return b0.m_priority < b1.m_priority;
+		});
+	}
+
 	return true;
 }
 
+template<class ModelType>
+bool VoxelModelLoader<ModelType>::StreamNextBlock(ModelType& srcModel, const OnBlockLoadedCallback& callback)
+{
+	if (m_nextStreamedBlock >= m_streamedBlocks.size())
+	{
+		return false;
+	}
+	const StreamedBlock& block = m_streamedBlocks[m_nextStreamedBlock++];
+	ParseBlock(srcModel, block.m_record, callback);
+	return true;
+}
 
+template<class ModelType>
+void VoxelModelLoader<ModelType>::ReleaseFileData()
+{
+	std::vector<uint8_t>().swap(m_rawBuffer);
+	std::vector<uint8_t>().swap(m_journalBuffer);
+	std::vector<StreamedBlock>().swap(m_streamedBlocks);
+	m_nextStreamedBlock = 0;
+}
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "voxel_binary_mesher.h"
+#include "kernel/assert.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32_t CountTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, v);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+static inline uint32_t RowMask(const VoxelData* row, uint32_t count)
+{
+	uint32_t mask = 0;
+	for (uint32_t x = 0; x < count; ++x)
+	{
+		mask |= (row[x] != 0 ? 1u : 0u) << x;
+	}
+	return mask;
+}
+
+VoxelBinaryMesher::VoxelBinaryMesher(const VoxelModel& model, VoxelData valueMask)
+	: m_model(model)
+	, m_dimensions(c_dimensions)
+	, m_origin(0.0f)
+	, m_cellSize(1.0f)
+	, m_valueMask(valueMask)
+	, m_voxels(c_dimensions * c_dimensions * c_dimensions)
+{
+}
+
+void VoxelBinaryMesher::LoadBlock(const glm::ivec3& blockIndex)
+{
+	const uint32_t d = c_dimensions;
+	VoxelData row[c_dimensions];
+	memset(m_rowSolid, 0, sizeof(m_rowSolid));
+	memset(m_columnSolid, 0, sizeof(m_columnSolid));
+
+	for (uint32_t z = 0; z < d; ++z)
+	{
+		for (uint32_t y = 0; y < d; ++y)
+		{
+			VoxelData* blockRow = &m_voxels[(y * d) + (z * d * d)];
+			m_model.DecodeRow(blockIndex, y, z, blockRow);
+			const uint32_t mask = RowMask(blockRow, d);
+			m_rowSolid[z + 1][y + 1] = mask;
+			for (uint32_t bits = mask; bits != 0; bits &= bits - 1)
+			{
+				m_columnSolid[CountTrailingZeros(bits) + 1][y] |= 1u << z;
+			}
+		}
+	}
+
+	// Only the neighbour voxels touching this block matter. Out of range blocks read as air
+	for (uint32_t i = 0; i < d; ++i)
+	{
+		m_model.DecodeRow(blockIndex + glm::ivec3(0, -1, 0), d - 1, i, row);
+		m_rowSolid[i + 1][0] = RowMask(row, d);
+		m_model.DecodeRow(blockIndex + glm::ivec3(0, 1, 0), 0, i, row);
+		m_rowSolid[i + 1][d + 1] = RowMask(row, d);
+		m_model.DecodeRow(blockIndex + glm::ivec3(0, 0, -1), i, d - 1, row);
+		m_rowSolid[0][i + 1] = RowMask(row, d);
+		m_model.DecodeRow(blockIndex + glm::ivec3(0, 0, 1), i, 0, row);
+		m_rowSolid[d + 1][i + 1] = RowMask(row, d);
+	}
+	for (uint32_t z = 0; z < d; ++z)
+	{
+		for (uint32_t y = 0; y < d; ++y)
+		{
+			m_columnSolid[0][y] |= (m_model.ReadVoxel(blockIndex + glm::ivec3(-1, 0, 0), d - 1, y, z) != 0 ? 1u : 0u) << z;
+			m_columnSolid[d + 1][y] |= (m_model.ReadVoxel(blockIndex + glm::ivec3(1, 0, 0), 0, y, z) != 0 ? 1u : 0u) << z;
+		}
+	}
+}
+
+void VoxelBinaryMesher::LoadGrid(const VoxelData* cells)
+{
+	const uint32_t d = m_dimensions;
+	memcpy(m_voxels.data(), cells, d * d * d * sizeof(VoxelData));
+	memset(m_rowSolid, 0, sizeof(m_rowSolid));
+	memset(m_columnSolid, 0, sizeof(m_columnSolid));
+	for (uint32_t z = 0; z < d; ++z)
+	{
+		for (uint32_t y = 0; y < d; ++y)
+		{
+			const uint32_t mask = RowMask(&m_voxels[(y * d) + (z * d * d)], d);
+			m_rowSolid[z + 1][y + 1] = mask;
+			for (uint32_t bits = mask; bits != 0; bits &= bits - 1)
+			{
+				m_columnSolid[CountTrailingZeros(bits) + 1][y] |= 1u << z;
+			}
+		}
+	}
+}
+
+void VoxelBinaryMesher::EmitQuad(Axis axis, bool positive, uint32_t slice, uint32_t u, uint32_t v, uint32_t width, uint32_t height, VoxelData value)
+{
+	// Rows/bits are (z, x) for y slices, (y, x) for z slices and (y, z) for x slices
+	const uint32_t plane = slice + (positive ? 1 : 0);
+	glm::uvec3 corners[4];
+	const uint32_t us[4] = { u, u + width, u + width, u };
+	const uint32_t vs[4] = { v, v, v + height, v + height };
+	glm::vec3 normal(0.0f);
+	QuadDescriptor quad;
+	switch (axis)
+	{
+	case XAxis:
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			corners[c] = glm::uvec3(plane, vs[c], us[c]);
+		}
+		normal.x = positive ? 1.0f : -1.0f;
+		quad.m_normal = positive ? QuadDescriptor::NormalDirection::XAxisPositive : QuadDescriptor::NormalDirection::XAxisNegative;
+		break;
+	case YAxis:
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			corners[c] = glm::uvec3(us[c], plane, vs[c]);
+		}
+		normal.y = positive ? 1.0f : -1.0f;
+		quad.m_normal = positive ? QuadDescriptor::NormalDirection::YAxisPositive : QuadDescriptor::NormalDirection::YAxisNegative;
+		break;
+	case ZAxis:
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			corners[c] = glm::uvec3(us[c], vs[c], plane);
+		}
+		normal.z = positive ? 1.0f : -1.0f;
+		quad.m_normal = positive ? QuadDescriptor::NormalDirection::ZAxisPositive : QuadDescriptor::NormalDirection::ZAxisNegative;
+		break;
+	}
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		quad.m_vertices[c] = m_origin + (glm::vec3(corners[c]) * m_cellSize);
+	}
+	if (glm::dot(glm::cross(quad.m_vertices[1] - quad.m_vertices[0], quad.m_vertices[3] - quad.m_vertices[0]), normal) < 0.0f)
+	{
+		std::swap(quad.m_vertices[1], quad.m_vertices[3]);
+	}
+	quad.m_sourceData = value;
+	m_quads.push_back(quad);
+}
+
+void VoxelBinaryMesher::MeshSlice(Axis axis, bool positive, uint32_t slice, const uint32_t* faceRows)
+{
+	// Split the faces by voxel value, there are only ever a handful per slice
+	m_planes.clear();
+	for (uint32_t r = 0; r < m_dimensions; ++r)
+	{
+		for (uint32_t bits = faceRows[r]; bits != 0; bits &= bits - 1)
+		{
+			const uint32_t bit = CountTrailingZeros(bits);
+			const VoxelData voxel = axis == XAxis ? VoxelAt(slice, r, bit) : (axis == YAxis ? VoxelAt(bit, slice, r) : VoxelAt(bit, r, slice));
+			const VoxelData value = voxel & m_valueMask;
+			FacePlane* plane = nullptr;
+			for (auto& p : m_planes)
+			{
+				if (p.m_value == value)
+				{
+					plane = &p;
+					break;
+				}
+			}
+			if (plane == nullptr)
+			{
+				m_planes.emplace_back();
+				plane = &m_planes.back();
+				plane->m_value = value;
+				memset(plane->m_rows, 0, sizeof(plane->m_rows));
+			}
+			plane->m_rows[r] |= 1u << bit;
+		}
+	}
+
+	// Take the first run in a row, then grow it over the following rows while they have the same run
+	for (auto& plane : m_planes)
+	{
+		for (uint32_t r = 0; r < m_dimensions; ++r)
+		{
+			while (plane.m_rows[r] != 0)
+			{
+				const uint32_t start = CountTrailingZeros(plane.m_rows[r]);
+				const uint32_t width = CountTrailingZeros(~((uint64_t)plane.m_rows[r] >> start));
+				const uint32_t runMask = (uint32_t)(((1ull << width) - 1) << start);
+				uint32_t height = 1;
+				while (r + height < m_dimensions && (plane.m_rows[r + height] & runMask) == runMask)
+				{
+					plane.m_rows[r + height] &= ~runMask;
+					++height;
+				}
+				plane.m_rows[r] &= ~runMask;
+				EmitQuad(axis, positive, slice, start, r, width, height, plane.m_value);
+			}
+		}
+	}
+}
+
+void VoxelBinaryMesher::ExtractQuads(const Math::Box3& bounds)
+{
+	glm::ivec3 blockStart, blockEnd;
+	m_model.GetBlockIterationParameters(bounds, blockStart, blockEnd);
+	SDE_ASSERT(blockStart == blockEnd, "Bounds must be a single block");
+	m_dimensions = c_dimensions;
+	m_origin = glm::vec3(blockStart * (int32_t)c_dimensions) * m_model.GetVoxelSize();
+	m_cellSize = m_model.GetVoxelSize();
+	LoadBlock(blockStart);
+	ExtractLoadedQuads();
+}
+
+void VoxelBinaryMesher::LoadBlockVoxels(const Math::Box3& bounds)
+{
+	glm::ivec3 blockStart, blockEnd;
+	m_model.GetBlockIterationParameters(bounds, blockStart, blockEnd);
+	SDE_ASSERT(blockStart == blockEnd, "Bounds must be a single block");
+	const uint32_t d = c_dimensions;
+	m_dimensions = d;
+	for (uint32_t z = 0; z < d; ++z)
+	{
+		for (uint32_t y = 0; y < d; ++y)
+		{
+			m_model.DecodeRow(blockStart, y, z, &m_voxels[(y * d) + (z * d * d)]);
+		}
+	}
+}
+
+void VoxelBinaryMesher::ExtractQuads(const VoxelData* cells, uint32_t dimensions, const glm::vec3& origin, const glm::vec3& cellSize)
+{
+	SDE_ASSERT(dimensions > 0 && dimensions <= c_dimensions);
+	m_dimensions = dimensions;
+	m_origin = origin;
+	m_cellSize = cellSize;
+	LoadGrid(cells);
+	ExtractLoadedQuads();
+}
+
+size_t VoxelBinaryMesher::ScratchBytes() const
+{
+	return (m_quads.capacity() * sizeof(QuadDescriptor)) + (m_voxels.capacity() * sizeof(VoxelData)) + (m_planes.capacity() * sizeof(FacePlane));
+}
+
+void VoxelBinaryMesher::ExtractLoadedQuads()
+{
+	m_quads.clear();
+
+	// A face is visible where a solid voxel's neighbour in the slice before/after is empty
+	const uint32_t d = m_dimensions;
+	uint32_t faceRows[2][c_dimensions];
+	for (uint32_t s = 0; s < d; ++s)
+	{
+		for (uint32_t r = 0; r < d; ++r)
+		{
+			faceRows[0][r] = m_columnSolid[s + 1][r] & ~m_columnSolid[s][r];
+			faceRows[1][r] = m_columnSolid[s + 1][r] & ~m_columnSolid[s + 2][r];
+		}
+		MeshSlice(XAxis, false, s, faceRows[0]);
+		MeshSlice(XAxis, true, s, faceRows[1]);
+
+		for (uint32_t r = 0; r < d; ++r)
+		{
+			faceRows[0][r] = m_rowSolid[r + 1][s + 1] & ~m_rowSolid[r + 1][s];
+			faceRows[1][r] = m_rowSolid[r + 1][s + 1] & ~m_rowSolid[r + 1][s + 2];
+		}
+		MeshSlice(YAxis, false, s, faceRows[0]);
+		MeshSlice(YAxis, true, s, faceRows[1]);
+
+		for (uint32_t r = 0; r < d; ++r)
+		{
+			faceRows[0][r] = m_rowSolid[s + 1][r + 1] & ~m_rowSolid[s][r + 1];
+			faceRows[1][r] = m_rowSolid[s + 1][r + 1] & ~m_rowSolid[s + 2][r + 1];
+		}
+		MeshSlice(ZAxis, false, s, faceRows[0]);
+		MeshSlice(ZAxis, true, s, faceRows[1]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include "vox/greedy_quad_extractor.h"
+#include "math/box3.h"
+#include <vector>
+
+// Greedy mesher for one 32^3 block of a VoxelModel, a drop-in for Vox::GreedyQuadExtractor.
+// Solidity is kept as 32 bit masks per row, so visible faces of a whole row are found with a couple of bitwise ops.
+// Faces with the same voxel value (after the value mask) are merged into rectangles, runs are found with count-trailing-zeros.
+// Blocks are read with DecodeRow/ReadVoxel, so packed and uniform blocks are never expanded.
+// Quads wind counter-clockwise seen from outside, i.e. cross(v1 - v0, v3 - v0) points along the normal
+class VoxelBinaryMesher
+{
+public:
+	typedef Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor QuadDescriptor;
+	typedef std::vector<QuadDescriptor>::const_iterator QuadIterator;
+	static const uint32_t c_dimensions = VoxelModel::BlockType::VoxelDimensions;
+	static_assert(c_dimensions == 32, "Row masks are 32 bits");
+
+	// Only the bits in valueMask split quads and end up in m_sourceData, i.e. c_materialMask merges across damage levels
+	static const VoxelData c_materialMask = 0x3f;
+	explicit VoxelBinaryMesher(const VoxelModel& model, VoxelData valueMask = 0xff);
+
+	// The bounds must be exactly one block (as floor chunks are)
+	void ExtractQuads(const Math::Box3& bounds);
+
+	// Meshes a standalone grid of cells (x-major, dimensions^3, dimensions <= 32), everything outside it counts as empty.
+	// Quads are placed at origin + corner * cellSize. Used for the coarse LOD meshes
+	void ExtractQuads(const VoxelData* cells, uint32_t dimensions, const glm::vec3& origin, const glm::vec3& cellSize);
+	inline QuadIterator Begin() const { return m_quads.begin(); }
+	inline QuadIterator End() const { return m_quads.end(); }
+
+	// The full voxel data of the last block (or grid) extracted, x-major
+	inline const VoxelData* BlockVoxels() const { return m_voxels.data(); }
+
+	// Fills BlockVoxels with the block at bounds without meshing it
+	void LoadBlockVoxels(const Math::Box3& bounds);
+
+	// Capacity of the buffers kept between extractions, it stops changing once they have grown to fit
+	size_t ScratchBytes() const;
+
+private:
+	struct FacePlane		// Faces of one voxel value in a slice
+	{
+		VoxelData m_value;
+		uint32_t m_rows[c_dimensions];
+	};
+	enum Axis
+	{
+		XAxis,
+		YAxis,
+		ZAxis
+	};
+
+	void LoadBlock(const glm::ivec3& blockIndex);
+	void LoadGrid(const VoxelData* cells);
+	void ExtractLoadedQuads();
+	void MeshSlice(Axis axis, bool positive, uint32_t slice, const uint32_t* faceRows);
+	void EmitQuad(Axis axis, bool positive, uint32_t slice, uint32_t u, uint32_t v, uint32_t width, uint32_t height, VoxelData value);
+	inline VoxelData VoxelAt(uint32_t x, uint32_t y, uint32_t z) const { return m_voxels[x + (y * m_dimensions) + (z * m_dimensions * m_dimensions)]; }
+
+	const VoxelModel& m_model;
+	uint32_t m_dimensions;		// Of whatever is loaded, c_dimensions for blocks
+	glm::vec3 m_origin;
+	glm::vec3 m_cellSize;
+	VoxelData m_valueMask;
+	std::vector<QuadDescriptor> m_quads;
+	std::vector<VoxelData> m_voxels;		// The block or grid, x-major
+	uint32_t m_rowSolid[c_dimensions + 2][c_dimensions + 2];	// [z + 1][y + 1], bit x set if solid. Includes the neighbour blocks' faces
+	uint32_t m_columnSolid[c_dimensions + 2][c_dimensions];	// [x + 1][y], bit z set if solid
+	std::vector<FacePlane> m_planes;
+};
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "voxel_binary_mesher_tests.h"
+#include "voxel_binary_mesher.h"
+#include "voxel_damage_lookup.h"
+#include "test_random.h"
+#include "kernel/assert.h"
+#include <vector>
+
+namespace VoxelBinaryMesherTests
+{
+	typedef VoxelBinaryMesher::QuadDescriptor QuadDescriptor;
+	const int32_t c_blockSize = 32;
+
+	// 3 x 2 x 3 blocks, so the middle bottom block has neighbours on every side but +y
+	void BuildModel(VoxelModel& model, TestRandom& random, uint32_t boxCount)
+	{
+		model.SetVoxelSize(glm::vec3(0.25f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(24.0f, 16.0f, 24.0f)));
+		for (uint32_t box = 0; box < boxCount; ++box)
+		{
+			const glm::ivec3 boxMin(random.NextInt() % 90, random.NextInt() % 58, random.NextInt() % 90);
+			const glm::ivec3 boxSize(1 + random.NextInt() % 12, 1 + random.NextInt() % 12, 1 + random.NextInt() % 12);
+			const VoxelData value = (box % 7) == 0 ? 0 : PackVoxel((Materials)(1 + box % 3), (uint8_t)(random.NextInt() % 2));
+			for (int32_t z = boxMin.z; z < boxMin.z + boxSize.z && z < 96; ++z)
+			{
+				for (int32_t y = boxMin.y; y < boxMin.y + boxSize.y && y < 64; ++y)
+				{
+					for (int32_t x = boxMin.x; x < boxMin.x + boxSize.x && x < 96; ++x)
+					{
+						model.BlockAt(glm::ivec3(x / 32, y / 32, z / 32))->VoxelAt(x % 32, y % 32, z % 32) = value;
+					}
+				}
+			}
+		}
+		for (int32_t z = 0; z < 3; ++z)
+		{
+			for (int32_t y = 0; y < 2; ++y)
+			{
+				for (int32_t x = 0; x < 3; ++x)
+				{
+					model.CompactBlock(glm::ivec3(x, y, z));
+				}
+			}
+		}
+	}
+
+	// Index into c_directions, -x, +x, -y, +y, -z, +z
+	const glm::ivec3 c_directions[6] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+	uint32_t DirectionIndex(QuadDescriptor::NormalDirection normal)
+	{
+		switch (normal)
+		{
+		case QuadDescriptor::NormalDirection::XAxisNegative:
+			return 0;
+		case QuadDescriptor::NormalDirection::XAxisPositive:
+			return 1;
+		case QuadDescriptor::NormalDirection::YAxisNegative:
+			return 2;
+		case QuadDescriptor::NormalDirection::YAxisPositive:
+			return 3;
+		case QuadDescriptor::NormalDirection::ZAxisNegative:
+			return 4;
+		default:
+			return 5;
+		}
+	}
+
+	VoxelData ReadModel(const VoxelModel& model, const glm::ivec3& v)
+	{
+		if (glm::any(glm::lessThan(v, glm::ivec3(0))))
+		{
+			return 0;
+		}
+		return model.ReadVoxel(v / c_blockSize, v.x % c_blockSize, v.y % c_blockSize, v.z % c_blockSize);
+	}
+
+	// Every visible voxel face must be covered by exactly one quad with the voxel's value, and nothing else
+	void CheckBlock(const VoxelModel& model, const glm::ivec3& blockIndex)
+	{
+		const glm::vec3 blockSize = model.GetVoxelSize() * (float)c_blockSize;
+		const glm::vec3 blockMin = glm::vec3(blockIndex) * blockSize;
+		VoxelBinaryMesher mesher(model);
+		mesher.ExtractQuads(Math::Box3(blockMin, blockMin + blockSize));
+
+		// Faces indexed by voxel and direction
+		std::vector<uint8_t> covered(c_blockSize * c_blockSize * c_blockSize * 6, 0);
+		const glm::ivec3 origin = blockIndex * c_blockSize;
+		for (auto q = mesher.Begin(); q != mesher.End(); ++q)
+		{
+			const uint32_t dir = DirectionIndex(q->m_normal);
+			const glm::vec3 normal(c_directions[dir]);
+			const glm::vec3 cross = glm::cross(q->m_vertices[1] - q->m_vertices[0], q->m_vertices[3] - q->m_vertices[0]);
+			SDE_ASSERT(glm::dot(cross, normal) > 0.0f, "Quads must face outwards");
+
+			glm::vec3 qMin = q->m_vertices[0], qMax = q->m_vertices[0];
+			for (uint32_t c = 1; c < 4; ++c)
+			{
+				qMin = glm::min(qMin, q->m_vertices[c]);
+				qMax = glm::max(qMax, q->m_vertices[c]);
+			}
+			glm::ivec3 vMin = glm::ivec3(glm::round(qMin / model.GetVoxelSize())) - origin;
+			glm::ivec3 vMax = glm::ivec3(glm::round(qMax / model.GetVoxelSize())) - origin;
+
+			// The quad lies on the plane in front of the voxels it belongs to
+			const uint32_t axis = dir / 2;
+			if (dir & 1)
+			{
+				vMin[axis] -= 1;
+			}
+			vMax[axis] = vMin[axis] + 1;
+			for (int32_t z = vMin.z; z < vMax.z; ++z)
+			{
+				for (int32_t y = vMin.y; y < vMax.y; ++y)
+				{
+					for (int32_t x = vMin.x; x < vMax.x; ++x)
+					{
+						SDE_ASSERT(x >= 0 && y >= 0 && z >= 0 && x < c_blockSize && y < c_blockSize && z < c_blockSize);
+						const glm::ivec3 v = origin + glm::ivec3(x, y, z);
+						SDE_ASSERT(ReadModel(model, v) == q->m_sourceData);
+						SDE_ASSERT(ReadModel(model, v + c_directions[dir]) == 0);
+						uint8_t& face = covered[(x + (y * c_blockSize) + (z * c_blockSize * c_blockSize)) * 6 + dir];
+						SDE_ASSERT(face == 0, "Faces must only be covered once");
+						face = 1;
+					}
+				}
+			}
+		}
+
+		for (int32_t z = 0; z < c_blockSize; ++z)
+		{
+			for (int32_t y = 0; y < c_blockSize; ++y)
+			{
+				for (int32_t x = 0; x < c_blockSize; ++x)
+				{
+					const glm::ivec3 v = origin + glm::ivec3(x, y, z);
+					for (uint32_t dir = 0; dir < 6; ++dir)
+					{
+						const bool visible = ReadModel(model, v) != 0 && ReadModel(model, v + c_directions[dir]) == 0;
+						SDE_ASSERT(visible == (covered[(x + (y * c_blockSize) + (z * c_blockSize * c_blockSize)) * 6 + dir] != 0));
+					}
+				}
+			}
+		}
+	}
+
+	size_t QuadCount(const VoxelModel& model, const glm::ivec3& blockIndex)
+	{
+		const glm::vec3 blockSize = model.GetVoxelSize() * (float)c_blockSize;
+		const glm::vec3 blockMin = glm::vec3(blockIndex) * blockSize;
+		VoxelBinaryMesher mesher(model);
+		mesher.ExtractQuads(Math::Box3(blockMin, blockMin + blockSize));
+		return std::distance(mesher.Begin(), mesher.End());
+	}
+
+	void SimpleShapesTest()
+	{
+		VoxelModel model;
+		model.SetVoxelSize(glm::vec3(0.25f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(16.0f, 8.0f, 8.0f)));
+		model.BlockAt(glm::ivec3(0))->VoxelAt(5, 6, 7) = PackVoxel(Materials::Walls, 0);
+		SDE_ASSERT(QuadCount(model, glm::ivec3(0)) == 6);
+		CheckBlock(model, glm::ivec3(0));
+
+		// A full block merges down to one quad per side, and hides the faces of the block next to it
+		model.BlockAt(glm::ivec3(0))->Fill(PackVoxel(Materials::Walls, 0));
+		SDE_ASSERT(QuadCount(model, glm::ivec3(0)) == 6);
+		model.BlockAt(glm::ivec3(1, 0, 0))->Fill(PackVoxel(Materials::Walls, 0));
+		SDE_ASSERT(QuadCount(model, glm::ivec3(0)) == 5);
+		CheckBlock(model, glm::ivec3(0));
+
+		// Different damage means a different colour, so the faces split
+		model.BlockAt(glm::ivec3(0))->VoxelAt(0, 31, 0) = PackVoxel(Materials::Walls, 1);
+		SDE_ASSERT(QuadCount(model, glm::ivec3(0)) > 5);
+		CheckBlock(model, glm::ivec3(0));
+	}
+
+	// Damage must not split quads when it is masked off, it goes in the lookup instead
+	void DamageLookupTest()
+	{
+		VoxelModel model;
+		model.SetVoxelSize(glm::vec3(0.25f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(8.0f)));
+		auto block = model.BlockAt(glm::ivec3(0));
+		block->Fill(PackVoxel(Materials::Walls, 0));
+		const glm::vec3 blockSize = model.GetVoxelSize() * (float)c_blockSize;
+		VoxelBinaryMesher mesher(model, VoxelBinaryMesher::c_materialMask);
+		mesher.ExtractQuads(Math::Box3(glm::vec3(0.0f), blockSize));
+		VoxelDamageLookup damage;
+		damage.Build(mesher.BlockVoxels());
+		SDE_ASSERT(damage.IsEmpty());
+
+		TestRandom random(0x6b43a9b5);
+		for (int32_t z = 0; z < c_blockSize; ++z)
+		{
+			for (int32_t y = 0; y < c_blockSize; ++y)
+			{
+				for (int32_t x = 0; x < c_blockSize; ++x)
+				{
+					block->VoxelAt(x, y, z) = PackVoxel(Materials::Walls, (uint8_t)(random.NextInt() % 4));
+				}
+			}
+		}
+		mesher.ExtractQuads(Math::Box3(glm::vec3(0.0f), blockSize));
+		SDE_ASSERT(std::distance(mesher.Begin(), mesher.End()) == 6);
+		for (auto q = mesher.Begin(); q != mesher.End(); ++q)
+		{
+			SDE_ASSERT(q->m_sourceData == static_cast<VoxelData>(Materials::Walls));
+		}
+		SDE_ASSERT(QuadCount(model, glm::ivec3(0)) > 6);
+
+		damage.Build(mesher.BlockVoxels());
+		SDE_ASSERT(!damage.IsEmpty() && damage.Data().size() == VoxelDamageLookup::c_totalBytes);
+		for (int32_t z = 0; z < c_blockSize; ++z)
+		{
+			for (int32_t y = 0; y < c_blockSize; ++y)
+			{
+				for (int32_t x = 0; x < c_blockSize; ++x)
+				{
+					SDE_ASSERT(damage.DamageAt(x, y, z) == GetVoxelDamage(block->VoxelAt(x, y, z)));
+				}
+			}
+		}
+	}
+
+	void RandomModelTest()
+	{
+		TestRandom random(0x6b43a9b5);
+		for (uint32_t test = 0; test < 4; ++test)
+		{
+			VoxelModel model;
+			BuildModel(model, random, 30 + test * 40);
+			for (int32_t z = 0; z < 3; ++z)
+			{
+				for (int32_t y = 0; y < 2; ++y)
+				{
+					for (int32_t x = 0; x < 3; ++x)
+					{
+						CheckBlock(model, glm::ivec3(x, y, z));
+					}
+				}
+			}
+		}
+	}
+
+	void RunTests()
+	{
+		SimpleShapesTest();
+		DamageLookupTest();
+		RandomModelTest();
+	}
+}
\ No newline at end of file
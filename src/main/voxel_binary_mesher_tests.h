@@ -0,0 +1,6 @@
+#pragma once
+
+namespace VoxelBinaryMesherTests
+{
+	void RunTests();
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "voxel_block_allocator.h"
+#include "kernel/assert.h"
+#include "kernel/atomics.h"
+#include "kernel/mutex.h"
+#include <vector>
+#include <thread>
+#include <functional>
+#include <cstring>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+namespace
+{
+	const size_t c_slabBytes = VoxelBlockAllocator::c_maxBlockSize * VoxelBlockAllocator::c_blocksPerSlab;
+	const uint32_t c_freeListCount = 8;		// Threads are spread over the lists to keep contention down
+
+	struct FreeBlock
+	{
+		FreeBlock* m_next;
+	};
+
+	// Each list on its own cache line
+	struct __declspec(align(64)) FreeList
+	{
+		FreeList() : m_head(nullptr) { }
+		Kernel::Mutex m_lock;
+		FreeBlock* m_head;
+	};
+
+	// Huge pages can only be allocated once the process token has the lock pages privilege enabled.
+	// The user must also have been granted it by policy, otherwise the adjust quietly does nothing
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token = nullptr;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		{
+			return false;
+		}
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool enabled = false;
+		if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+		{
+			enabled = AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+		}
+		CloseHandle(token);
+		return enabled;
+	}
+
+	struct Slab
+	{
+		void* m_memory;
+		bool m_hugePages;
+	};
+
+	class VoxelBlockPool
+	{
+	public:
+		VoxelBlockPool()
+			: m_allocations(0)
+			, m_frees(0)
+			, m_hugePageSlabs(0)
+			, m_useHugePages(0)
+			, m_loggedHugePageFallback(0)
+		{
+		}
+
+		~VoxelBlockPool()
+		{
+			for (auto& slab : m_slabs)
+			{
+				if (slab.m_hugePages)
+				{
+					VirtualFree(slab.m_memory, 0, MEM_RELEASE);
+				}
+				else
+				{
+					_aligned_free(slab.m_memory);
+				}
+			}
+		}
+
+		void* Allocate()
+		{
+			// Try our own list first, then steal from the others before making a new slab
+			const uint32_t firstList = ThisThreadList();
+			for (uint32_t l = 0; l < c_freeListCount; ++l)
+			{
+				FreeList& list = m_freeLists[(firstList + l) % c_freeListCount];
+				Kernel::ScopedMutex lock(list.m_lock);
+				if (list.m_head != nullptr)
+				{
+					FreeBlock* block = list.m_head;
+					list.m_head = block->m_next;
+					m_allocations.Add(1);
+					return block;
+				}
+			}
+
+			uint8_t* slabMemory = static_cast<uint8_t*>(AllocateSlab());
+			FreeList& list = m_freeLists[firstList];
+			{
+				Kernel::ScopedMutex lock(list.m_lock);
+				for (uint32_t b = 1; b < VoxelBlockAllocator::c_blocksPerSlab; ++b)
+				{
+					FreeBlock* block = reinterpret_cast<FreeBlock*>(slabMemory + (b * VoxelBlockAllocator::c_maxBlockSize));
+					block->m_next = list.m_head;
+					list.m_head = block;
+				}
+			}
+			m_allocations.Add(1);
+			return slabMemory;
+		}
+
+		void Free(void* memory)
+		{
+			FreeBlock* block = static_cast<FreeBlock*>(memory);
+			FreeList& list = m_freeLists[ThisThreadList()];
+			{
+				Kernel::ScopedMutex lock(list.m_lock);
+				block->m_next = list.m_head;
+				list.m_head = block;
+			}
+			m_frees.Add(1);
+		}
+
+		void UseHugePages(bool enabled)
+		{
+			if (enabled && !EnableLockMemoryPrivilege())
+			{
+				SDE_LOGC(SDE, "Lock pages privilege not available, voxel blocks will use normal pages");
+				enabled = false;
+			}
+			m_useHugePages.Set(enabled ? 1 : 0);
+		}
+
+		VoxelBlockAllocator::Stats GetStats()
+		{
+			VoxelBlockAllocator::Stats stats;
+			stats.m_allocations = (uint32_t)m_allocations.Get();
+			stats.m_frees = (uint32_t)m_frees.Get();
+			stats.m_blocksInUse = stats.m_allocations - stats.m_frees;
+			{
+				Kernel::ScopedMutex lock(m_slabLock);
+				stats.m_slabCount = (uint32_t)m_slabs.size();
+			}
+			stats.m_slabBytes = stats.m_slabCount * c_slabBytes;
+			stats.m_hugePageSlabs = (uint32_t)m_hugePageSlabs.Get();
+			return stats;
+		}
+
+	private:
+		uint32_t ThisThreadList() const
+		{
+			return (uint32_t)(std::hash<std::thread::id>()(std::this_thread::get_id()) % c_freeListCount);
+		}
+
+		void* AllocateSlab()
+		{
+			Slab newSlab = { nullptr, false };
+			if (m_useHugePages.Get() == 1)
+			{
+				const size_t largePageSize = GetLargePageMinimum();
+				if (largePageSize > 0 && (c_slabBytes % largePageSize) == 0)
+				{
+					newSlab.m_memory = VirtualAlloc(nullptr, c_slabBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+					newSlab.m_hugePages = newSlab.m_memory != nullptr;
+				}
+				if (!newSlab.m_hugePages && m_loggedHugePageFallback.CAS(0, 1))
+				{
+					SDE_LOGC(SDE, "Huge page slab allocation failed, falling back to normal pages");
+				}
+			}
+			if (newSlab.m_memory == nullptr)
+			{
+				// Touch every page now, so we take the faults once per slab rather than during every load
+				newSlab.m_memory = _aligned_malloc(c_slabBytes, 64);
+				SDE_ASSERT(newSlab.m_memory != nullptr, "Out of memory");
+				memset(newSlab.m_memory, 0, c_slabBytes);
+			}
+			else
+			{
+				m_hugePageSlabs.Add(1);
+			}
+
+			Kernel::ScopedMutex lock(m_slabLock);
+			m_slabs.push_back(newSlab);
+			return newSlab.m_memory;
+		}
+
+		FreeList m_freeLists[c_freeListCount];
+		Kernel::Mutex m_slabLock;
+		std::vector<Slab> m_slabs;
+		Kernel::AtomicInt32 m_allocations;
+		Kernel::AtomicInt32 m_frees;
+		Kernel::AtomicInt32 m_hugePageSlabs;
+		Kernel::AtomicInt32 m_useHugePages;
+		Kernel::AtomicInt32 m_loggedHugePageFallback;		// Only log the first failed slab
+	};
+
+	VoxelBlockPool& GetPool()
+	{
+		static VoxelBlockPool s_pool;
+		return s_pool;
+	}
+}
+
+void* VoxelBlockAllocator::AllocateBlock(size_t size)
+{
+	SDE_ASSERT(size <= c_maxBlockSize, "Voxel block too big for the pool");
+	return GetPool().Allocate();
+}
+
+void VoxelBlockAllocator::FreeBlock(void* block)
+{
+	if (block != nullptr)
+	{
+		GetPool().Free(block);
+	}
+}
+
+void VoxelBlockAllocator::UseHugePages(bool enabled)
+{
+	GetPool().UseHugePages(enabled);
+}
+
+VoxelBlockAllocator::Stats VoxelBlockAllocator::GetStats()
+{
+	return GetPool().GetStats();
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "kernel/base_types.h"
+
+// Allocates voxel blocks from large slabs. Freed blocks go back on thread-safe free lists and are
+// reused, so reloading a model does not touch the system allocator. Slabs are never returned.
+// Blocks are 64 byte aligned and their contents are undefined
+class VoxelBlockAllocator
+{
+public:
+	static const size_t c_maxBlockSize = 32 * 32 * 32;
+	static const uint32_t c_blocksPerSlab = 64;		// 2mb slabs, matches the usual huge page size
+
+	struct Stats
+	{
+		uint32_t m_allocations;		// Totals since startup
+		uint32_t m_frees;
+		uint32_t m_blocksInUse;
+		uint32_t m_slabCount;
+		size_t m_slabBytes;
+		uint32_t m_hugePageSlabs;
+	};
+
+	static void* AllocateBlock(size_t size);
+	static void FreeBlock(void* block);
+
+	// Back new slabs with huge pages where possible. Enabling tries to acquire the lock pages privilege,
+	// we log and fall back to normal pages if that or a slab allocation fails. Only affects slabs
+	// allocated after the call
+	static void UseHugePages(bool enabled);
+
+	static Stats GetStats();
+};
\ No newline at end of file
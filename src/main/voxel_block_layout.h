@@ -0,0 +1,59 @@
+#pragma once
+
+#include "kernel/base_types.h"
+
+// Voxel orderings for SparseVoxelBlock. Index() maps block-local coordinates to a storage offset.
+// Everything outside the block goes through VoxelAt, so the layout only changes which neighbours share cache lines
+
+// x-major, rows along x are contiguous (the original layout)
+struct VoxelLayoutLinear
+{
+	static const bool c_isLinear = true;
+
+	template<uint32_t Dimensions>
+	static inline uint32_t Index(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return x + (y * Dimensions) + (z * Dimensions * Dimensions);
+	}
+};
+
+// Z-order curve, bits of x/y/z are interleaved. Any aligned 2^n cube is contiguous
+struct VoxelLayoutMorton
+{
+	static const bool c_isLinear = false;
+
+	static inline uint32_t SpreadBits(uint32_t v)
+	{
+		// 10 bits in, 1 bit out every 3
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	template<uint32_t Dimensions>
+	static inline uint32_t Index(uint32_t x, uint32_t y, uint32_t z)
+	{
+		static_assert((Dimensions & (Dimensions - 1)) == 0 && Dimensions <= 1024, "Morton layout needs power of 2 dimensions");
+		return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+	}
+};
+
+// Bricks of BrickSize^3 voxels, each brick is x-major internally and the bricks are x-major in the block
+template<uint32_t BrickSize>
+struct VoxelLayoutBricked
+{
+	static const bool c_isLinear = false;
+
+	template<uint32_t Dimensions>
+	static inline uint32_t Index(uint32_t x, uint32_t y, uint32_t z)
+	{
+		static_assert(Dimensions % BrickSize == 0, "Block must be a whole number of bricks");
+		const uint32_t c_bricksPerAxis = Dimensions / BrickSize;
+		const uint32_t brick = (x / BrickSize) + ((y / BrickSize) * c_bricksPerAxis) + ((z / BrickSize) * c_bricksPerAxis * c_bricksPerAxis);
+		const uint32_t local = (x % BrickSize) + ((y % BrickSize) * BrickSize) + ((z % BrickSize) * BrickSize * BrickSize);
+		return (brick * BrickSize * BrickSize * BrickSize) + local;
+	}
+};
\ No newline at end of file
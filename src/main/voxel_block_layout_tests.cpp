@@ -0,0 +1,112 @@
+#include "voxel_block_layout_tests.h"
+#include "voxel_definitions.h"
+#include "kernel/assert.h"
+#include <algorithm>
+#include <vector>
+
+namespace VoxelBlockLayoutTests
+{
+	uint8_t TestValue(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return (uint8_t)((x * 3) + (y * 5) + (z * 7));
+	}
+
+	// Every voxel must land on its own slot
+	template<class Layout>
+	void IndexTest()
+	{
+		std::vector<bool> used(32 * 32 * 32, false);
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					const uint32_t index = Layout::template Index<32>(x, y, z);
+					SDE_ASSERT(index < used.size());
+					SDE_ASSERT(!used[index]);
+					used[index] = true;
+				}
+			}
+		}
+	}
+
+	template<class Layout>
+	void LinearCopyTest()
+	{
+		typedef SparseVoxelBlock<uint8_t, 32, Layout> BlockType;
+		std::vector<uint8_t> linear(BlockType::c_voxelCount);
+		for (uint32_t v = 0; v < BlockType::c_voxelCount; ++v)
+		{
+			linear[v] = TestValue(v % 32, (v / 32) % 32, v / (32 * 32));
+		}
+
+		BlockType block;
+		block.WriteLinear(linear.data());
+		uint8_t row[32];
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				block.ReadRow(y, z, row);
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					SDE_ASSERT(block.VoxelAt(x, y, z) == TestValue(x, y, z));
+					SDE_ASSERT(row[x] == TestValue(x, y, z));
+				}
+			}
+		}
+
+		std::vector<uint8_t> scratch;
+		const uint8_t* copy = block.LinearVoxels(scratch);
+		SDE_ASSERT(std::equal(linear.begin(), linear.end(), copy));
+	}
+
+	// Packed and cold blocks must come back in the same place whatever the layout
+	template<class Layout>
+	void ModelRoundTripTest()
+	{
+		SparseVoxelModel<uint8_t, 32, VoxelBlockAllocator, Layout> model;
+		model.SetPaletteCompression(true);
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(64.0f, 32.0f, 32.0f)));
+		const glm::ivec3 packedIndex(0, 0, 0), coldIndex(1, 0, 0);
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					model.BlockAt(packedIndex)->VoxelAt(x, y, z) = (x + y > z) ? 2 : 0;
+					model.BlockAt(coldIndex)->VoxelAt(x, y, z) = (y < 4) ? 1 : 0;
+				}
+			}
+		}
+		SDE_ASSERT(model.CompactBlock(packedIndex));
+		SDE_ASSERT(model.CompressBlock(coldIndex));
+		model.FreeRetiredBlocks();
+
+		uint8_t row[32];
+		model.DecodeRow(packedIndex, 3, 7, row);
+		SDE_ASSERT(row[0] == 0 && row[4] == 0 && row[5] == 2);
+		SDE_ASSERT(model.ReadVoxel(packedIndex, 1, 2, 3) == 0 && model.ReadVoxel(packedIndex, 2, 2, 3) == 2);
+		SDE_ASSERT(model.BlockAt(packedIndex)->VoxelAt(20, 10, 29) == 2);
+		SDE_ASSERT(model.BlockAt(coldIndex)->VoxelAt(31, 3, 31) == 1 && model.BlockAt(coldIndex)->VoxelAt(0, 4, 0) == 0);
+		model.RemoveAllBlocks();
+		model.FreeRetiredBlocks();
+	}
+
+	template<class Layout>
+	void LayoutTests()
+	{
+		IndexTest<Layout>();
+		LinearCopyTest<Layout>();
+		ModelRoundTripTest<Layout>();
+	}
+
+	void RunTests()
+	{
+		LayoutTests<VoxelLayoutLinear>();
+		LayoutTests<VoxelLayoutMorton>();
+		LayoutTests<VoxelLayoutBricked<4>>();
+	}
+}
\ No newline at end of file
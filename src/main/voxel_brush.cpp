@@ -0,0 +1,296 @@
+#include "voxel_brush.h"
+#include "procedural_geometry.h"
+#include "kernel/assert.h"
+#include <emmintrin.h>
+#include <algorithm>
+
+static const float c_boundsMargin = 1.0f / 1024.0f;	// Covers rounding in the distance tests, much smaller than a voxel
+
+// 4 x 4 float lane masks to one 16 byte mask
+static inline __m128i PackMasks(__m128 m0, __m128 m1, __m128 m2, __m128 m3)
+{
+	const __m128i lo = _mm_packs_epi32(_mm_castps_si128(m0), _mm_castps_si128(m1));
+	const __m128i hi = _mm_packs_epi32(_mm_castps_si128(m2), _mm_castps_si128(m3));
+	return _mm_packs_epi16(lo, hi);
+}
+
+static inline __m128 Abs(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// Same damage rules as the scalar ApplyVoxel below, on 16 voxels
+static inline __m128i Damage(__m128i voxels, __m128i inside)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i damageBits = _mm_set1_epi8((char)0xc0);
+	const __m128i materialBits = _mm_set1_epi8(0x3f);
+	const __m128i solid = _mm_andnot_si128(_mm_cmpeq_epi8(voxels, zero), inside);
+	const __m128i fullyDamaged = _mm_cmpeq_epi8(_mm_and_si128(voxels, damageBits), damageBits);
+	const __m128i outerWall = _mm_cmpeq_epi8(_mm_and_si128(voxels, materialBits), _mm_set1_epi8((char)Materials::OuterWall));
+	const __m128i increment = _mm_andnot_si128(fullyDamaged, solid);
+	const __m128i remove = _mm_andnot_si128(outerWall, _mm_and_si128(fullyDamaged, solid));
+	const __m128i damaged = _mm_add_epi8(voxels, _mm_and_si128(increment, _mm_set1_epi8(0x40)));
+	return _mm_andnot_si128(remove, damaged);
+}
+
+static inline VoxelData ApplyVoxel(VoxelData voxel, VoxelBrush::Operation op, VoxelData fill)
+{
+	switch (op)
+	{
+	case VoxelBrush::Operation::Union:
+		return fill;
+	case VoxelBrush::Operation::Subtract:
+		return 0;
+	case VoxelBrush::Operation::Damage:
+		if (voxel != static_cast<uint8_t>(Materials::Air))
+		{
+			const uint8_t voxelDamage = GetVoxelDamage(voxel);
+			if (voxelDamage < 3)
+			{
+				return PackVoxel(GetVoxelMaterial(voxel), voxelDamage + 1);
+			}
+			else if (GetVoxelMaterial(voxel) != Materials::OuterWall)
+			{
+				return 0;
+			}
+		}
+		return voxel;
+	}
+	return voxel;
+}
+
+VoxelBrush VoxelBrush::MakeSphere(const glm::vec3& center, float radius, Operation op, VoxelData fill)
+{
+	VoxelBrush brush;
+	brush.m_shape = Shape::Sphere;
+	brush.m_operation = op;
+	brush.m_a = center;
+	brush.m_b = center;
+	brush.m_radius = radius;
+	brush.m_fill = fill;
+	return brush;
+}
+
+VoxelBrush VoxelBrush::MakeBox(const glm::vec3& boxMin, const glm::vec3& boxMax, Operation op, VoxelData fill)
+{
+	VoxelBrush brush;
+	brush.m_shape = Shape::Box;
+	brush.m_operation = op;
+	brush.m_a = boxMin;
+	brush.m_b = boxMax;
+	brush.m_radius = 0.0f;
+	brush.m_fill = fill;
+	return brush;
+}
+
+VoxelBrush VoxelBrush::MakeCapsule(const glm::vec3& a, const glm::vec3& b, float radius, Operation op, VoxelData fill)
+{
+	VoxelBrush brush;
+	brush.m_shape = Shape::Capsule;
+	brush.m_operation = op;
+	brush.m_a = a;
+	brush.m_b = b;
+	brush.m_radius = radius;
+	brush.m_fill = fill;
+	return brush;
+}
+
+Math::Box3 VoxelBrush::Bounds() const
+{
+	const glm::vec3 margin(m_radius + c_boundsMargin);
+	return Math::Box3(glm::min(m_a, m_b) - margin, glm::max(m_a, m_b) + margin);
+}
+
+bool VoxelBrush::TouchesRow(float y, float z) const
+{
+	// The sphere and box tests only ever add the x term to these, so they are exact
+	switch (m_shape)
+	{
+	case Shape::Sphere:
+	{
+		const float dy = m_a.y - y, dz = m_a.z - z;
+		return sqrtf((dy * dy) + (dz * dz)) <= m_radius;
+	}
+	case Shape::Box:
+	{
+		const float dy = std::max(fabsf(((m_b.y + m_a.y) * 0.5f) - y) - ((m_b.y - m_a.y) * 0.5f), 0.0f);
+		const float dz = std::max(fabsf(((m_b.z + m_a.z) * 0.5f) - z) - ((m_b.z - m_a.z) * 0.5f), 0.0f);
+		return ((dy * dy) + (dz * dz)) <= 0.0f;
+	}
+	default:
+	{
+		const Math::Box3 bounds = Bounds();
+		return y >= bounds.Min().y && y <= bounds.Max().y && z >= bounds.Min().z && z <= bounds.Max().z;
+	}
+	}
+}
+
+void VoxelBrush::ApplyToRowScalar(VoxelData* row, const float* xPositions, uint32_t count, float y, float z) const
+{
+	for (uint32_t x = 0; x < count; ++x)
+	{
+		const glm::vec3 vPos(xPositions[x], y, z);
+		bool inside = false;
+		switch (m_shape)
+		{
+		case Shape::Sphere:
+			inside = Sphere(vPos, m_a, m_radius) >= 0.0f;
+			break;
+		case Shape::Box:
+			inside = Box(vPos, m_a, m_b) <= 0.0f;
+			break;
+		case Shape::Capsule:
+			inside = Capsule(vPos, m_a, m_b, m_radius) >= 0.0f;
+			break;
+		}
+		if (inside)
+		{
+			row[x] = ApplyVoxel(row[x], m_operation, m_fill);
+		}
+	}
+}
+
+void VoxelBrush::ApplyToRow(VoxelData* row, const float* xPositions, uint32_t count, float y, float z) const
+{
+	static_assert(sizeof(VoxelData) == 1, "Row kernels assume byte voxels");
+	SDE_ASSERT((count & 15) == 0, "Rows must be padded");
+
+	// Everything that does not depend on x. The lane math below matches the scalar sdf functions op for op,
+	// so both versions pick exactly the same voxels
+	const __m128 radius = _mm_set1_ps(m_radius);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 centerX = zero, halfSizeX = zero, yTerm = zero, zTerm = zero;
+	__m128 dirX = zero, dirY = zero, dirZ = zero, paY = zero, paZ = zero, lengthSq = zero, lengthSqValid = zero;
+	const glm::vec3 ba = m_b - m_a;
+	switch (m_shape)
+	{
+	case Shape::Sphere:
+		centerX = _mm_set1_ps(m_a.x);
+		yTerm = _mm_set1_ps((m_a.y - y) * (m_a.y - y));
+		zTerm = _mm_set1_ps((m_a.z - z) * (m_a.z - z));
+		break;
+	case Shape::Box:
+	{
+		const glm::vec3 bpos = (m_b + m_a) * 0.5f;
+		const glm::vec3 halfSize = (m_b - m_a) * 0.5f;
+		const float dy = std::max(fabsf(bpos.y - y) - halfSize.y, 0.0f);
+		const float dz = std::max(fabsf(bpos.z - z) - halfSize.z, 0.0f);
+		centerX = _mm_set1_ps(bpos.x);
+		halfSizeX = _mm_set1_ps(halfSize.x);
+		yTerm = _mm_set1_ps(dy * dy);
+		zTerm = _mm_set1_ps(dz * dz);
+		break;
+	}
+	case Shape::Capsule:
+	{
+		const float baLengthSq = glm::dot(ba, ba);
+		centerX = _mm_set1_ps(m_a.x);
+		dirX = _mm_set1_ps(ba.x);
+		dirY = _mm_set1_ps(ba.y);
+		dirZ = _mm_set1_ps(ba.z);
+		paY = _mm_set1_ps(y - m_a.y);
+		paZ = _mm_set1_ps(z - m_a.z);
+		lengthSq = _mm_set1_ps(baLengthSq > 0.0f ? baLengthSq : 1.0f);
+		lengthSqValid = baLengthSq > 0.0f ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+		break;
+	}
+	}
+
+	auto insideMask = [&](const float* x) -> __m128
+	{
+		const __m128 px = _mm_loadu_ps(x);
+		switch (m_shape)
+		{
+		case Shape::Sphere:
+		{
+			const __m128 dx = _mm_sub_ps(centerX, px);
+			const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), yTerm), zTerm);
+			return _mm_cmple_ps(_mm_sqrt_ps(distSq), radius);
+		}
+		case Shape::Box:
+		{
+			const __m128 dx = _mm_max_ps(_mm_sub_ps(Abs(_mm_sub_ps(centerX, px)), halfSizeX), zero);
+			const __m128 outsideSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), yTerm), zTerm);
+			return _mm_cmple_ps(outsideSq, zero);
+		}
+		default:
+		{
+			const __m128 paX = _mm_sub_ps(px, centerX);
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(paX, dirX), _mm_mul_ps(paY, dirY)), _mm_mul_ps(paZ, dirZ));
+			const __m128 t = _mm_min_ps(_mm_max_ps(_mm_div_ps(dot, lengthSq), zero), _mm_set1_ps(1.0f));
+			const __m128 h = _mm_and_ps(t, lengthSqValid);
+			const __m128 qx = _mm_sub_ps(paX, _mm_mul_ps(dirX, h));
+			const __m128 qy = _mm_sub_ps(paY, _mm_mul_ps(dirY, h));
+			const __m128 qz = _mm_sub_ps(paZ, _mm_mul_ps(dirZ, h));
+			const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)), _mm_mul_ps(qz, qz));
+			return _mm_cmple_ps(_mm_sqrt_ps(distSq), radius);
+		}
+		}
+	};
+
+	const __m128i fill = _mm_set1_epi8((char)m_fill);
+	for (uint32_t x = 0; x < count; x += 16)
+	{
+		const __m128i inside = PackMasks(insideMask(xPositions + x), insideMask(xPositions + x + 4), insideMask(xPositions + x + 8), insideMask(xPositions + x + 12));
+		if (_mm_movemask_epi8(inside) == 0)
+		{
+			continue;
+		}
+		__m128i* rowPtr = reinterpret_cast<__m128i*>(row + x);
+		const __m128i voxels = _mm_loadu_si128(rowPtr);
+		__m128i result;
+		switch (m_operation)
+		{
+		case Operation::Union:
+			result = _mm_or_si128(_mm_and_si128(inside, fill), _mm_andnot_si128(inside, voxels));
+			break;
+		case Operation::Subtract:
+			result = _mm_andnot_si128(inside, voxels);
+			break;
+		default:
+			result = Damage(voxels, inside);
+			break;
+		}
+		_mm_storeu_si128(rowPtr, result);
+	}
+}
+
+JobScratchPool<VoxelBrushList::RowScratch>& VoxelBrushList::RowScratchPool()
+{
+	// Created on first use, one scratch ends up per thread that brushes at the same time
+	struct RowScratchPool : public JobScratchPool<RowScratch>
+	{
+		RowScratchPool()
+		{
+			Create([]()
+			{
+				return std::make_unique<RowScratch>();
+			});
+		}
+	};
+	static RowScratchPool s_pool;
+	return s_pool;
+}
+
+void VoxelBrushList::Add(const VoxelBrush& brush)
+{
+	m_brushes.push_back(brush);
+}
+
+void VoxelBrushList::Clear()
+{
+	m_brushes.clear();
+}
+
+Math::Box3 VoxelBrushList::Bounds() const
+{
+	SDE_ASSERT(!m_brushes.empty());
+	Math::Box3 bounds = m_brushes[0].Bounds();
+	for (const auto& brush : m_brushes)
+	{
+		const Math::Box3 brushBounds = brush.Bounds();
+		bounds = Math::Box3(glm::min(bounds.Min(), brushBounds.Min()), glm::max(bounds.Max(), brushBounds.Max()));
+	}
+	return bounds;
+}
\ No newline at end of file
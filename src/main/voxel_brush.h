@@ -0,0 +1,73 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include "math/box3.h"
+#include "job_scratch_pool.h"
+#include <vector>
+
+// A shape and what it does to the voxels inside it
+struct VoxelBrush
+{
+	enum class Shape : uint8_t
+	{
+		Sphere,		// m_a = center
+		Box,		// m_a = min, m_b = max
+		Capsule,	// m_a to m_b
+	};
+	enum class Operation : uint8_t
+	{
+		Union,		// Inside voxels are set to m_fill
+		Subtract,	// Inside voxels are cleared
+		Damage,		// Inside voxels take one point of damage, fully damaged ones are removed (except the outer wall)
+	};
+
+	static VoxelBrush MakeSphere(const glm::vec3& center, float radius, Operation op, VoxelData fill = 0);
+	static VoxelBrush MakeBox(const glm::vec3& boxMin, const glm::vec3& boxMax, Operation op, VoxelData fill = 0);
+	static VoxelBrush MakeCapsule(const glm::vec3& a, const glm::vec3& b, float radius, Operation op, VoxelData fill = 0);
+
+	Math::Box3 Bounds() const;
+	bool TouchesRow(float y, float z) const;	// Conservative, false means no voxel in the row is inside
+
+	// Applies the brush to a row of voxels along x. xPositions are the voxel centers
+	// The simd version works on 16 voxels at a time, both arrays must be padded to PaddedRowLength(count)
+	void ApplyToRow(VoxelData* row, const float* xPositions, uint32_t count, float y, float z) const;
+	void ApplyToRowScalar(VoxelData* row, const float* xPositions, uint32_t count, float y, float z) const;
+	static inline uint32_t PaddedRowLength(uint32_t count) { return (count + 15) & ~15; }
+
+	Shape m_shape;
+	Operation m_operation;
+	glm::vec3 m_a;
+	glm::vec3 m_b;
+	float m_radius;
+	VoxelData m_fill;
+};
+
+// Brushes applied in order, a CSG list. Can be passed to Floor::ModifyData / ModelAreaDataWriter as the area callback.
+// Rows are copied out of the area, edited 16 voxels at a time, and only changed voxels are written back
+class VoxelBrushList
+{
+public:
+	void Add(const VoxelBrush& brush);
+	void Clear();
+	inline bool IsEmpty() const { return m_brushes.empty(); }
+	inline const std::vector<VoxelBrush>& Brushes() const { return m_brushes; }
+	Math::Box3 Bounds() const;
+
+	template<class AreaParams>
+	void operator()(AreaParams& areaParams) const;
+
+	// Row buffers used by operator(), borrowed from one shared pool so brushing an area doesn't allocate
+	struct RowScratch
+	{
+		std::vector<float> m_xPositions;
+		std::vector<VoxelData> m_row;
+		std::vector<VoxelData> m_originalRow;
+		std::vector<const VoxelBrush*> m_rowBrushes;
+	};
+	static JobScratchPool<RowScratch>& RowScratchPool();
+
+private:
+	std::vector<VoxelBrush> m_brushes;
+};
+
+#include "voxel_brush.inl"
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cfloat>
+
+template<class AreaParams>
+void VoxelBrushList::operator()(AreaParams& areaParams) const
+{
+	const glm::ivec3 startVoxel = areaParams.StartVoxel();
+	const glm::ivec3 endVoxel = areaParams.EndVoxel();
+	const uint32_t width = (uint32_t)(endVoxel.x - startVoxel.x);
+	if (m_brushes.empty() || width == 0)
+	{
+		return;
+	}
+
+	// Voxel x positions are the same for every row. Extra room at the end for the kernel padding
+	auto scratch = RowScratchPool().Borrow();
+	std::vector<float>& xPositions = scratch->m_xPositions;
+	xPositions.resize(width + 16);
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		xPositions[x] = areaParams.VoxelPosition(startVoxel.x + x, startVoxel.y, startVoxel.z).x;
+	}
+	std::fill(xPositions.begin() + width, xPositions.end(), xPositions[width - 1]);
+
+	std::vector<VoxelData>& row = scratch->m_row;
+	std::vector<VoxelData>& originalRow = scratch->m_originalRow;
+	std::vector<const VoxelBrush*>& rowBrushes = scratch->m_rowBrushes;
+	row.resize(width + 16);
+	originalRow.resize(width);
+	rowBrushes.reserve(m_brushes.size());
+	for (int32_t vz = startVoxel.z; vz != endVoxel.z; ++vz)
+	{
+		for (int32_t vy = startVoxel.y; vy != endVoxel.y; ++vy)
+		{
+			// Areas can be much bigger than the brushes (edits are merged), only touch the part of the row they cover
+			const glm::vec3 rowPos = areaParams.VoxelPosition(startVoxel.x, vy, vz);
+			float spanMin = FLT_MAX, spanMax = -FLT_MAX;
+			rowBrushes.clear();
+			for (const auto& brush : m_brushes)
+			{
+				if (brush.TouchesRow(rowPos.y, rowPos.z))
+				{
+					const Math::Box3 bounds = brush.Bounds();
+					spanMin = std::min(spanMin, bounds.Min().x);
+					spanMax = std::max(spanMax, bounds.Max().x);
+					rowBrushes.push_back(&brush);
+				}
+			}
+			if (rowBrushes.empty())
+			{
+				continue;
+			}
+			const uint32_t first = (uint32_t)(std::lower_bound(xPositions.begin(), xPositions.begin() + width, spanMin) - xPositions.begin());
+			const uint32_t last = (uint32_t)(std::upper_bound(xPositions.begin(), xPositions.begin() + width, spanMax) - xPositions.begin());
+			if (first >= last)
+			{
+				continue;
+			}
+
+			const uint32_t count = last - first;
+			for (uint32_t x = 0; x < count; ++x)
+			{
+				row[x] = areaParams.VoxelAt(startVoxel.x + first + x, vy, vz);
+				originalRow[x] = row[x];
+			}
+			for (const auto brush : rowBrushes)
+			{
+				brush->ApplyToRow(row.data(), xPositions.data() + first, VoxelBrush::PaddedRowLength(count), rowPos.y, rowPos.z);
+			}
+			for (uint32_t x = 0; x < count; ++x)
+			{
+				if (row[x] != originalRow[x])
+				{
+					areaParams.VoxelAt(startVoxel.x + first + x, vy, vz) = row[x];
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
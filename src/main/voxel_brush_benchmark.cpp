@@ -0,0 +1,173 @@
+#include "voxel_brush_benchmark.h"
+#include "voxel_definitions.h"
+#include "voxel_brush.h"
+#include "vox_model_loader.h"
+#include "test_random.h"
+#include "vox/model_area_data_writer.h"
+#include "core/timer.h"
+#include "kernel/assert.h"
+#include <memory>
+#include <vector>
+
+namespace VoxelBrushBenchmark
+{
+	const uint32_t c_shotCount = 1024;
+	const uint32_t c_pelletsPerShot = 16;
+	const float c_spreadSize = 1.0f;		// Pellets of a shot land in a cube this size
+
+	// The shot edit as it was before the brushes, one call per pellet
+	struct ScalarShotTest
+	{
+		glm::vec3 m_center;
+		float m_radius;
+		void operator()(Vox::ModelAreaDataWriterParams<VoxelModel>& areaParams)
+		{
+			for (int32_t vz = areaParams.StartVoxel().z; vz != areaParams.EndVoxel().z; ++vz)
+			{
+				for (int32_t vy = areaParams.StartVoxel().y; vy != areaParams.EndVoxel().y; ++vy)
+				{
+					const glm::vec3 rowPos = areaParams.VoxelPosition(areaParams.StartVoxel().x, vy, vz);
+					const float rowDistanceSq = ((rowPos.y - m_center.y) * (rowPos.y - m_center.y)) + ((rowPos.z - m_center.z) * (rowPos.z - m_center.z));
+					if (rowDistanceSq > m_radius * m_radius)
+					{
+						continue;
+					}
+					for (int32_t vx = areaParams.StartVoxel().x; vx != areaParams.EndVoxel().x; ++vx)
+					{
+						const glm::vec3 vPos = areaParams.VoxelPosition(vx, vy, vz);
+						if (glm::distance(vPos, m_center) <= m_radius)
+						{
+							auto& voxel = areaParams.VoxelAt(vx, vy, vz);
+							if (voxel != static_cast<uint8_t>(Materials::Air))
+							{
+								uint8_t voxelDamage = GetVoxelDamage(voxel);
+								if (voxelDamage < 3)
+								{
+									voxelDamage++;
+									voxel = PackVoxel(GetVoxelMaterial(voxel), voxelDamage);
+								}
+								else if (GetVoxelMaterial(voxel) != Materials::OuterWall)
+								{
+									voxel = 0;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	};
+
+	struct Shot
+	{
+		std::vector<glm::vec3> m_pellets;
+		float m_radius;
+	};
+
+	double ElapsedMs(Core::Timer& timer, uint64_t startTicks)
+	{
+		return (double)(timer.GetTicks() - startTicks) * 1000.0 / (double)timer.GetFrequency();
+	}
+
+	bool LoadModel(VoxelModel& model, const char* modelPath)
+	{
+		VoxelModelLoader<VoxelModel> loader;
+		return loader.LoadFromFile(model, modelPath, [](glm::ivec3) {});
+	}
+
+	uint64_t CountDifferences(VoxelModel& m0, VoxelModel& m1)
+	{
+		const uint32_t dims = VoxelModel::BlockType::VoxelDimensions;
+		glm::ivec3 startBlock, endBlock;
+		m0.GetBlockIterationParameters(m0.GetTotalBounds(), startBlock, endBlock);
+		uint64_t differences = 0;
+		for (int32_t bz = startBlock.z; bz <= endBlock.z; ++bz)
+		{
+			for (int32_t by = startBlock.y; by <= endBlock.y; ++by)
+			{
+				for (int32_t bx = startBlock.x; bx <= endBlock.x; ++bx)
+				{
+					const glm::ivec3 blockIndex(bx, by, bz);
+					const VoxelModel::BlockType* b0 = m0.BlockAt(blockIndex);
+					const VoxelModel::BlockType* b1 = m1.BlockAt(blockIndex);
+					if (b0 == nullptr || b1 == nullptr)
+					{
+						differences += (b0 != b1) ? 1 : 0;
+						continue;
+					}
+					for (uint32_t z = 0; z < dims; ++z)
+					{
+						for (uint32_t y = 0; y < dims; ++y)
+						{
+							for (uint32_t x = 0; x < dims; ++x)
+							{
+								differences += (b0->VoxelAt(x, y, z) != b1->VoxelAt(x, y, z)) ? 1 : 0;
+							}
+						}
+					}
+				}
+			}
+		}
+		return differences;
+	}
+
+	void Run(const char* modelPath)
+	{
+		auto scalarModel = std::make_unique<VoxelModel>();
+		auto brushModel = std::make_unique<VoxelModel>();
+		if (!LoadModel(*scalarModel, modelPath) || !LoadModel(*brushModel, modelPath))
+		{
+			SDE_LOG("Brush benchmark failed to load %s", modelPath);
+			return;
+		}
+
+		// Shots are spread across the whole model, each a cluster of pellets like a shotgun blast
+		const Math::Box3& bounds = scalarModel->GetTotalBounds();
+		TestRandom random(0x7f4a7c15);
+		std::vector<Shot> shots(c_shotCount);
+		for (auto& shot : shots)
+		{
+			const glm::vec3 center = random.NextPoint(bounds.Min(), bounds.Max());
+			shot.m_radius = 0.05f + (0.2f * random.Next());
+			for (uint32_t p = 0; p < c_pelletsPerShot; ++p)
+			{
+				shot.m_pellets.push_back(center + random.NextPoint(glm::vec3(-0.5f * c_spreadSize), glm::vec3(0.5f * c_spreadSize)));
+			}
+		}
+
+		Core::Timer timer;
+		Vox::ModelAreaDataWriter<VoxelModel> scalarWriter(*scalarModel);
+		uint64_t startTicks = timer.GetTicks();
+		for (const auto& shot : shots)
+		{
+			for (const auto& pellet : shot.m_pellets)
+			{
+				ScalarShotTest edit;
+				edit.m_center = pellet;
+				edit.m_radius = shot.m_radius;
+				scalarWriter.WriteArea(Math::Box3(pellet - shot.m_radius, pellet + shot.m_radius), edit);
+			}
+		}
+		const double scalarMs = ElapsedMs(timer, startTicks);
+
+		// One brush list per shot, as ShotPipeline does
+		Vox::ModelAreaDataWriter<VoxelModel> brushWriter(*brushModel);
+		startTicks = timer.GetTicks();
+		for (const auto& shot : shots)
+		{
+			VoxelBrushList edit;
+			for (const auto& pellet : shot.m_pellets)
+			{
+				edit.Add(VoxelBrush::MakeSphere(pellet, shot.m_radius, VoxelBrush::Operation::Damage));
+			}
+			brushWriter.WriteArea(edit.Bounds(), edit);
+		}
+		const double brushMs = ElapsedMs(timer, startTicks);
+
+		const uint64_t differences = CountDifferences(*scalarModel, *brushModel);
+		SDE_LOG("Brushes: %u shots x %u pellets, scalar ShotTest %.1fms, VoxelBrushList %.1fms, %llu voxels differ (expect 0)",
+			c_shotCount, c_pelletsPerShot, scalarMs, brushMs, (unsigned long long)differences);
+		scalarModel->RemoveAllBlocks();
+		brushModel->RemoveAllBlocks();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace VoxelBrushBenchmark
+{
+	// Loads the model twice and applies the same shots to each, once with the old scalar ShotTest edit
+	// and once with VoxelBrushList. Logs the timings and checks both models end up identical
+	void Run(const char* modelPath);
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "voxel_brush_tests.h"
+#include "voxel_brush.h"
+#include "test_random.h"
+#include "kernel/assert.h"
+#include <algorithm>
+#include <vector>
+
+namespace VoxelBrushTests
+{
+	// Plenty of air and fully damaged voxels, those are the interesting cases
+	VoxelData RandomVoxel(TestRandom& random)
+	{
+		const uint32_t material = random.NextInt() % 7;
+		return material > (uint32_t)Materials::OuterWall ? 0 : PackVoxel((Materials)material, (uint8_t)(random.NextInt() % 4));
+	}
+
+	VoxelBrush RandomBrush(TestRandom& random, uint32_t index)
+	{
+		const auto op = (VoxelBrush::Operation)(index % 3);
+		const VoxelData fill = PackVoxel(Materials::Walls, 1);
+		const glm::vec3 p0 = random.NextPoint(glm::vec3(0.0f), glm::vec3(4.0f));
+		const glm::vec3 p1 = random.NextPoint(glm::vec3(0.0f), glm::vec3(4.0f));
+		const float radius = 0.1f + random.Next() * 1.5f;
+		switch ((index / 3) % 4)
+		{
+		case 0:
+			return VoxelBrush::MakeSphere(p0, radius, op, fill);
+		case 1:
+			return VoxelBrush::MakeBox(glm::min(p0, p1), glm::max(p0, p1), op, fill);
+		case 2:
+			return VoxelBrush::MakeCapsule(p0, p1, radius, op, fill);
+		default:
+			return VoxelBrush::MakeCapsule(p0, p0, radius, op, fill);	// Degenerate, a sphere
+		}
+	}
+
+	// The simd kernels must pick exactly the same voxels as the scalar sdf tests
+	void RowKernelTest()
+	{
+		TestRandom random(0x2545f491);
+		std::vector<float> xPositions(64 + 16);
+		std::vector<VoxelData> original(64 + 16), expected(64 + 16), actual(64 + 16);
+		for (uint32_t test = 0; test < 3000; ++test)
+		{
+			const VoxelBrush brush = RandomBrush(random, test);
+			const uint32_t count = 1 + (random.NextInt() % 64);
+			const float y = 0.0625f + (0.125f * (random.NextInt() % 32));
+			const float z = 0.0625f + (0.125f * (random.NextInt() % 32));
+			for (uint32_t x = 0; x < xPositions.size(); ++x)
+			{
+				xPositions[x] = 0.0625f + (0.125f * x);
+				original[x] = RandomVoxel(random);
+				expected[x] = original[x];
+				actual[x] = original[x];
+			}
+			brush.ApplyToRowScalar(expected.data(), xPositions.data(), count, y, z);
+			brush.ApplyToRow(actual.data(), xPositions.data(), VoxelBrush::PaddedRowLength(count), y, z);
+			for (uint32_t x = 0; x < count; ++x)
+			{
+				SDE_ASSERT(actual[x] == expected[x]);
+			}
+			SDE_ASSERT(brush.TouchesRow(y, z) || std::equal(original.begin(), original.begin() + count, expected.begin()));
+		}
+	}
+
+	void DamageRulesTest()
+	{
+		const float xPositions[16] = { 0.0f };
+		VoxelData row[16] = {
+			0, PackVoxel(Materials::Walls, 0), PackVoxel(Materials::Walls, 2), PackVoxel(Materials::Walls, 3),
+			PackVoxel(Materials::OuterWall, 3), PackVoxel(Materials::Pillars, 1)
+		};
+		VoxelBrush::MakeSphere(glm::vec3(0.0f), 1.0f, VoxelBrush::Operation::Damage).ApplyToRow(row, xPositions, 16, 0.0f, 0.0f);
+		SDE_ASSERT(row[0] == 0);
+		SDE_ASSERT(row[1] == PackVoxel(Materials::Walls, 1));
+		SDE_ASSERT(row[2] == PackVoxel(Materials::Walls, 3));
+		SDE_ASSERT(row[3] == 0);
+		SDE_ASSERT(row[4] == PackVoxel(Materials::OuterWall, 3));
+		SDE_ASSERT(row[5] == PackVoxel(Materials::Pillars, 2));
+	}
+
+	// Stands in for ModelAreaDataWriterParams over a small dense grid of 0.125 voxels
+	struct TestArea
+	{
+		static const int32_t c_size = 40;
+		glm::ivec3 m_start, m_end;
+		std::vector<VoxelData> m_voxels = std::vector<VoxelData>(c_size * c_size * c_size);
+		const glm::ivec3& StartVoxel() const { return m_start; }
+		const glm::ivec3& EndVoxel() const { return m_end; }
+		glm::vec3 VoxelPosition(int32_t x, int32_t y, int32_t z) const { return (glm::vec3(x, y, z) + 0.5f) * 0.125f; }
+		VoxelData& VoxelAt(int32_t x, int32_t y, int32_t z) { return m_voxels[x + (y * c_size) + (z * c_size * c_size)]; }
+	};
+
+	void BrushListTest()
+	{
+		TestRandom random(0x2545f491);
+		for (uint32_t test = 0; test < 20; ++test)
+		{
+			VoxelBrushList brushes;
+			const uint32_t brushCount = 1 + (random.NextInt() % 6);
+			for (uint32_t b = 0; b < brushCount; ++b)
+			{
+				brushes.Add(RandomBrush(random, random.NextInt()));
+			}
+
+			TestArea area;
+			area.m_start = glm::ivec3(random.NextInt() % 8, random.NextInt() % 8, random.NextInt() % 8);
+			area.m_end = area.m_start + glm::ivec3(1 + random.NextInt() % 32, 1 + random.NextInt() % 32, 1 + random.NextInt() % 32);
+			for (auto& v : area.m_voxels)
+			{
+				v = RandomVoxel(random);
+			}
+			TestArea expected = area;
+			for (int32_t z = area.m_start.z; z < area.m_end.z; ++z)
+			{
+				for (int32_t y = area.m_start.y; y < area.m_end.y; ++y)
+				{
+					for (int32_t x = area.m_start.x; x < area.m_end.x; ++x)
+					{
+						const glm::vec3 pos = expected.VoxelPosition(x, y, z);
+						for (const auto& brush : brushes.Brushes())
+						{
+							brush.ApplyToRowScalar(&expected.VoxelAt(x, y, z), &pos.x, 1, pos.y, pos.z);
+						}
+					}
+				}
+			}
+			brushes(area);
+			SDE_ASSERT(area.m_voxels == expected.m_voxels);
+		}
+	}
+
+	void RunTests()
+	{
+		RowKernelTest();
+		DamageRulesTest();
+		BrushListTest();
+	}
+}
\ No newline at end of file
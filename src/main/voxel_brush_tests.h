@@ -0,0 +1,6 @@
+#pragma once
+
+namespace VoxelBrushTests
+{
+	void RunTests();
+}
\ No newline at end of file
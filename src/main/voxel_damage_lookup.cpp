@@ -0,0 +1,35 @@
+#include "voxel_damage_lookup.h"
+#include "kernel/assert.h"
+
+void VoxelDamageLookup::Build(const VoxelData* voxels)
+{
+	const uint32_t voxelCount = c_dimensions * c_dimensions * c_dimensions;
+	m_data.clear();
+	uint32_t firstDamaged = 0;
+	while (firstDamaged < voxelCount && GetVoxelDamage(voxels[firstDamaged]) == 0)
+	{
+		++firstDamaged;
+	}
+	if (firstDamaged == voxelCount)
+	{
+		return;
+	}
+
+	// Keeps its capacity, the mesh results are recycled
+	m_data.resize(c_totalBytes, 0);
+	for (uint32_t v = firstDamaged; v < voxelCount; ++v)
+	{
+		m_data[v / 4] |= GetVoxelDamage(voxels[v]) << ((v % 4) * 2);
+	}
+}
+
+uint8_t VoxelDamageLookup::DamageAt(uint32_t x, uint32_t y, uint32_t z) const
+{
+	SDE_ASSERT(x < c_dimensions && y < c_dimensions && z < c_dimensions);
+	if (m_data.empty())
+	{
+		return 0;
+	}
+	const uint32_t v = x + (y * c_dimensions) + (z * c_dimensions * c_dimensions);
+	return (m_data[v / 4] >> ((v % 4) * 2)) & 3;
+}
\ No newline at end of file
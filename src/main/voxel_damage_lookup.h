@@ -0,0 +1,29 @@
+#pragma once
+
+#include "voxel_definitions.h"
+#include <vector>
+
+// Damage levels for one block (chunk), 2 bits per voxel, so meshes can merge quads by material alone.
+// Built on the cpu by the remesh jobs and uploaded as a 2D array texture (one layer per z, 2 x 32 RGBA8 texels),
+// read by voxel_floor_fragment.txt. Each row of 32 voxels is 8 bytes, voxel x is in byte x / 4, bits (x % 4) * 2.
+// Blocks without any damage have no data at all
+class VoxelDamageLookup
+{
+public:
+	static const uint32_t c_dimensions = VoxelModel::BlockType::VoxelDimensions;
+	static const uint32_t c_bytesPerRow = c_dimensions / 4;
+	static const uint32_t c_bytesPerLayer = c_bytesPerRow * c_dimensions;
+	static const uint32_t c_totalBytes = c_bytesPerLayer * c_dimensions;
+
+	// voxels is the whole block, x-major
+	void Build(const VoxelData* voxels);
+	inline void Clear() { m_data.clear(); }
+	inline void Release() { std::vector<uint8_t>().swap(m_data); }
+	inline size_t CapacityBytes() const { return m_data.capacity(); }
+	inline bool IsEmpty() const { return m_data.empty(); }
+	uint8_t DamageAt(uint32_t x, uint32_t y, uint32_t z) const;
+	inline const std::vector<uint8_t>& Data() const { return m_data; }
+
+private:
+	std::vector<uint8_t> m_data;
+};
\ No newline at end of file
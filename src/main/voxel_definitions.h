@@ -1,25 +1,12 @@
 #pragma once
 
 #include "kernel/base_types.h"
-#include "vox/model.h"
-
-class VoxelBlockAllocator
-{
-public:
-	static void* AllocateBlock(size_t size)
-	{
-		void* ptr = malloc(size);
-		memset(ptr, 0, size);
-		return ptr;
-	}
-	static void FreeBlock(void* block)
-	{
-		free(block);
-	}
-};
+#include "sparse_voxel_model.h"
+#include "voxel_block_allocator.h"
 
 typedef uint8_t VoxelData;
-typedef Vox::Model<VoxelData, 32, VoxelBlockAllocator> VoxelModel;
+typedef VoxelLayoutLinear VoxelBlockLayout;	// See VoxelLayoutBenchmark before changing this
+typedef SparseVoxelModel<VoxelData, 32, VoxelBlockAllocator, VoxelBlockLayout> VoxelModel;
 
 // Base materials
 enum class Materials : uint8_t
@@ -0,0 +1,171 @@
+#include "voxel_layout_benchmark.h"
+#include "voxel_definitions.h"
+#include "vox_model_loader.h"
+#include "voxel_raymarcher.h"
+#include "test_random.h"
+#include "vox/greedy_quad_extractor.h"
+#include "vox/model_area_data_writer.h"
+#include "vox/model_ray_marcher.h"
+#include "core/timer.h"
+#include "kernel/assert.h"
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace VoxelLayoutBenchmark
+{
+	const uint32_t c_rayCount = 4096;
+	const uint32_t c_brushCount = 512;
+	const float c_brushRadius = 0.25f;
+
+	// Fixed seed, every layout sees the same rays and brushes
+	template<class ModelType>
+	struct RayCounter
+	{
+		uint64_t m_steps = 0;
+		uint32_t m_hits = 0;
+		template<class Params>
+		bool operator()(const Params& params)
+		{
+			++m_steps;
+			if (params.VoxelData() != 0)
+			{
+				++m_hits;
+				return false;
+			}
+			return true;
+		}
+	};
+
+	// Same work as the shots in the app, damages voxels in a sphere
+	template<class ModelType>
+	struct SphereBrush
+	{
+		glm::vec3 m_center;
+		float m_radius;
+		void operator()(Vox::ModelAreaDataWriterParams<ModelType>& areaParams)
+		{
+			for (int32_t vz = areaParams.StartVoxel().z; vz != areaParams.EndVoxel().z; ++vz)
+			{
+				for (int32_t vy = areaParams.StartVoxel().y; vy != areaParams.EndVoxel().y; ++vy)
+				{
+					for (int32_t vx = areaParams.StartVoxel().x; vx != areaParams.EndVoxel().x; ++vx)
+					{
+						if (glm::distance(areaParams.VoxelPosition(vx, vy, vz), m_center) <= m_radius)
+						{
+							auto& voxel = areaParams.VoxelAt(vx, vy, vz);
+							if (voxel != static_cast<uint8_t>(Materials::Air))
+							{
+								const uint8_t damage = GetVoxelDamage(voxel);
+								voxel = damage < 3 ? PackVoxel(GetVoxelMaterial(voxel), damage + 1) : 0;
+							}
+						}
+					}
+				}
+			}
+		}
+	};
+
+	double ElapsedMs(Core::Timer& timer, uint64_t startTicks)
+	{
+		return (double)(timer.GetTicks() - startTicks) * 1000.0 / (double)timer.GetFrequency();
+	}
+
+	template<class Layout>
+	void RunLayout(const char* modelPath, const char* layoutName)
+	{
+		// Palette compression is left off, so every block stays expanded and all reads go through the layout
+		typedef SparseVoxelModel<VoxelData, 32, VoxelBlockAllocator, Layout> ModelType;
+		auto model = std::make_unique<ModelType>();
+		Core::Timer timer;
+
+		uint64_t startTicks = timer.GetTicks();
+		VoxelModelLoader<ModelType> loader;
+		if (!loader.LoadFromFile(*model, modelPath, [](glm::ivec3) {}))
+		{
+			SDE_LOG("Layout benchmark failed to load %s", modelPath);
+			return;
+		}
+		const double loadMs = ElapsedMs(timer, startTicks);
+
+		// Mesh each block on its own, the same as floor chunks
+		const Math::Box3& bounds = model->GetTotalBounds();
+		const glm::vec3 blockSize = model->GetVoxelSize() * (float)ModelType::BlockType::VoxelDimensions;
+		glm::ivec3 startBlock, endBlock;
+		model->GetBlockIterationParameters(bounds, startBlock, endBlock);
+		size_t quadCount = 0;
+		startTicks = timer.GetTicks();
+		for (int32_t z = startBlock.z; z <= endBlock.z; ++z)
+		{
+			for (int32_t y = startBlock.y; y <= endBlock.y; ++y)
+			{
+				for (int32_t x = startBlock.x; x <= endBlock.x; ++x)
+				{
+					const glm::vec3 blockMin = bounds.Min() + glm::vec3(x, y, z) * blockSize;
+					Vox::GreedyQuadExtractor<ModelType> extractor(*model);
+					extractor.ExtractQuads(Math::Box3(blockMin, blockMin + blockSize));
+					quadCount += std::distance(extractor.Begin(), extractor.End());
+				}
+			}
+		}
+		const double meshMs = ElapsedMs(timer, startTicks);
+
+		TestRandom random(0x12345678);
+		std::vector<glm::vec3> rayPoints(c_rayCount * 2);
+		for (auto& point : rayPoints)
+		{
+			point = random.NextPoint(bounds);
+		}
+		RayCounter<ModelType> rays;
+		startTicks = timer.GetTicks();
+		for (uint32_t r = 0; r < c_rayCount; ++r)
+		{
+			Vox::ModelRaymarcher<ModelType> rayMarcher(*model);
+			rayMarcher.Raymarch(rayPoints[r * 2], rayPoints[(r * 2) + 1], rays);
+		}
+		const double raymarchMs = ElapsedMs(timer, startTicks);
+
+		// Same rays, skipping empty space with the occupancy masks
+		for (int32_t z = startBlock.z; z <= endBlock.z; ++z)
+		{
+			for (int32_t y = startBlock.y; y <= endBlock.y; ++y)
+			{
+				for (int32_t x = startBlock.x; x <= endBlock.x; ++x)
+				{
+					model->UpdateOccupancy(glm::ivec3(x, y, z));
+				}
+			}
+		}
+		RayCounter<ModelType> skippingRays;
+		startTicks = timer.GetTicks();
+		for (uint32_t r = 0; r < c_rayCount; ++r)
+		{
+			VoxelRaymarcher<ModelType> rayMarcher(*model);
+			rayMarcher.Raymarch(rayPoints[r * 2], rayPoints[(r * 2) + 1], skippingRays);
+		}
+		const double skippingRaymarchMs = ElapsedMs(timer, startTicks);
+
+		Vox::ModelAreaDataWriter<ModelType> areaWriter(*model);
+		startTicks = timer.GetTicks();
+		for (uint32_t b = 0; b < c_brushCount; ++b)
+		{
+			SphereBrush<ModelType> brush;
+			brush.m_center = random.NextPoint(bounds);
+			brush.m_radius = c_brushRadius;
+			areaWriter.WriteArea(Math::Box3(brush.m_center - brush.m_radius, brush.m_center + brush.m_radius), brush);
+		}
+		const double brushMs = ElapsedMs(timer, startTicks);
+
+		SDE_LOG("%s: load %.1fms, mesh %.1fms (%zu quads), raymarch %.1fms (%u rays, %llu steps, %u hits), skipping raymarch %.1fms (%llu steps, %u hits), brushes %.1fms (%u)",
+			layoutName, loadMs, meshMs, quadCount, raymarchMs, c_rayCount, (unsigned long long)rays.m_steps, rays.m_hits,
+			skippingRaymarchMs, (unsigned long long)skippingRays.m_steps, skippingRays.m_hits, brushMs, c_brushCount);
+		model->RemoveAllBlocks();
+	}
+
+	void Run(const char* modelPath)
+	{
+		RunLayout<VoxelLayoutLinear>(modelPath, "Linear");
+		RunLayout<VoxelLayoutMorton>(modelPath, "Morton");
+		RunLayout<VoxelLayoutBricked<4>>(modelPath, "Bricked 4x4x4");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace VoxelLayoutBenchmark
+{
+	// Loads the model once per block layout and times meshing, raymarching (engine and occupancy skipping) and sphere brush edits.
+	// Results go to the log. Slow, not something to leave running at startup
+	void Run(const char* modelPath);
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "voxel_lod.h"
+#include "kernel/assert.h"
+#include <cstring>
+
+namespace VoxelLod
+{
+	void Downsample(const VoxelData* voxels, uint32_t dimensions, uint32_t lod, VoxelData* cells)
+	{
+		SDE_ASSERT(lod > 0 && lod < c_lodCount);
+		const uint32_t cellSize = CellSize(lod);
+		const uint32_t cellDims = dimensions / cellSize;
+		const uint32_t voxelsPerCell = cellSize * cellSize * cellSize;
+		uint32_t counts[64];	// Per material, materials are the low 6 bits
+		for (uint32_t cz = 0; cz < cellDims; ++cz)
+		{
+			for (uint32_t cy = 0; cy < cellDims; ++cy)
+			{
+				for (uint32_t cx = 0; cx < cellDims; ++cx)
+				{
+					memset(counts, 0, sizeof(counts));
+					uint32_t solidCount = 0;
+					for (uint32_t z = cz * cellSize; z < (cz + 1) * cellSize; ++z)
+					{
+						for (uint32_t y = cy * cellSize; y < (cy + 1) * cellSize; ++y)
+						{
+							const VoxelData* row = voxels + (y * dimensions) + (z * dimensions * dimensions);
+							for (uint32_t x = cx * cellSize; x < (cx + 1) * cellSize; ++x)
+							{
+								const uint32_t material = static_cast<uint32_t>(GetVoxelMaterial(row[x]));
+								counts[material]++;
+								solidCount += material != 0 ? 1 : 0;
+							}
+						}
+					}
+
+					// Ties go to the lowest material index, so the result doesn't depend on voxel order
+					VoxelData cell = 0;
+					if (solidCount * 4 >= voxelsPerCell)
+					{
+						uint32_t bestCount = 0;
+						for (uint32_t m = 1; m < 64; ++m)
+						{
+							if (counts[m] > bestCount)
+							{
+								bestCount = counts[m];
+								cell = (VoxelData)m;
+							}
+						}
+					}
+					cells[cx + (cy * cellDims) + (cz * cellDims * cellDims)] = cell;
+				}
+			}
+		}
+	}
+
+	uint32_t SelectLod(uint32_t currentLod, float distance)
+	{
+		uint32_t lod = currentLod < c_lodCount ? currentLod : c_lodCount - 1;
+		while (lod + 1 < c_lodCount && distance > c_lodDistances[lod] + c_lodHysteresis)
+		{
+			++lod;
+		}
+		while (lod > 0 && distance < c_lodDistances[lod - 1] - c_lodHysteresis)
+		{
+			--lod;
+		}
+		return lod;
+	}
+
+	uint32_t NextLod(uint32_t currentLod, float distance)
+	{
+		if (currentLod + 1 < c_lodCount && distance > c_lodDistances[currentLod] + c_lodHysteresis - c_lodPrebuildMargin)
+		{
+			return currentLod + 1;
+		}
+		if (currentLod > 0 && currentLod < c_lodCount && distance < c_lodDistances[currentLod - 1] - c_lodHysteresis + c_lodPrebuildMargin)
+		{
+			return currentLod - 1;
+		}
+		return currentLod;
+	}
+}
\ No newline at end of file
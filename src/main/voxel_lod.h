@@ -0,0 +1,27 @@
+#pragma once
+
+#include "voxel_definitions.h"
+
+// Coarser versions of a block for distant chunks. Level n merges 2^n voxels on each axis into one cell.
+// Cells are solid if at least a quarter of their voxels are, so single voxel thick walls don't vanish
+// in the distance, and take the most common material among those voxels (damage is ignored)
+namespace VoxelLod
+{
+	static const uint32_t c_lodCount = 3;		// Full resolution, 2x, 4x
+	static const float c_lodDistances[c_lodCount - 1] = { 48.0f, 96.0f };	// Switch to level n + 1 past c_lodDistances[n]
+	static const float c_lodHysteresis = 4.0f;	// Distance either side of a switch point before changing level
+	static const float c_lodPrebuildMargin = 8.0f;	// How close to a switch the next level starts being built
+	static const uint32_t c_allLevels = (1u << c_lodCount) - 1;	// Level masks, bit n is level n
+
+	inline uint32_t CellSize(uint32_t lod) { return 1u << lod; }
+
+	// voxels is a whole block (x-major, dimensions^3), cells gets (dimensions >> lod)^3 cells, also x-major
+	void Downsample(const VoxelData* voxels, uint32_t dimensions, uint32_t lod, VoxelData* cells);
+
+	// Level to draw at this distance, only moves away from currentLod once past the hysteresis band
+	uint32_t SelectLod(uint32_t currentLod, float distance);
+
+	// Level a section at currentLod is about to switch to, or currentLod unless it is within
+	// c_lodPrebuildMargin of a switch point. Remeshes build it ahead so the switch doesn't wait
+	uint32_t NextLod(uint32_t currentLod, float distance);
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "voxel_lod_tests.h"
+#include "voxel_lod.h"
+#include "voxel_binary_mesher.h"
+#include "test_random.h"
+#include "kernel/assert.h"
+#include <iterator>
+#include <vector>
+
+namespace VoxelLodTests
+{
+	const uint32_t c_blockSize = 32;
+
+	inline uint32_t Index(uint32_t x, uint32_t y, uint32_t z, uint32_t dims)
+	{
+		return x + (y * dims) + (z * dims * dims);
+	}
+
+	void DownsampleTest()
+	{
+		std::vector<VoxelData> voxels(c_blockSize * c_blockSize * c_blockSize, 0);
+		std::vector<VoxelData> cells(voxels.size());
+
+		// A one voxel thick (damaged) wall at x = 5 survives both levels, a lone voxel doesn't
+		for (uint32_t z = 0; z < c_blockSize; ++z)
+		{
+			for (uint32_t y = 0; y < c_blockSize; ++y)
+			{
+				voxels[Index(5, y, z, c_blockSize)] = PackVoxel(Materials::Walls, 2);
+			}
+		}
+		voxels[Index(20, 20, 20, c_blockSize)] = PackVoxel(Materials::Pillars, 0);
+
+		// 5 floor voxels beat 3 carpet in the lod 1 cell at (12, 0, 0)
+		for (uint32_t v = 0; v < 8; ++v)
+		{
+			voxels[Index(24 + (v & 1), (v >> 1) & 1, v >> 2, c_blockSize)] = PackVoxel(v < 5 ? Materials::Floor : Materials::Carpet, 0);
+		}
+
+		for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+		{
+			const uint32_t dims = c_blockSize >> lod;
+			const uint32_t cellSize = VoxelLod::CellSize(lod);
+			VoxelLod::Downsample(voxels.data(), c_blockSize, lod, cells.data());
+			for (uint32_t z = 0; z < dims; ++z)
+			{
+				for (uint32_t y = 0; y < dims; ++y)
+				{
+					SDE_ASSERT(cells[Index(5 / cellSize, y, z, dims)] == static_cast<VoxelData>(Materials::Walls));
+				}
+			}
+			SDE_ASSERT(cells[Index(20 / cellSize, 20 / cellSize, 20 / cellSize, dims)] == 0);
+		}
+
+		VoxelLod::Downsample(voxels.data(), c_blockSize, 1, cells.data());
+		SDE_ASSERT(cells[Index(12, 0, 0, c_blockSize / 2)] == static_cast<VoxelData>(Materials::Floor));
+	}
+
+	void SelectLodTest()
+	{
+		// Hovering around a switch point must not change level
+		uint32_t lod = VoxelLod::SelectLod(0, 10.0f);
+		SDE_ASSERT(lod == 0);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			lod = VoxelLod::SelectLod(lod, (i & 1) ? 47.0f : 49.0f);
+			SDE_ASSERT(lod == 0);
+		}
+		lod = VoxelLod::SelectLod(lod, 60.0f);
+		SDE_ASSERT(lod == 1);
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			lod = VoxelLod::SelectLod(lod, (i & 1) ? 47.0f : 49.0f);
+			SDE_ASSERT(lod == 1);
+		}
+		SDE_ASSERT(VoxelLod::SelectLod(lod, 40.0f) == 0);
+
+		// Big jumps go straight to the right level
+		SDE_ASSERT(VoxelLod::SelectLod(0, 500.0f) == VoxelLod::c_lodCount - 1);
+		SDE_ASSERT(VoxelLod::SelectLod(VoxelLod::c_lodCount - 1, 0.0f) == 0);
+
+		// The next level is only a neighbour close to a switch point
+		SDE_ASSERT(VoxelLod::NextLod(0, 10.0f) == 0);
+		SDE_ASSERT(VoxelLod::NextLod(0, 46.0f) == 1);
+		SDE_ASSERT(VoxelLod::NextLod(1, 48.0f) == 0);
+		SDE_ASSERT(VoxelLod::NextLod(1, 70.0f) == 1);
+		SDE_ASSERT(VoxelLod::NextLod(1, 95.0f) == 2);
+		SDE_ASSERT(VoxelLod::NextLod(VoxelLod::c_lodCount - 1, 500.0f) == VoxelLod::c_lodCount - 1);
+		SDE_ASSERT(VoxelLod::NextLod(VoxelLod::c_lodCount - 1, 95.0f) == VoxelLod::c_lodCount - 2);
+	}
+
+	void GridMesherTest()
+	{
+		// A full grid is a closed box, one quad per side
+		const uint32_t dims = c_blockSize / 2;
+		const glm::vec3 origin(1.0f, 2.0f, 3.0f);
+		const glm::vec3 cellSize(0.25f);
+		std::vector<VoxelData> cells(dims * dims * dims, static_cast<VoxelData>(Materials::Walls));
+		VoxelModel model;
+		VoxelBinaryMesher mesher(model);
+		mesher.ExtractQuads(cells.data(), dims, origin, cellSize);
+		SDE_ASSERT(std::distance(mesher.Begin(), mesher.End()) == 6);
+		const glm::vec3 extent = origin + cellSize * (float)dims;
+		for (auto q = mesher.Begin(); q != mesher.End(); ++q)
+		{
+			SDE_ASSERT(q->m_sourceData == static_cast<VoxelData>(Materials::Walls));
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				SDE_ASSERT(glm::all(glm::greaterThanEqual(q->m_vertices[c], origin)) && glm::all(glm::lessThanEqual(q->m_vertices[c], extent)));
+			}
+		}
+	}
+
+	// A floor slab and a wall, shot full of holes. Distant levels are only worth having if they smooth these away
+	void QuadReductionTest()
+	{
+		TestRandom random(0x2545f491);
+		std::vector<VoxelData> voxels(c_blockSize * c_blockSize * c_blockSize, 0);
+		for (uint32_t z = 0; z < c_blockSize; ++z)
+		{
+			for (uint32_t y = 0; y < c_blockSize; ++y)
+			{
+				for (uint32_t x = 0; x < c_blockSize; ++x)
+				{
+					if (y < 6)
+					{
+						voxels[Index(x, y, z, c_blockSize)] = PackVoxel(Materials::Floor, 0);
+					}
+					else if (x >= 12 && x < 16)
+					{
+						voxels[Index(x, y, z, c_blockSize)] = PackVoxel(Materials::Walls, 0);
+					}
+				}
+			}
+		}
+		for (uint32_t hole = 0; hole < 80; ++hole)
+		{
+			const glm::ivec3 center(random.NextInt() % c_blockSize, random.NextInt() % c_blockSize, random.NextInt() % c_blockSize);
+			const int32_t radius = 1 + random.NextInt() % 2;
+			const glm::ivec3 holeMin = glm::max(center - radius, glm::ivec3(0));
+			const glm::ivec3 holeMax = glm::min(center + radius, glm::ivec3(c_blockSize - 1));
+			for (int32_t z = holeMin.z; z <= holeMax.z; ++z)
+			{
+				for (int32_t y = holeMin.y; y <= holeMax.y; ++y)
+				{
+					for (int32_t x = holeMin.x; x <= holeMax.x; ++x)
+					{
+						const glm::ivec3 offset = glm::ivec3(x, y, z) - center;
+						if (glm::dot(offset, offset) <= radius * radius)
+						{
+							voxels[Index(x, y, z, c_blockSize)] = 0;
+						}
+					}
+				}
+			}
+		}
+
+		VoxelModel model;
+		VoxelBinaryMesher mesher(model);
+		std::vector<VoxelData> cells(voxels.size());
+		mesher.ExtractQuads(voxels.data(), c_blockSize, glm::vec3(0.0f), glm::vec3(1.0f));
+		const size_t fullQuadCount = std::distance(mesher.Begin(), mesher.End());
+		for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+		{
+			VoxelLod::Downsample(voxels.data(), c_blockSize, lod, cells.data());
+			mesher.ExtractQuads(cells.data(), c_blockSize >> lod, glm::vec3(0.0f), glm::vec3((float)VoxelLod::CellSize(lod)));
+			const size_t quadCount = std::distance(mesher.Begin(), mesher.End());
+			SDE_ASSERT(quadCount > 0 && quadCount * 4 < fullQuadCount);
+		}
+	}
+
+	void RunTests()
+	{
+		DownsampleTest();
+		SelectLodTest();
+		GridMesherTest();
+		QuadReductionTest();
+	}
+}
\ No newline at end of file
@@ -1,76 +1,168 @@
 #include "voxel_mesh_builder.h"
 #include "voxel_material.h"
-#include "vox/greedy_quad_extractor.h"
-#include "render/mesh_builder.h"
+#include "voxel_binary_mesher.h"
+#include "render/mesh.h"
+#include "render/texture.h"
+#include "render/texture_source.h"
+#include "kernel/assert.h"
+#include <iterator>
 
-void GenerateUVs(const Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor&q, const VoxelMaterial& mat, glm::vec3(&uv)[4])
+void VoxelMeshBuilder::AppendQuad(const glm::uvec3(&corners)[4], uint32_t normal, const VoxelMaterial& material, std::vector<PackedVoxelVertex>& vertices)
 {
-	// Normal dir is 0-1 -> x, 2-3 -> y, 4-5 -> z
-	uint32_t uvAxes[2];
-	switch (q.m_normal)
+	const float packedMaterial = PackedVoxelVertexFormat::PackMaterial((uint32_t)material.TextureIndex(), material.Colour());
+	PackedVoxelVertex quad[4];
+	for (uint32_t c = 0; c < 4; ++c)
 	{
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::XAxisNegative:
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::XAxisPositive:
-		uvAxes[0] = 2;
-		uvAxes[1] = 1;
-		break;
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::YAxisNegative:
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::YAxisPositive:
-		uvAxes[0] = 0;
-		uvAxes[1] = 2;
-		break;
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::ZAxisNegative:
-	case Vox::GreedyQuadExtractor<VoxelModel>::QuadDescriptor::NormalDirection::ZAxisPositive:
-		uvAxes[0] = 0;
-		uvAxes[1] = 1;
-		break;
+		SDE_ASSERT(glm::all(glm::lessThanEqual(corners[c], glm::uvec3(PackedVoxelVertexFormat::c_maxCorner))), "Quad is outside the chunk");
+		quad[c].m_position = PackedVoxelVertexFormat::PackPosition(corners[c], normal);
+		quad[c].m_material = packedMaterial;
 	}
-	uv[0] = glm::vec3(q.m_vertices[0][uvAxes[0]] * 0.25f, q.m_vertices[0][uvAxes[1]] * 0.25f, mat.TextureIndex());
-	uv[1] = glm::vec3(q.m_vertices[1][uvAxes[0]] * 0.25f, q.m_vertices[1][uvAxes[1]] * 0.25f, mat.TextureIndex());
-	uv[2] = glm::vec3(q.m_vertices[2][uvAxes[0]] * 0.25f, q.m_vertices[2][uvAxes[1]] * 0.25f, mat.TextureIndex());
-	uv[3] = glm::vec3(q.m_vertices[3][uvAxes[0]] * 0.25f, q.m_vertices[3][uvAxes[1]] * 0.25f, mat.TextureIndex());
+	vertices.push_back(quad[0]);
+	vertices.push_back(quad[1]);
+	vertices.push_back(quad[2]);
+	vertices.push_back(quad[0]);
+	vertices.push_back(quad[2]);
+	vertices.push_back(quad[3]);
 }
 
-void VoxelMeshBuilder::BuildMeshData(const VoxelModel& sourceModel, const VoxelMaterialSet& materials, const Math::Box3& modelBounds, Render::MeshBuilder& targetMesh)
+VoxelMeshBuilder::VoxelMeshBuilder(const VoxelModel& sourceModel)
+	: m_sourceModel(sourceModel)
+	, m_mesher(sourceModel, VoxelBinaryMesher::c_materialMask)
+	, m_loadedBlock(0)
+	, m_blockLoaded(false)
 {
-	// Extract quads using greedy mesher
-	Vox::GreedyQuadExtractor<VoxelModel> extractor(sourceModel);
-	extractor.ExtractQuads(modelBounds);
+	for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		const uint32_t cells = VoxelBinaryMesher::c_dimensions >> lod;
+		m_lodCells[lod - 1].resize(cells * cells * cells);
+	}
+}
+
+size_t VoxelMeshBuilder::ScratchBytes() const
+{
+	size_t bytes = m_mesher.ScratchBytes();
+	for (const auto& cells : m_lodCells)
+	{
+		bytes += cells.capacity() * sizeof(VoxelData);
+	}
+	return bytes;
+}
+
+void VoxelMeshBuilder::BuildMeshData(const VoxelMaterialSet& materials, const Math::Box3& modelBounds, std::vector<PackedVoxelVertex>& vertices, VoxelDamageLookup& damage)
+{
+	// Extract quads using the bitmask greedy mesher, bounds are always a single block here
+	m_mesher.ExtractQuads(modelBounds);
+	glm::ivec3 blockEnd;
+	m_sourceModel.GetBlockIterationParameters(modelBounds, m_loadedBlock, blockEnd);
+	m_blockLoaded = true;
 
-	if (extractor.Begin() == extractor.End())
+	vertices.clear();
+	damage.Clear();
+	if (m_mesher.Begin() == m_mesher.End())
 	{
 		return;
 	}
-	
-	uint32_t posStream = targetMesh.AddVertexStream(3);
-	uint32_t colourStream = targetMesh.AddVertexStream(4);
-	uint32_t uvStream = targetMesh.AddVertexStream(3);
-	uint32_t normalLookupStream = targetMesh.AddVertexStream(1);
+	damage.Build(m_mesher.BlockVoxels());
+	AppendMesherQuads(materials, modelBounds.Min(), vertices);
+}
+
+void VoxelMeshBuilder::BuildLodMeshData(const VoxelMaterialSet& materials, const Math::Box3& modelBounds, uint32_t lodMask, LodVertices& lodVertices)
+{
+	const uint32_t d = VoxelBinaryMesher::c_dimensions;
+	glm::ivec3 blockStart, blockEnd;
+	m_sourceModel.GetBlockIterationParameters(modelBounds, blockStart, blockEnd);
+	SDE_ASSERT(blockStart == blockEnd, "Bounds must be a single block");
+	if ((lodMask >> 1) != 0 && (!m_blockLoaded || blockStart != m_loadedBlock))
+	{
+		m_mesher.LoadBlockVoxels(modelBounds);		// BuildMeshData was skipped for this block
+	}
+
+	// Meshing a level replaces the mesher voxels, so downsample every level before meshing any
+	for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		if (lodMask & (1 << lod))
+		{
+			VoxelLod::Downsample(m_mesher.BlockVoxels(), d, lod, m_lodCells[lod - 1].data());
+		}
+	}
+	m_blockLoaded = false;
+
+	// Cells outside the block count as empty, so chunk borders always get faces and cover any cracks against neighbours
+	const glm::vec3 voxelSize = m_sourceModel.GetVoxelSize();
+	const glm::vec3 blockOrigin = glm::vec3(blockStart * (int32_t)d) * voxelSize;
+	for (uint32_t lod = 1; lod < VoxelLod::c_lodCount; ++lod)
+	{
+		std::vector<PackedVoxelVertex>& vertices = lodVertices[lod - 1];
+		vertices.clear();
+		if (lodMask & (1 << lod))
+		{
+			m_mesher.ExtractQuads(m_lodCells[lod - 1].data(), d >> lod, blockOrigin, voxelSize * (float)VoxelLod::CellSize(lod));
+			AppendMesherQuads(materials, modelBounds.Min(), vertices);
+		}
+	}
+}
 
-	glm::vec4 giResults[4];
+void VoxelMeshBuilder::AppendMesherQuads(const VoxelMaterialSet& materials, const glm::vec3& origin, std::vector<PackedVoxelVertex>& vertices)
+{
+	vertices.reserve(std::distance(m_mesher.Begin(), m_mesher.End()) * PackedVoxelVertexFormat::c_verticesPerQuad);
 
-	targetMesh.BeginChunk();
-	for (auto q = extractor.Begin(); q != extractor.End(); ++q)
+	// Quad corners always land on voxel boundaries, round to the nearest one
+	const glm::vec3 invVoxelSize = 1.0f / m_sourceModel.GetVoxelSize();
+	for (auto q = m_mesher.Begin(); q != m_mesher.End(); ++q)
 	{
-		const auto& material = materials.GetMaterial(q->m_sourceData);
-		const float normal = static_cast<float>(q->m_normal);
-		const glm::vec4& colour = material.Colour();
-		glm::vec3 uvs[4];
-		GenerateUVs(*q, material, uvs);
+		glm::uvec3 corners[4];
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			corners[c] = glm::uvec3(glm::max(glm::round((q->m_vertices[c] - origin) * invVoxelSize), glm::vec3(0.0f)));
+		}
+		AppendQuad(corners, static_cast<uint32_t>(q->m_normal), materials.GetMaterial(q->m_sourceData), vertices);
+	}
+}
+
+bool VoxelMeshBuilder::CreateMesh(const std::vector<PackedVoxelVertex>& vertices, Render::Mesh& targetMesh)
+{
+	auto& streams = targetMesh.GetStreams();
+	auto& vertexArray = targetMesh.GetVertexArray();
+	auto& chunks = targetMesh.GetChunks();
 
-		targetMesh.BeginTriangle();
-		targetMesh.SetStreamData(posStream, q->m_vertices[0], q->m_vertices[1], q->m_vertices[2]);
-		targetMesh.SetStreamData(colourStream, colour, colour, colour);
-		targetMesh.SetStreamData(uvStream, uvs[0], uvs[1], uvs[2]);
-		targetMesh.SetStreamData(normalLookupStream, normal, normal, normal);
-		targetMesh.EndTriangle();
+	const size_t bufferBytes = vertices.size() * sizeof(PackedVoxelVertex);
+	streams.resize(1);
+	if (!streams[0].Create(bufferBytes, Render::RenderBufferType::VertexData, Render::RenderBufferModification::Static))
+	{
+		SDE_LOGC(SDE, "Failed to create voxel vertex buffer");
+		return false;
+	}
+	streams[0].SetData(0, bufferBytes, (void*)vertices.data());
 
-		targetMesh.BeginTriangle();
-		targetMesh.SetStreamData(posStream, q->m_vertices[0], q->m_vertices[2], q->m_vertices[3]);
-		targetMesh.SetStreamData(colourStream, colour, colour, colour);
-		targetMesh.SetStreamData(uvStream, uvs[0], uvs[2], uvs[3]);
-		targetMesh.SetStreamData(normalLookupStream, normal, normal, normal);
-		targetMesh.EndTriangle();
+	vertexArray.AddBuffer(0, &streams[0], Render::VertexDataType::Float, 2);
+	if (!vertexArray.Create())
+	{
+		SDE_LOGC(SDE, "Failed to create voxel vertex array");
+		return false;
+	}
+	chunks.push_back(Render::MeshChunk(0, (uint32_t)vertices.size(), Render::PrimitiveType::Triangles));
+	return true;
+}
+
+bool VoxelMeshBuilder::CreateDamageTexture(const VoxelDamageLookup& damage, Render::Texture& targetTexture)
+{
+	SDE_ASSERT(!damage.IsEmpty());
+
+	// One layer per z slice, each row of voxels is 2 RGBA8 texels
+	const uint32_t dims = VoxelDamageLookup::c_dimensions;
+	const uint32_t texelsPerRow = VoxelDamageLookup::c_bytesPerRow / 4;
+	std::vector<Render::TextureSource> layers;
+	layers.reserve(dims);
+	for (uint32_t z = 0; z < dims; ++z)
+	{
+		auto layerStart = damage.Data().begin() + (z * VoxelDamageLookup::c_bytesPerLayer);
+		std::vector<uint8_t> layerData(layerStart, layerStart + VoxelDamageLookup::c_bytesPerLayer);
+		layers.emplace_back(texelsPerRow, dims, Render::TextureSource::Format::RGBA8, layerData);
+	}
+	if (!targetTexture.Create(layers))
+	{
+		SDE_LOGC(SDE, "Failed to create voxel damage texture");
+		return false;
 	}
-	targetMesh.EndChunk();
+	return true;
 }
\ No newline at end of file
@@ -1,18 +1,56 @@
 #pragma once
 
 #include "voxel_definitions.h"
+#include "packed_voxel_vertex.h"
+#include "voxel_damage_lookup.h"
+#include "voxel_binary_mesher.h"
+#include "voxel_lod.h"
 #include "math/box3.h"
+#include <vector>
 
 namespace Render
 {
-	class MeshBuilder;
+	class Mesh;
+	class Texture;
 }
 
+class VoxelMaterial;
 class VoxelMaterialSet;
 
+// Keeps the mesher scratch between builds, so reusing one builder (i.e. one per job worker) doesn't allocate once warmed up
 class VoxelMeshBuilder
 {
 public:
-	// Populates a MeshBuilder with all the data required to push to the gpu
-	void BuildMeshData(const VoxelModel& sourceModel, const VoxelMaterialSet& materials, const Math::Box3& modelBounds, Render::MeshBuilder& targetMesh);
+	explicit VoxelMeshBuilder(const VoxelModel& sourceModel);
+
+	// Fills vertices with packed triangles for all the quads in the block at modelBounds. Positions are relative to modelBounds.Min().
+	// Quads merge across damage levels and use the undamaged material colour, damage goes in the lookup instead
+	void BuildMeshData(const VoxelMaterialSet& materials, const Math::Box3& modelBounds, std::vector<PackedVoxelVertex>& vertices, VoxelDamageLookup& damage);
+
+	// Same as BuildMeshData for the coarser levels set in lodMask (bit n is level n, level 0 is ignored), corners still in voxels.
+	// The levels are downsampled from the block BuildMeshData just loaded if it was for the same bounds, otherwise the
+	// block is decoded once for all of them. Levels not in the mask are left empty. No damage at a distance
+	typedef std::vector<PackedVoxelVertex> LodVertices[VoxelLod::c_lodCount - 1];	// Levels 1 and up
+	void BuildLodMeshData(const VoxelMaterialSet& materials, const Math::Box3& modelBounds, uint32_t lodMask, LodVertices& lodVertices);
+
+	// Two triangles, corners are in voxels from the chunk origin and wind the same way as the extractor quads
+	static void AppendQuad(const glm::uvec3(&corners)[4], uint32_t normal, const VoxelMaterial& material, std::vector<PackedVoxelVertex>& vertices);
+
+	// Creates the gpu buffers, main thread only
+	static bool CreateMesh(const std::vector<PackedVoxelVertex>& vertices, Render::Mesh& targetMesh);
+
+	// Uploads a (non-empty) damage lookup as a 2D array texture, main thread only
+	static bool CreateDamageTexture(const VoxelDamageLookup& damage, Render::Texture& targetTexture);
+
+	// See VoxelBinaryMesher::ScratchBytes
+	size_t ScratchBytes() const;
+
+private:
+	void AppendMesherQuads(const VoxelMaterialSet& materials, const glm::vec3& origin, std::vector<PackedVoxelVertex>& vertices);
+
+	const VoxelModel& m_sourceModel;
+	VoxelBinaryMesher m_mesher;
+	glm::ivec3 m_loadedBlock;		// Block the mesher voxels came from
+	bool m_blockLoaded;				// False once the mesher has moved on to a LOD grid
+	std::vector<VoxelData> m_lodCells[VoxelLod::c_lodCount - 1];
 };
\ No newline at end of file
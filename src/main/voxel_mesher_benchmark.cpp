@@ -0,0 +1,87 @@
+#include "voxel_mesher_benchmark.h"
+#include "voxel_definitions.h"
+#include "voxel_binary_mesher.h"
+#include "vox_model_loader.h"
+#include "vox/greedy_quad_extractor.h"
+#include "core/timer.h"
+#include "kernel/assert.h"
+#include <iterator>
+#include <memory>
+
+namespace VoxelMesherBenchmark
+{
+	const float c_sectionSize = 8.0f;		// Floor sections are 8m square
+
+	double ElapsedMs(Core::Timer& timer, uint64_t startTicks)
+	{
+		return (double)(timer.GetTicks() - startTicks) * 1000.0 / (double)timer.GetFrequency();
+	}
+
+	template<class Mesher>
+	size_t MeshAllBlocks(const VoxelModel& model, const glm::ivec3& startBlock, const glm::ivec3& endBlock)
+	{
+		const glm::vec3 blockSize = model.GetVoxelSize() * (float)VoxelModel::BlockType::VoxelDimensions;
+		size_t quadCount = 0;
+		for (int32_t z = startBlock.z; z <= endBlock.z; ++z)
+		{
+			for (int32_t y = startBlock.y; y <= endBlock.y; ++y)
+			{
+				for (int32_t x = startBlock.x; x <= endBlock.x; ++x)
+				{
+					const glm::vec3 blockMin = glm::vec3(x, y, z) * blockSize;
+					Mesher mesher(model);
+					mesher.ExtractQuads(Math::Box3(blockMin, blockMin + blockSize));
+					quadCount += std::distance(mesher.Begin(), mesher.End());
+				}
+			}
+		}
+		return quadCount;
+	}
+
+	void Run(const char* modelPath)
+	{
+		// Same storage as the floor: uniform blocks stay shared, packed blocks are expanded once up front so
+		// neither timed pass pays for decoding them
+		auto model = std::make_unique<VoxelModel>();
+		model->SetPaletteCompression(true);
+		VoxelModelLoader<VoxelModel> loader;
+		if (!loader.LoadFromFile(*model, modelPath, [](glm::ivec3) {}))
+		{
+			SDE_LOG("Mesher benchmark failed to load %s", modelPath);
+			return;
+		}
+		glm::ivec3 startBlock, endBlock;
+		model->GetBlockIterationParameters(model->GetTotalBounds(), startBlock, endBlock);
+		for (int32_t z = startBlock.z; z <= endBlock.z; ++z)
+		{
+			for (int32_t y = startBlock.y; y <= endBlock.y; ++y)
+			{
+				for (int32_t x = startBlock.x; x <= endBlock.x; ++x)
+				{
+					model->CompactBlock(glm::ivec3(x, y, z));
+					static_cast<const VoxelModel&>(*model).BlockAt(glm::ivec3(x, y, z));
+				}
+			}
+		}
+		model->FreeRetiredBlocks();
+		const glm::ivec3 blockCounts = (endBlock - startBlock) + 1;
+		const uint32_t blockCount = blockCounts.x * blockCounts.y * blockCounts.z;
+		const float blockSize = model->GetVoxelSize().x * (float)VoxelModel::BlockType::VoxelDimensions;
+		const uint32_t blocksPerSection = (uint32_t)glm::max(c_sectionSize / blockSize, 1.0f);
+		const uint32_t sectionBlocks = blocksPerSection * blocksPerSection * blockCounts.y;
+
+		Core::Timer timer;
+		uint64_t startTicks = timer.GetTicks();
+		const size_t binaryQuads = MeshAllBlocks<VoxelBinaryMesher>(*model, startBlock, endBlock);
+		const double binaryMs = ElapsedMs(timer, startTicks);
+		startTicks = timer.GetTicks();
+		const size_t greedyQuads = MeshAllBlocks<Vox::GreedyQuadExtractor<VoxelModel>>(*model, startBlock, endBlock);
+		const double greedyMs = ElapsedMs(timer, startTicks);
+
+		SDE_LOG("Mesher benchmark, %u blocks (%u per section)", blockCount, sectionBlocks);
+		SDE_LOG("Greedy extractor: %zu quads, %.1fms, %.3fms per block, %.2fms per section",
+			greedyQuads, greedyMs, greedyMs / blockCount, (greedyMs / blockCount) * sectionBlocks);
+		SDE_LOG("Binary mesher: %zu quads, %.1fms, %.3fms per block, %.2fms per section",
+			binaryQuads, binaryMs, binaryMs / blockCount, (binaryMs / blockCount) * sectionBlocks);
+	}
+}
\ No newline at end of file
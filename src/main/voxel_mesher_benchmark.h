@@ -0,0 +1,8 @@
+#pragma once
+
+namespace VoxelMesherBenchmark
+{
+	// Loads the model and meshes every block with both Vox::GreedyQuadExtractor and VoxelBinaryMesher.
+	// Logs quad counts, total time and time per block/floor section
+	void Run(const char* modelPath);
+}
\ No newline at end of file
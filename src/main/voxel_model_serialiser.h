@@ -1,5 +1,9 @@
 #pragma once
 
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
 template<class ModelType>
 class VoxelModelSerialiser
 {
@@ -7,9 +11,38 @@ public:
 	VoxelModelSerialiser();
 	~VoxelModelSerialiser();
 
-	void WriteToFile(const ModelType& srcModel, const char* filepath);
+	// Used to serialise a different view of the model blocks (e.g. a snapshot). The block is only used until the next call
+	typedef std::function<const typename ModelType::BlockType*(const glm::ivec3&)> BlockSource;
+
+	// The old file is only replaced once the new one is fully written. Returns false if it wasn't
+	bool WriteToFile(const ModelType& srcModel, const char* filepath);
+	bool WriteToFile(const ModelType& srcModel, const BlockSource& blocks, const char* filepath);
+
+	// Appends the blocks to a journal file (created if needed). Returns false if they weren't all written,
+	// the journal may then end with a partial entry. journalSizeOut gets the new journal size in bytes
+	bool AppendToJournal(const ModelType& srcModel, const std::vector<glm::ivec3>& blocks, const char* journalPath, size_t* journalSizeOut = nullptr);
+	bool AppendToJournal(const BlockSource& blockSource, const std::vector<glm::ivec3>& blocks, const char* journalPath, size_t* journalSizeOut = nullptr);
+
+	// Folds a journal back into the model file it was written against, then removes the journal
+	bool CompactJournal(const char* filepath, const char* journalPath);
+
+	// Frees the file sized buffer kept from the last write
+	void ReleaseFileData();
+
 private:
+	// Tracks the block data already in a model file, so identical blocks can point at it instead
+	struct SharedBlockIndex
+	{
+		std::unordered_multimap<uint64_t, uint32_t> m_blocksByHash;
+		std::vector<std::pair<size_t, uint32_t>> m_blockData;	// Offset + size of the data used by each block
+	};
+
 	bool WriteBlockToFile(std::vector<uint8_t>& file, const glm::ivec3& blockIndex, typename const ModelType::BlockType* src);
+	void ShareBlockData(std::vector<uint8_t>& file, size_t blockStart, SharedBlockIndex& index);
+
+	// Kept between calls, reuse a serialiser to avoid reallocating them
+	std::vector<typename ModelType::BlockType::VoxelDataType> m_oneStride;	// Pass data to rle one stride of x axis at a time for speed
+	std::vector<uint8_t> m_fileData;
 };
 
 #include "voxel_model_serialiser.inl"
\ No newline at end of file
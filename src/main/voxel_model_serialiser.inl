@@ -2,11 +2,15 @@
 #include "core/run_length_encoding.h"
 #include "kernel/file_io.h"
 #include "vox_model_fileformat.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
 
 template<class ModelType>
 VoxelModelSerialiser<ModelType>::VoxelModelSerialiser()
 {
-
+	m_oneStride.resize(ModelType::BlockType::VoxelDimensions);
 }
 
 template<class ModelType>
@@ -15,12 +19,16 @@ VoxelModelSerialiser<ModelType>::~VoxelModelSerialiser()
 
 }
 
+template<class ModelType>
+void VoxelModelSerialiser<ModelType>::ReleaseFileData()
+{
+	std::vector<uint8_t>().swap(m_fileData);
+}
+
 template<class ModelType>
 bool VoxelModelSerialiser<ModelType>::WriteBlockToFile(std::vector<uint8_t>& file, const glm::ivec3& blockIndex, typename const ModelType::BlockType* src)
 {
 	uint32_t dimensions = typename ModelType::BlockType::VoxelDimensions;
-	std::vector<typename ModelType::BlockType::VoxelDataType> oneStride;	// Pass data to rle one stride of x axis at a time for speed
-	oneStride.resize(dimensions);
 	Core::RunLengthEncoder rle;
 	bool isEmpty = true;
 	const auto fileSizeBeforeRLE = file.size();	// we rewind if the block is empty, there's no need to store it
@@ -37,11 +45,11 @@ bool VoxelModelSerialiser<ModelType>::WriteBlockToFile(std::vector<uint8_t>& fil
 			for (uint32_t x = 0; x < dimensions; ++x)
 			{
 				auto v = src->VoxelAt(x, y, z);
-				oneStride[x] = v;
+				m_oneStride[x] = v;
 				isEmpty &= (v == 0);
 			}
-			rle.WriteData(reinterpret_cast<const uint8_t*>(oneStride.data()),
-				oneStride.size() * sizeof(typename ModelType::BlockType::VoxelDataType),
+			rle.WriteData(reinterpret_cast<const uint8_t*>(m_oneStride.data()),
+				m_oneStride.size() * sizeof(typename ModelType::BlockType::VoxelDataType),
 				file);
 		}
 	}
@@ -62,12 +70,53 @@ bool VoxelModelSerialiser<ModelType>::WriteBlockToFile(std::vector<uint8_t>& fil
 }
 
 template<class ModelType>
-void VoxelModelSerialiser<ModelType>::WriteToFile(const ModelType& srcModel, const char* filepath)
+void VoxelModelSerialiser<ModelType>::ShareBlockData(std::vector<uint8_t>& file, size_t blockStart, SharedBlockIndex& index)
+{
+	// The RLE data is deterministic, so we can compare the encoded bytes directly
+	ModelBlockHeader* header = reinterpret_cast<ModelBlockHeader*>(file.data() + blockStart);
+	const size_t dataOffset = blockStart + sizeof(ModelBlockHeader);
+	const uint32_t dataSize = header->m_dataSize;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < dataSize; ++i)
+	{
+		hash = (hash ^ file[dataOffset + i]) * 1099511628211ull;
+	}
+
+	const uint32_t thisBlock = (uint32_t)index.m_blockData.size();
+	auto matches = index.m_blocksByHash.equal_range(hash);
+	for (auto it = matches.first; it != matches.second; ++it)
+	{
+		const auto& other = index.m_blockData[it->second];
+		if (other.second == dataSize && memcmp(file.data() + other.first, file.data() + dataOffset, dataSize) == 0)
+		{
+			header->m_dataSize = c_sharedBlockDataFlag | it->second;
+			index.m_blockData.push_back(other);
+			file.resize(dataOffset);
+			return;
+		}
+	}
+	index.m_blocksByHash.insert(std::make_pair(hash, thisBlock));
+	index.m_blockData.push_back(std::make_pair(dataOffset, dataSize));
+}
+
+template<class ModelType>
+bool VoxelModelSerialiser<ModelType>::WriteToFile(const ModelType& srcModel, const char* filepath)
 {
-	std::vector<uint8_t> rawData;
+	return WriteToFile(srcModel, [&srcModel](const glm::ivec3& blockIndex)
+	{
+		return srcModel.BlockAt(blockIndex);
+	}, filepath);
+}
+
+template<class ModelType>
+bool VoxelModelSerialiser<ModelType>::WriteToFile(const ModelType& srcModel, const BlockSource& blocks, const char* filepath)
+{
+	std::vector<uint8_t>& rawData = m_fileData;
+	rawData.clear();
 	rawData.resize(sizeof(ModelDataHeader));
 	
 	int32_t blocksSerialised = 0;
+	SharedBlockIndex sharedBlocks;
 	glm::ivec3 blockStartIndices, blockEndIndices;
 	srcModel.GetBlockIterationParameters(srcModel.GetTotalBounds(), blockStartIndices, blockEndIndices);
 
@@ -78,10 +127,12 @@ void VoxelModelSerialiser<ModelType>::WriteToFile(const ModelType& srcModel, con
 			for (int32_t blX = blockStartIndices.x; blX <= blockEndIndices.x; ++blX)
 			{
 				glm::ivec3 blockCoords(blX, blY, blZ);
-				auto thisBlock = srcModel.BlockAt(blockCoords);
-				if (thisBlock != nullptr)
+				auto thisBlock = blocks(blockCoords);
+				const size_t blockStart = rawData.size();
+				if (thisBlock != nullptr && WriteBlockToFile(rawData, blockCoords, thisBlock))
 				{
-					blocksSerialised += WriteBlockToFile(rawData, blockCoords, thisBlock) ? 1 : 0;
+					ShareBlockData(rawData, blockStart, sharedBlocks);
+					++blocksSerialised;
 				}				
 			}
 		}
@@ -102,5 +153,155 @@ void VoxelModelSerialiser<ModelType>::WriteToFile(const ModelType& srcModel, con
 	header->m_totalBounds[4] = srcModel.GetTotalBounds().Max().y;
 	header->m_totalBounds[5] = srcModel.GetTotalBounds().Max().z;
 
-	Kernel::FileIO::SaveBinaryFile(filepath, rawData);
+	return ReplaceModelFile(filepath, rawData);
+}
+
+template<class ModelType>
+bool VoxelModelSerialiser<ModelType>::AppendToJournal(const ModelType& srcModel, const std::vector<glm::ivec3>& blocks, const char* journalPath, size_t* journalSizeOut)
+{
+	return AppendToJournal([&srcModel](const glm::ivec3& blockIndex)
+	{
+		return srcModel.BlockAt(blockIndex);
+	}, blocks, journalPath, journalSizeOut);
+}
+
+template<class ModelType>
+bool VoxelModelSerialiser<ModelType>::AppendToJournal(const BlockSource& blockSource, const std::vector<glm::ivec3>& blocks, const char* journalPath, size_t* journalSizeOut)
+{
+	FILE* journalFile = nullptr;
+	if (fopen_s(&journalFile, journalPath, "ab") != 0 || journalFile == nullptr)
+	{
+		return false;
+	}
+	fseek(journalFile, 0, SEEK_END);
+	const size_t existingSize = (size_t)ftell(journalFile);
+
+	std::vector<uint8_t>& rawData = m_fileData;
+	rawData.clear();
+	if (existingSize == 0)
+	{
+		ModelJournalHeader header;
+		memset(&header, 0, sizeof(header));
+		strcpy_s(header.m_magic, "VoxJ");
+		header.m_version = JournalVersion_Current;
+		header.m_blockDimensions = typename ModelType::BlockType::VoxelDimensions;
+		rawData.insert(rawData.end(), (uint8_t*)&header, (uint8_t*)&header + sizeof(header));
+	}
+
+	for (const auto& blockCoords : blocks)
+	{
+		// Empty blocks still need an entry, otherwise the old contents would come back on load
+		auto thisBlock = blockSource(blockCoords);
+		if (thisBlock == nullptr || !WriteBlockToFile(rawData, blockCoords, thisBlock))
+		{
+			ModelBlockHeader emptyHeader;
+			emptyHeader.m_blockX = blockCoords.x;
+			emptyHeader.m_blockY = blockCoords.y;
+			emptyHeader.m_blockZ = blockCoords.z;
+			emptyHeader.m_dataSize = 0;
+			rawData.insert(rawData.end(), (uint8_t*)&emptyHeader, (uint8_t*)&emptyHeader + sizeof(emptyHeader));
+		}
+	}
+
+	// Buffered data is only written on close, so that can fail too
+	const size_t bytesWritten = fwrite(rawData.data(), 1, rawData.size(), journalFile);
+	const bool closed = fclose(journalFile) == 0;
+	if (journalSizeOut != nullptr)
+	{
+		*journalSizeOut = existingSize + bytesWritten;
+	}
+	return bytesWritten == rawData.size() && closed;
+}
+
+template<class ModelType>
+bool VoxelModelSerialiser<ModelType>::CompactJournal(const char* filepath, const char* journalPath)
+{
+	std::vector<uint8_t> modelData, journalData;
+	if (!Kernel::FileIO::LoadBinaryFile(filepath, modelData) || !Kernel::FileIO::LoadBinaryFile(journalPath, journalData))
+	{
+		return false;
+	}
+	if (modelData.size() < sizeof(ModelDataHeader) || journalData.size() < sizeof(ModelJournalHeader))
+	{
+		return false;
+	}
+
+	// We never decode any voxels, the encoded blocks are just shuffled around
+	// Blocks are keyed by coordinate, later entries replace earlier ones
+	typedef std::tuple<int32_t, int32_t, int32_t> BlockKey;
+	std::map<BlockKey, ModelBlockRecord> latestBlocks;
+
+	ModelDataHeader modelHeader = *reinterpret_cast<const ModelDataHeader*>(modelData.data());
+	if (modelHeader.m_version > Version_Current)
+	{
+		return false;
+	}
+	std::vector<ModelBlockRecord> modelRecords;
+	modelRecords.reserve(modelHeader.m_blockCount);
+	size_t readOffset = sizeof(ModelDataHeader);
+	for (uint32_t b = 0; b < modelHeader.m_blockCount; ++b)
+	{
+		const ModelBlockRecord record = ReadModelBlockRecord(modelData, readOffset, &modelRecords);
+		if (record.m_header == nullptr)
+		{
+			return false;	// Don't compact a broken model file, it would lose the missing blocks for good
+		}
+		latestBlocks[BlockKey(record.m_header->m_blockX, record.m_header->m_blockY, record.m_header->m_blockZ)] = record;
+	}
+	SDE_ASSERT(readOffset <= modelData.size());
+
+	const ModelJournalHeader* journalHeader = reinterpret_cast<const ModelJournalHeader*>(journalData.data());
+	if (strcmp(journalHeader->m_magic, "VoxJ") != 0 || journalHeader->m_blockDimensions != modelHeader.m_blockDimensions)
+	{
+		SDE_ASSERT(false, "Journal does not match model file");
+		return false;
+	}
+	readOffset = sizeof(ModelJournalHeader);
+	while (readOffset + sizeof(ModelBlockHeader) <= journalData.size())
+	{
+		const ModelBlockRecord record = ReadModelBlockRecord(journalData, readOffset, nullptr);
+		if (record.m_header == nullptr)
+		{
+			break;	// Partial entry from an interrupted append, the compacted file drops it
+		}
+		const BlockKey key(record.m_header->m_blockX, record.m_header->m_blockY, record.m_header->m_blockZ);
+		if (record.m_dataSize == 0)
+		{
+			latestBlocks.erase(key);
+		}
+		else
+		{
+			latestBlocks[key] = record;
+		}
+	}
+
+	// Shared data is resolved above, so the blocks are written out and shared again from scratch
+	std::vector<uint8_t>& rawData = m_fileData;
+	rawData.clear();
+	rawData.resize(sizeof(ModelDataHeader));
+	SharedBlockIndex sharedBlocks;
+	for (const auto& it : latestBlocks)
+	{
+		if (it.second.m_data == nullptr)
+		{
+			continue;	// Broken shared block, drop it rather than writing garbage
+		}
+		const size_t blockStart = rawData.size();
+		ModelBlockHeader blockHeader = *it.second.m_header;
+		blockHeader.m_dataSize = it.second.m_dataSize;
+		rawData.insert(rawData.end(), (const uint8_t*)&blockHeader, (const uint8_t*)&blockHeader + sizeof(blockHeader));
+		rawData.insert(rawData.end(), it.second.m_data, it.second.m_data + it.second.m_dataSize);
+		ShareBlockData(rawData, blockStart, sharedBlocks);
+	}
+	modelHeader.m_blockCount = (uint32_t)sharedBlocks.m_blockData.size();
+	modelHeader.m_version = Version_Current;
+	memcpy(rawData.data(), &modelHeader, sizeof(modelHeader));
+
+	// The journal is only removed once the compacted model has replaced the old one
+	if (!ReplaceModelFile(filepath, rawData))
+	{
+		return false;
+	}
+	remove(journalPath);
+	return true;
 }
\ No newline at end of file
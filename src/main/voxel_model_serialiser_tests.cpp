@@ -0,0 +1,218 @@
+#include "voxel_model_serialiser_tests.h"
+#include "voxel_definitions.h"
+#include "voxel_model_serialiser.h"
+#include "vox_model_loader.h"
+#include "vox_model_fileformat.h"
+#include "kernel/file_io.h"
+#include "kernel/assert.h"
+#include <cstdio>
+#include <vector>
+
+namespace VoxelModelSerialiserTests
+{
+	const char* c_modelPath = "voxel_model_serialiser_test.vox";
+	const char* c_journalPath = "voxel_model_serialiser_test.vox.journal";
+	const uint32_t c_roomBlocks = 8;
+
+	// Walls on two sides and a floor, the same in every block it is used on
+	void BuildRoom(VoxelModel& model, const glm::ivec3& blockIndex)
+	{
+		VoxelModel::BlockType* block = model.BlockAt(blockIndex);
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					const Materials material = (x == 0 || z == 0) ? Materials::Walls : (y == 0 ? Materials::Floor : Materials::Air);
+					block->VoxelAt(x, y, z) = PackVoxel(material, 0);
+				}
+			}
+		}
+	}
+
+	// Counts the records that point at an earlier block's data, checking they resolve to the same bytes
+	uint32_t CountSharedRecords(const char* path)
+	{
+		std::vector<uint8_t> file;
+		const bool fileLoaded = Kernel::FileIO::LoadBinaryFile(path, file);
+		SDE_ASSERT(fileLoaded);
+		const ModelDataHeader* header = reinterpret_cast<const ModelDataHeader*>(file.data());
+		SDE_ASSERT(header->m_version == Version_SharedRLE);
+
+		std::vector<ModelBlockRecord> records;
+		size_t readOffset = sizeof(ModelDataHeader);
+		uint32_t sharedCount = 0;
+		for (uint32_t b = 0; b < header->m_blockCount; ++b)
+		{
+			const ModelBlockRecord record = ReadModelBlockRecord(file, readOffset, &records);
+			SDE_ASSERT(record.m_data != nullptr && record.m_dataSize > 0, "Shared records resolve to real data");
+			if ((record.m_header->m_dataSize & c_sharedBlockDataFlag) != 0)
+			{
+				const ModelBlockRecord& source = records[record.m_header->m_dataSize & ~c_sharedBlockDataFlag];
+				SDE_ASSERT(record.m_data == source.m_data && record.m_dataSize == source.m_dataSize);
+				++sharedCount;
+			}
+		}
+		SDE_ASSERT(readOffset == file.size());
+		return sharedCount;
+	}
+
+	void LoadModel(VoxelModel& model, const char* path)
+	{
+		VoxelModelLoader<VoxelModel> loader;
+		const bool loaded = loader.LoadFromFile(model, path, [](glm::ivec3) {});
+		SDE_ASSERT(loaded);
+	}
+
+	bool ModelsMatch(const VoxelModel& a, const VoxelModel& b, const glm::ivec3& blockIndex)
+	{
+		for (uint32_t z = 0; z < 32; ++z)
+		{
+			for (uint32_t y = 0; y < 32; ++y)
+			{
+				for (uint32_t x = 0; x < 32; ++x)
+				{
+					if (a.ReadVoxel(blockIndex, x, y, z) != b.ReadVoxel(blockIndex, x, y, z))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// Identical blocks are written once, the rest point at them and load back as full copies
+	void SharedRecordTest(VoxelModel& model)
+	{
+		for (uint32_t b = 0; b < c_roomBlocks; ++b)
+		{
+			BuildRoom(model, glm::ivec3(b, 0, 0));
+		}
+		BuildRoom(model, glm::ivec3(0, 0, 2));
+		model.BlockAt(glm::ivec3(0, 0, 2))->VoxelAt(5, 5, 5) = PackVoxel(Materials::Pillars, 0);
+
+		VoxelModelSerialiser<VoxelModel> serialiser;
+		const bool written = serialiser.WriteToFile(model, c_modelPath);
+		SDE_ASSERT(written);
+		SDE_ASSERT(CountSharedRecords(c_modelPath) == c_roomBlocks - 1);
+
+		VoxelModel loaded;
+		LoadModel(loaded, c_modelPath);
+		for (uint32_t b = 0; b < c_roomBlocks; ++b)
+		{
+			SDE_ASSERT(ModelsMatch(model, loaded, glm::ivec3(b, 0, 0)));
+		}
+		SDE_ASSERT(ModelsMatch(model, loaded, glm::ivec3(0, 0, 2)));
+	}
+
+	// Journals never share data, compacting one back into the model file must find the duplicates again
+	void CompactJournalTest(VoxelModel& model)
+	{
+		const glm::ivec3 changedRoom(2, 0, 0), copiedRoom(5, 0, 0);
+		model.BlockAt(changedRoom)->VoxelAt(9, 9, 9) = PackVoxel(Materials::Carpet, 0);
+		*model.BlockAt(copiedRoom) = *model.BlockAt(glm::ivec3(0, 0, 2));
+
+		VoxelModelSerialiser<VoxelModel> serialiser;
+		const bool appended = serialiser.AppendToJournal(model, std::vector<glm::ivec3>{ changedRoom, copiedRoom }, c_journalPath);
+		SDE_ASSERT(appended);
+		const bool compacted = serialiser.CompactJournal(c_modelPath, c_journalPath);
+		SDE_ASSERT(compacted);
+		std::vector<uint8_t> journalData;
+		const bool journalLeft = Kernel::FileIO::LoadBinaryFile(c_journalPath, journalData);
+		SDE_ASSERT(!journalLeft, "Compacting removes the journal");
+
+		// 6 plain rooms share one payload, the copied room shares the odd block's
+		SDE_ASSERT(CountSharedRecords(c_modelPath) == (c_roomBlocks - 3) + 1);
+
+		VoxelModel reloaded;
+		LoadModel(reloaded, c_modelPath);
+		for (uint32_t b = 0; b < c_roomBlocks; ++b)
+		{
+			SDE_ASSERT(ModelsMatch(model, reloaded, glm::ivec3(b, 0, 0)));
+		}
+		SDE_ASSERT(ModelsMatch(model, reloaded, glm::ivec3(0, 0, 2)));
+	}
+
+	// An append cut short leaves a partial entry at the end of the journal, the entries before it still apply
+	void TruncatedJournalTest(VoxelModel& model)
+	{
+		const glm::ivec3 firstRoom(1, 0, 0), lastRoom(3, 0, 0);
+		const auto lastRoomVoxel = model.ReadVoxel(lastRoom, 7, 7, 7);
+		model.BlockAt(firstRoom)->VoxelAt(7, 7, 7) = PackVoxel(Materials::Carpet, 0);
+		model.BlockAt(lastRoom)->VoxelAt(7, 7, 7) = PackVoxel(Materials::Carpet, 0);
+
+		VoxelModelSerialiser<VoxelModel> serialiser;
+		size_t journalSize = 0;
+		const bool appended = serialiser.AppendToJournal(model, std::vector<glm::ivec3>{ firstRoom, lastRoom }, c_journalPath, &journalSize);
+		SDE_ASSERT(appended);
+		std::vector<uint8_t> journalData;
+		const bool journalLoaded = Kernel::FileIO::LoadBinaryFile(c_journalPath, journalData);
+		SDE_ASSERT(journalLoaded && journalData.size() == journalSize);
+		journalData.pop_back();
+		FILE* journalFile = fopen(c_journalPath, "wb");
+		fwrite(journalData.data(), 1, journalData.size(), journalFile);
+		fclose(journalFile);
+
+		VoxelModel journalled;
+		LoadModel(journalled, c_modelPath);
+		VoxelModelLoader<VoxelModel> loader;
+		const bool journalApplied = loader.LoadJournal(journalled, c_journalPath, [](glm::ivec3) {});
+		SDE_ASSERT(journalApplied);
+		SDE_ASSERT(ModelsMatch(model, journalled, firstRoom));
+		SDE_ASSERT(journalled.ReadVoxel(lastRoom, 7, 7, 7) == lastRoomVoxel);
+
+		const bool compacted = serialiser.CompactJournal(c_modelPath, c_journalPath);
+		SDE_ASSERT(compacted);
+		VoxelModel reloaded;
+		LoadModel(reloaded, c_modelPath);
+		SDE_ASSERT(ModelsMatch(model, reloaded, firstRoom));
+		SDE_ASSERT(reloaded.ReadVoxel(lastRoom, 7, 7, 7) == lastRoomVoxel, "The partial entry is dropped");
+	}
+
+	// Saves that can't reach the disk say so, the floor relies on it to keep the blocks unsaved
+	void WriteFailureTest(VoxelModel& model)
+	{
+		VoxelModelSerialiser<VoxelModel> serialiser;
+		const bool written = serialiser.WriteToFile(model, "missing_directory/voxel_model_serialiser_test.vox");
+		SDE_ASSERT(!written);
+		const bool appended = serialiser.AppendToJournal(model, std::vector<glm::ivec3>{ glm::ivec3(0) }, "missing_directory/voxel_model_serialiser_test.vox.journal");
+		SDE_ASSERT(!appended);
+	}
+
+	// Bad shared indices resolve to no data rather than reading past the records
+	void BadSharedIndexTest()
+	{
+		std::vector<uint8_t> buffer(sizeof(ModelBlockHeader));
+		ModelBlockHeader* header = reinterpret_cast<ModelBlockHeader*>(buffer.data());
+		header->m_blockX = header->m_blockY = header->m_blockZ = 0;
+		header->m_dataSize = c_sharedBlockDataFlag | 3;
+		std::vector<ModelBlockRecord> records;
+		size_t readOffset = 0;
+		const ModelBlockRecord record = ReadModelBlockRecord(buffer, readOffset, &records);
+		SDE_ASSERT(record.m_data == nullptr && record.m_dataSize == 0);
+		SDE_ASSERT(readOffset == buffer.size());
+
+		// Records running past the end come back invalid
+		header->m_dataSize = 16;
+		readOffset = 0;
+		const ModelBlockRecord truncated = ReadModelBlockRecord(buffer, readOffset, &records);
+		SDE_ASSERT(truncated.m_header == nullptr && truncated.m_data == nullptr);
+		SDE_ASSERT(readOffset == buffer.size());
+	}
+
+	void RunTests()
+	{
+		VoxelModel model;
+		model.SetVoxelSize(glm::vec3(0.125f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(40.0f, 4.0f, 12.0f)));
+		SharedRecordTest(model);
+		CompactJournalTest(model);
+		TruncatedJournalTest(model);
+		WriteFailureTest(model);
+		BadSharedIndexTest();
+		model.RemoveAllBlocks();
+		remove(c_modelPath);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace VoxelModelSerialiserTests
+{
+	void RunTests();
+}
\ No newline at end of file
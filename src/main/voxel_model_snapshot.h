@@ -0,0 +1,61 @@
+#pragma once
+
+#include "kernel/atomics.h"
+#include <vector>
+#include <memory>
+
+// Copy-on-write view of a set of voxel model blocks, used to serialise the model while edits continue.
+// Frozen blocks are shared with the live model until something writes to them, at which point the
+// writer clones the block first. Only blocks edited while the snapshot is open cost extra memory.
+// Writers must bracket all writes to a block with BeginWrite/EndWrite, and only one writer may touch
+// a block at a time. Freeze/Release must not overlap with another snapshot
+template<class ModelType>
+class VoxelModelSnapshot
+{
+public:
+	typedef typename ModelType::BlockType BlockType;
+
+	VoxelModelSnapshot();
+	~VoxelModelSnapshot();
+
+	void Create(ModelType& model);
+
+	// Called before the snapshot is read. Writes in progress on a block are included in the snapshot
+	void Freeze(const std::vector<glm::ivec3>& blocks);
+	void FreezeAll();
+
+	void BeginWrite(const glm::ivec3& block);
+	void EndWrite(const glm::ivec3& block);
+
+	// Returns the frozen contents of a block. The pointer is only valid until the next call
+	const BlockType* ReadBlock(const glm::ivec3& block);
+
+	// Frees any clones and returns all blocks to the live model
+	void Release();
+
+	size_t ClonedBlockBytes() const { return (size_t)m_clonedBlocks.Get() * sizeof(BlockType); }
+
+private:
+	enum BlockState : int32_t
+	{
+		Live,			// Not in the snapshot, or already read
+		Writing,		// Writer active, not in the snapshot
+		Frozen,			// Live data is the snapshot data
+		FrozenWriting,	// Frozen while a writer was active, becomes Frozen once the write is finished
+		Copying			// Live data is being copied out (by a writer or the reader)
+	};
+
+	void FreezeBlock(uint32_t blockIndex);
+	uint32_t BlockIndex(const glm::ivec3& block) const;
+
+	const ModelType* m_model;			// Only read with CopyBlock, so compact blocks are never expanded by us
+	glm::ivec3 m_firstBlock;
+	glm::ivec3 m_blockCounts;
+	std::unique_ptr<Kernel::AtomicInt32[]> m_blockStates;
+	std::vector<std::unique_ptr<BlockType>> m_clones;	// Snapshot data of frozen blocks that were written to
+	std::vector<uint8_t> m_inSnapshot;					// Set by Freeze, only touched while no writes depend on it
+	std::unique_ptr<BlockType> m_readScratch;
+	Kernel::AtomicInt32 m_clonedBlocks;
+};
+
+#include "voxel_model_snapshot.inl"
\ No newline at end of file
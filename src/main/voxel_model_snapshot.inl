@@ -0,0 +1,172 @@
+#include "kernel/assert.h"
+#include <thread>
+
+template<class ModelType>
+VoxelModelSnapshot<ModelType>::VoxelModelSnapshot()
+	: m_model(nullptr)
+	, m_firstBlock(0)
+	, m_blockCounts(0)
+	, m_clonedBlocks(0)
+{
+}
+
+template<class ModelType>
+VoxelModelSnapshot<ModelType>::~VoxelModelSnapshot()
+{
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::Create(ModelType& model)
+{
+	glm::ivec3 lastBlock;
+	model.GetBlockIterationParameters(model.GetTotalBounds(), m_firstBlock, lastBlock);
+	m_blockCounts = (lastBlock - m_firstBlock) + glm::ivec3(1);
+	m_model = &model;
+
+	const uint32_t totalBlocks = m_blockCounts.x * m_blockCounts.y * m_blockCounts.z;
+	m_blockStates.reset(new Kernel::AtomicInt32[totalBlocks]);
+	for (uint32_t b = 0; b < totalBlocks; ++b)
+	{
+		m_blockStates[b].Set(Live);
+	}
+	m_clones.clear();
+	m_clones.resize(totalBlocks);
+	m_inSnapshot.assign(totalBlocks, 0);
+	m_readScratch = std::make_unique<BlockType>();
+	m_clonedBlocks.Set(0);
+}
+
+template<class ModelType>
+uint32_t VoxelModelSnapshot<ModelType>::BlockIndex(const glm::ivec3& block) const
+{
+	const glm::ivec3 local = block - m_firstBlock;
+	SDE_ASSERT(glm::all(glm::greaterThanEqual(local, glm::ivec3(0))) && glm::all(glm::lessThan(local, m_blockCounts)));
+	return local.x + (local.y * m_blockCounts.x) + (local.z * m_blockCounts.x * m_blockCounts.y);
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::FreezeBlock(uint32_t blockIndex)
+{
+	auto& state = m_blockStates[blockIndex];
+	m_inSnapshot[blockIndex] = 1;
+	while (true)
+	{
+		if (state.CAS(Live, Frozen) || state.CAS(Writing, FrozenWriting))
+		{
+			break;
+		}
+		SDE_ASSERT(state.Get() == Live || state.Get() == Writing, "Snapshots cannot overlap");
+	}
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::Freeze(const std::vector<glm::ivec3>& blocks)
+{
+	for (const auto& block : blocks)
+	{
+		FreezeBlock(BlockIndex(block));
+	}
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::FreezeAll()
+{
+	const uint32_t totalBlocks = m_blockCounts.x * m_blockCounts.y * m_blockCounts.z;
+	for (uint32_t b = 0; b < totalBlocks; ++b)
+	{
+		FreezeBlock(b);
+	}
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::BeginWrite(const glm::ivec3& block)
+{
+	const uint32_t blockIndex = BlockIndex(block);
+	auto& state = m_blockStates[blockIndex];
+	while (true)
+	{
+		if (state.CAS(Live, Writing))
+		{
+			return;
+		}
+		if (state.CAS(Frozen, Copying))
+		{
+			// The snapshot keeps the old contents, the live block is ours to modify
+			std::unique_ptr<BlockType> clone = std::make_unique<BlockType>();
+			if (m_model->CopyBlock(block, *clone))
+			{
+				m_clones[blockIndex] = std::move(clone);
+				m_clonedBlocks.Add(1);
+			}
+			state.Set(Writing);
+			return;
+		}
+		SDE_ASSERT(state.Get() == Copying, "Only one writer per block");
+		std::this_thread::yield();		// The reader is copying the block out, it won't take long
+	}
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::EndWrite(const glm::ivec3& block)
+{
+	auto& state = m_blockStates[BlockIndex(block)];
+	const bool released = state.CAS(Writing, Live) || state.CAS(FrozenWriting, Frozen);
+	SDE_ASSERT(released, "EndWrite without BeginWrite");
+}
+
+template<class ModelType>
+const typename VoxelModelSnapshot<ModelType>::BlockType* VoxelModelSnapshot<ModelType>::ReadBlock(const glm::ivec3& block)
+{
+	const uint32_t blockIndex = BlockIndex(block);
+	if (m_inSnapshot[blockIndex] == 0)
+	{
+		return m_model->CopyBlock(block, *m_readScratch) ? m_readScratch.get() : nullptr;
+	}
+
+	auto& state = m_blockStates[blockIndex];
+	while (true)
+	{
+		if (state.CAS(Frozen, Copying))
+		{
+			// Nobody has touched it, copy the live data out so writers only wait for the copy
+			const BlockType* result = m_model->CopyBlock(block, *m_readScratch) ? m_readScratch.get() : nullptr;
+			state.Set(Live);
+			return result;
+		}
+		const int32_t currentState = state.Get();
+		if (currentState == Live || currentState == Writing)
+		{
+			// A writer got there first and cloned it (a null clone means the block was empty)
+			return m_clones[blockIndex].get();
+		}
+		std::this_thread::yield();		// Waiting for a write that started before the freeze, or a clone
+	}
+}
+
+template<class ModelType>
+void VoxelModelSnapshot<ModelType>::Release()
+{
+	const uint32_t totalBlocks = m_blockCounts.x * m_blockCounts.y * m_blockCounts.z;
+	for (uint32_t b = 0; b < totalBlocks; ++b)
+	{
+		if (m_inSnapshot[b] == 0)
+		{
+			continue;
+		}
+
+		// Blocks that were never read go back to the live model
+		auto& state = m_blockStates[b];
+		while (!(state.CAS(Frozen, Live) || state.CAS(FrozenWriting, Writing)))
+		{
+			const int32_t currentState = state.Get();
+			if (currentState == Live || currentState == Writing)
+			{
+				break;
+			}
+			std::this_thread::yield();
+		}
+		m_inSnapshot[b] = 0;
+		m_clones[b] = nullptr;
+	}
+	m_clonedBlocks.Set(0);
+}
\ No newline at end of file
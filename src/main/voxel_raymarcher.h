@@ -0,0 +1,96 @@
+#pragma once
+
+#include "kernel/base_types.h"
+
+// Voxel by voxel march along a segment through a SparseVoxelModel. The callback gets each voxel in order and returns
+// false to stop, like Vox::ModelRaymarcher. Blocks and bricks that the occupancy masks say are empty are crossed
+// in one step, so air inside them is never reported. Crossing times are worked out from the voxel indices rather
+// than accumulated, so a skip lands on exactly the voxel the slow march would reach and hits are identical
+template<class ModelType>
+class VoxelRaymarcher
+{
+public:
+	typedef typename ModelType::BlockType::VoxelDataType VoxelDataType;
+
+	class Params
+	{
+	public:
+		inline VoxelDataType VoxelData() const { return m_voxelData; }
+		inline const glm::vec3& VoxelPosition() const { return m_voxelPosition; }	// Center of the voxel
+		inline const glm::ivec3& VoxelIndex() const { return m_voxelIndex; }		// Model voxel coordinates
+		inline float Distance() const { return m_distance; }						// From the start to where we entered the voxel
+
+	private:
+		friend class VoxelRaymarcher;
+		VoxelDataType m_voxelData;
+		glm::vec3 m_voxelPosition;
+		glm::ivec3 m_voxelIndex;
+		float m_distance;
+	};
+
+	// First non-zero voxel along a ray
+	struct Hit
+	{
+		bool m_hit;
+		VoxelDataType m_voxelData;
+		glm::vec3 m_voxelPosition;
+		glm::ivec3 m_voxelIndex;
+		float m_distance;
+	};
+	static const uint32_t c_packetSize = 4;
+
+	explicit VoxelRaymarcher(const ModelType& model);
+	void SetSkipEmptySpace(bool skip) { m_skipEmptySpace = skip; }
+
+	template<class Callback>
+	void Raymarch(const glm::vec3& start, const glm::vec3& end, Callback& callback);
+
+	// Finds the first hit for up to c_packetSize rays at once, stepping them together with SSE.
+	// Hits are the same as Raymarch with a callback that stops on the first non-zero voxel
+	void RaymarchPacket(const glm::vec3* starts, const glm::vec3* ends, uint32_t rayCount, Hit* hitsOut);
+
+	// Voxels reported + empty regions skipped by the last Raymarch (or all rays of the last packet)
+	inline uint32_t LastStepCount() const { return m_stepCount; }
+
+private:
+	static const uint32_t c_dimensions = ModelType::BlockType::VoxelDimensions;
+	static const uint32_t c_brickSize = ModelType::c_occupancyBrickSize;
+
+	struct RayState
+	{
+		glm::vec3 m_start;
+		glm::vec3 m_invDelta;
+		glm::ivec3 m_step;
+		glm::ivec3 m_voxel;
+		float m_length;
+		float m_tEntry;		// Segment time we entered m_voxel
+		float m_tExit;		// Segment time we leave the grid (or the segment ends)
+	};
+
+	struct OccupancyCache
+	{
+		glm::ivec3 m_block;
+		bool m_valid;
+		uint64_t m_masks[ModelType::c_occupancyWords];
+	};
+
+	static inline int32_t FloorDiv(int32_t v, int32_t d) { return v >= 0 ? v / d : -((-v + d - 1) / d); }
+	static inline glm::ivec3 BlockForVoxel(const glm::ivec3& voxel);
+	void SetupGrid();
+	bool BeginRay(const glm::vec3& start, const glm::vec3& end, RayState& ray) const;
+	inline bool InGrid(const glm::ivec3& voxel) const;
+	inline float CrossingTime(const RayState& ray, uint32_t axis, int32_t voxel) const;
+	inline uint32_t NextAxis(const RayState& ray, const glm::ivec3& lastVoxel) const;
+	bool EmptyRegionSize(OccupancyCache& cache, const glm::ivec3& voxel, int32_t& regionSize) const;
+	bool SkipRegion(RayState& ray, int32_t regionSize) const;
+	inline VoxelDataType ReadVoxel(const glm::ivec3& voxel) const;
+
+	const ModelType& m_model;
+	bool m_skipEmptySpace;
+	uint32_t m_stepCount;
+	glm::vec3 m_voxelSize;
+	glm::ivec3 m_firstVoxel;
+	glm::ivec3 m_lastVoxel;
+};
+
+#include "voxel_raymarcher.inl"
\ No newline at end of file
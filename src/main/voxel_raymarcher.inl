@@ -0,0 +1,358 @@
+#include "kernel/assert.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <limits>
+
+template<class ModelType>
+VoxelRaymarcher<ModelType>::VoxelRaymarcher(const ModelType& model)
+	: m_model(model)
+	, m_skipEmptySpace(true)
+	, m_stepCount(0)
+{
+}
+
+template<class ModelType>
+inline glm::ivec3 VoxelRaymarcher<ModelType>::BlockForVoxel(const glm::ivec3& voxel)
+{
+	return glm::ivec3(FloorDiv(voxel.x, c_dimensions), FloorDiv(voxel.y, c_dimensions), FloorDiv(voxel.z, c_dimensions));
+}
+
+template<class ModelType>
+void VoxelRaymarcher<ModelType>::SetupGrid()
+{
+	// Voxel range covered by the block table
+	glm::ivec3 firstBlock, lastBlock;
+	m_model.GetBlockIterationParameters(m_model.GetTotalBounds(), firstBlock, lastBlock);
+	m_voxelSize = m_model.GetVoxelSize();
+	m_firstVoxel = firstBlock * (int32_t)c_dimensions;
+	m_lastVoxel = ((lastBlock + glm::ivec3(1)) * (int32_t)c_dimensions) - glm::ivec3(1);
+}
+
+template<class ModelType>
+bool VoxelRaymarcher<ModelType>::BeginRay(const glm::vec3& start, const glm::vec3& end, RayState& ray) const
+{
+	// Clip the segment (t = 0 - 1) to the grid
+	const glm::vec3 gridMin = glm::vec3(m_firstVoxel) * m_voxelSize;
+	const glm::vec3 gridMax = glm::vec3(m_lastVoxel + glm::ivec3(1)) * m_voxelSize;
+	const glm::vec3 delta = end - start;
+	float tEnter = 0.0f, tExit = 1.0f;
+	for (uint32_t a = 0; a < 3; ++a)
+	{
+		if (delta[a] == 0.0f)
+		{
+			if (start[a] < gridMin[a] || start[a] >= gridMax[a])
+			{
+				return false;
+			}
+			ray.m_step[a] = 0;
+			ray.m_invDelta[a] = 0.0f;
+			continue;
+		}
+		ray.m_step[a] = delta[a] > 0.0f ? 1 : -1;
+		ray.m_invDelta[a] = 1.0f / delta[a];
+		float t0 = (gridMin[a] - start[a]) * ray.m_invDelta[a];
+		float t1 = (gridMax[a] - start[a]) * ray.m_invDelta[a];
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+		}
+		tEnter = glm::max(tEnter, t0);
+		tExit = glm::min(tExit, t1);
+	}
+	if (tEnter > tExit)
+	{
+		return false;
+	}
+	ray.m_start = start;
+	ray.m_length = glm::length(delta);
+	ray.m_tEntry = tEnter;
+	ray.m_tExit = tExit;
+	ray.m_voxel = glm::clamp(glm::ivec3(glm::floor((start + (delta * tEnter)) / m_voxelSize)), m_firstVoxel, m_lastVoxel);
+	return true;
+}
+
+template<class ModelType>
+inline bool VoxelRaymarcher<ModelType>::InGrid(const glm::ivec3& voxel) const
+{
+	return glm::all(glm::greaterThanEqual(voxel, m_firstVoxel)) && glm::all(glm::lessThanEqual(voxel, m_lastVoxel));
+}
+
+template<class ModelType>
+inline float VoxelRaymarcher<ModelType>::CrossingTime(const RayState& ray, uint32_t axis, int32_t voxel) const
+{
+	// Segment time at which we leave this voxel along one axis. RaymarchPacket does the same maths 4 at a time
+	if (ray.m_step[axis] == 0)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+	const int32_t boundary = ray.m_step[axis] > 0 ? voxel + 1 : voxel;
+	return (((float)boundary * m_voxelSize[axis]) - ray.m_start[axis]) * ray.m_invDelta[axis];
+}
+
+template<class ModelType>
+inline uint32_t VoxelRaymarcher<ModelType>::NextAxis(const RayState& ray, const glm::ivec3& lastVoxel) const
+{
+	// Ties go to the lowest axis. Skipping relies on this being the only rule
+	uint32_t axis = 0;
+	float best = CrossingTime(ray, 0, lastVoxel.x);
+	for (uint32_t a = 1; a < 3; ++a)
+	{
+		const float t = CrossingTime(ray, a, lastVoxel[a]);
+		if (t < best)
+		{
+			best = t;
+			axis = a;
+		}
+	}
+	return axis;
+}
+
+template<class ModelType>
+bool VoxelRaymarcher<ModelType>::EmptyRegionSize(OccupancyCache& cache, const glm::ivec3& voxel, int32_t& regionSize) const
+{
+	const glm::ivec3 blockIndex = BlockForVoxel(voxel);
+	if (!cache.m_valid || blockIndex != cache.m_block)
+	{
+		m_model.ReadOccupancy(blockIndex, cache.m_masks);
+		cache.m_block = blockIndex;
+		cache.m_valid = true;
+	}
+
+	bool blockEmpty = true;
+	for (uint32_t w = 0; w < ModelType::c_occupancyWords; ++w)
+	{
+		blockEmpty &= cache.m_masks[w] == 0;
+	}
+	if (blockEmpty)
+	{
+		regionSize = c_dimensions;
+		return true;
+	}
+
+	const glm::ivec3 brick = (voxel - (blockIndex * (int32_t)c_dimensions)) / (int32_t)c_brickSize;
+	const uint32_t bit = brick.x + (brick.y * ModelType::c_bricksPerAxis) + (brick.z * ModelType::c_bricksPerAxis * ModelType::c_bricksPerAxis);
+	if ((cache.m_masks[bit >> 6] & (1ull << (bit & 63))) == 0)
+	{
+		regionSize = c_brickSize;
+		return true;
+	}
+	return false;
+}
+
+template<class ModelType>
+bool VoxelRaymarcher<ModelType>::SkipRegion(RayState& ray, int32_t regionSize) const
+{
+	// Jump to the last voxel of the region on each axis, the one we leave through first is the exit
+	glm::ivec3 regionLast;
+	for (uint32_t a = 0; a < 3; ++a)
+	{
+		const int32_t regionStart = FloorDiv(ray.m_voxel[a], regionSize) * regionSize;
+		regionLast[a] = ray.m_step[a] < 0 ? regionStart : regionStart + regionSize - 1;
+	}
+	const uint32_t exitAxis = NextAxis(ray, regionLast);
+	const float exitTime = CrossingTime(ray, exitAxis, regionLast[exitAxis]);
+	if (exitTime > ray.m_tExit)
+	{
+		return false;
+	}
+
+	// The other axes take every step the slow march would have taken before the exit
+	for (uint32_t a = 0; a < 3; ++a)
+	{
+		if (a == exitAxis || ray.m_step[a] == 0)
+		{
+			continue;
+		}
+		float t = CrossingTime(ray, a, ray.m_voxel[a]);
+		while (t < exitTime || (t == exitTime && a < exitAxis))
+		{
+			ray.m_voxel[a] += ray.m_step[a];
+			t = CrossingTime(ray, a, ray.m_voxel[a]);
+		}
+	}
+	ray.m_voxel[exitAxis] = regionLast[exitAxis] + ray.m_step[exitAxis];
+	ray.m_tEntry = exitTime;
+	return true;
+}
+
+template<class ModelType>
+inline typename VoxelRaymarcher<ModelType>::VoxelDataType VoxelRaymarcher<ModelType>::ReadVoxel(const glm::ivec3& voxel) const
+{
+	const glm::ivec3 blockIndex = BlockForVoxel(voxel);
+	const glm::ivec3 local = voxel - (blockIndex * (int32_t)c_dimensions);
+	return m_model.ReadVoxel(blockIndex, local.x, local.y, local.z);
+}
+
+template<class ModelType>
+template<class Callback>
+void VoxelRaymarcher<ModelType>::Raymarch(const glm::vec3& start, const glm::vec3& end, Callback& callback)
+{
+	m_stepCount = 0;
+	SetupGrid();
+	RayState ray;
+	if (!BeginRay(start, end, ray))
+	{
+		return;
+	}
+
+	OccupancyCache cache;
+	cache.m_valid = false;
+	Params params;
+	while (InGrid(ray.m_voxel))
+	{
+		++m_stepCount;
+		int32_t regionSize = 0;
+		if (m_skipEmptySpace && EmptyRegionSize(cache, ray.m_voxel, regionSize))
+		{
+			if (!SkipRegion(ray, regionSize))
+			{
+				return;
+			}
+			continue;
+		}
+
+		params.m_voxelData = ReadVoxel(ray.m_voxel);
+		params.m_voxelIndex = ray.m_voxel;
+		params.m_voxelPosition = (glm::vec3(ray.m_voxel) + 0.5f) * m_voxelSize;
+		params.m_distance = ray.m_tEntry * ray.m_length;
+		if (!callback(params))
+		{
+			return;
+		}
+
+		const uint32_t axis = NextAxis(ray, ray.m_voxel);
+		const float t = CrossingTime(ray, axis, ray.m_voxel[axis]);
+		if (t > ray.m_tExit)
+		{
+			return;
+		}
+		ray.m_voxel[axis] += ray.m_step[axis];
+		ray.m_tEntry = t;
+	}
+}
+
+template<class ModelType>
+void VoxelRaymarcher<ModelType>::RaymarchPacket(const glm::vec3* starts, const glm::vec3* ends, uint32_t rayCount, Hit* hitsOut)
+{
+	SDE_ASSERT(rayCount <= c_packetSize, "Too many rays for one packet");
+	m_stepCount = 0;
+	SetupGrid();
+
+	// Lookups and skips are done per lane, the stepping works on all lanes at once from these (SoA) copies
+	RayState rays[c_packetSize];
+	OccupancyCache caches[c_packetSize];
+	alignas(16) int32_t voxel[3][c_packetSize] = {};
+	alignas(16) int32_t step[3][c_packetSize] = {};
+	alignas(16) float start[3][c_packetSize] = {};
+	alignas(16) float invDelta[3][c_packetSize] = {};
+	alignas(16) float tEntry[c_packetSize] = {};
+	alignas(16) float tExit[c_packetSize] = {};
+	uint32_t activeLanes = 0;
+	for (uint32_t lane = 0; lane < rayCount; ++lane)
+	{
+		hitsOut[lane].m_hit = false;
+		caches[lane].m_valid = false;
+		if (!BeginRay(starts[lane], ends[lane], rays[lane]))
+		{
+			continue;
+		}
+		activeLanes |= 1u << lane;
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			voxel[a][lane] = rays[lane].m_voxel[a];
+			step[a][lane] = rays[lane].m_step[a];
+			start[a][lane] = rays[lane].m_start[a];
+			invDelta[a][lane] = rays[lane].m_invDelta[a];
+		}
+		tEntry[lane] = rays[lane].m_tEntry;
+		tExit[lane] = rays[lane].m_tExit;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	while (activeLanes != 0)
+	{
+		uint32_t stepLanes = 0;
+		for (uint32_t lane = 0; lane < rayCount; ++lane)
+		{
+			if ((activeLanes & (1u << lane)) == 0)
+			{
+				continue;
+			}
+			RayState& ray = rays[lane];
+			ray.m_voxel = glm::ivec3(voxel[0][lane], voxel[1][lane], voxel[2][lane]);
+			ray.m_tEntry = tEntry[lane];
+			if (!InGrid(ray.m_voxel))
+			{
+				activeLanes &= ~(1u << lane);
+				continue;
+			}
+			++m_stepCount;
+
+			int32_t regionSize = 0;
+			if (m_skipEmptySpace && EmptyRegionSize(caches[lane], ray.m_voxel, regionSize))
+			{
+				if (!SkipRegion(ray, regionSize))
+				{
+					activeLanes &= ~(1u << lane);
+					continue;
+				}
+				voxel[0][lane] = ray.m_voxel.x;
+				voxel[1][lane] = ray.m_voxel.y;
+				voxel[2][lane] = ray.m_voxel.z;
+				tEntry[lane] = ray.m_tEntry;
+				continue;
+			}
+
+			const VoxelDataType data = ReadVoxel(ray.m_voxel);
+			if (data != 0)
+			{
+				Hit& hit = hitsOut[lane];
+				hit.m_hit = true;
+				hit.m_voxelData = data;
+				hit.m_voxelIndex = ray.m_voxel;
+				hit.m_voxelPosition = (glm::vec3(ray.m_voxel) + 0.5f) * m_voxelSize;
+				hit.m_distance = ray.m_tEntry * ray.m_length;
+				activeLanes &= ~(1u << lane);
+				continue;
+			}
+			stepLanes |= 1u << lane;
+		}
+		if (stepLanes == 0)
+		{
+			continue;
+		}
+
+		// Crossing times for all 3 axes, then each lane steps along whichever it crosses first (lowest axis on ties)
+		__m128 t[3];
+		__m128i steps[3], voxels[3];
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			steps[a] = _mm_load_si128(reinterpret_cast<const __m128i*>(step[a]));
+			voxels[a] = _mm_load_si128(reinterpret_cast<const __m128i*>(voxel[a]));
+			const __m128i boundary = _mm_sub_epi32(voxels[a], _mm_cmpgt_epi32(steps[a], zero));	// +1 when stepping up
+			const __m128 crossing = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(boundary), _mm_set1_ps(m_voxelSize[a])), _mm_load_ps(start[a])), _mm_load_ps(invDelta[a]));
+			const __m128 noStep = _mm_castsi128_ps(_mm_cmpeq_epi32(steps[a], zero));
+			t[a] = _mm_or_ps(_mm_and_ps(noStep, infinity), _mm_andnot_ps(noStep, crossing));
+		}
+		const __m128 pickY = _mm_cmplt_ps(t[1], t[0]);
+		__m128 best = _mm_or_ps(_mm_and_ps(pickY, t[1]), _mm_andnot_ps(pickY, t[0]));
+		const __m128 pickZ = _mm_cmplt_ps(t[2], best);
+		best = _mm_or_ps(_mm_and_ps(pickZ, t[2]), _mm_andnot_ps(pickZ, best));
+
+		const __m128i laneMask = _mm_set_epi32((stepLanes & 8) ? -1 : 0, (stepLanes & 4) ? -1 : 0, (stepLanes & 2) ? -1 : 0, (stepLanes & 1) ? -1 : 0);
+		const __m128i moveZ = _mm_and_si128(_mm_castps_si128(pickZ), laneMask);
+		const __m128i moveY = _mm_andnot_si128(moveZ, _mm_and_si128(_mm_castps_si128(pickY), laneMask));
+		const __m128i moveX = _mm_andnot_si128(_mm_or_si128(moveY, moveZ), laneMask);
+		const __m128i moves[3] = { moveX, moveY, moveZ };
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			_mm_store_si128(reinterpret_cast<__m128i*>(voxel[a]), _mm_add_epi32(voxels[a], _mm_and_si128(steps[a], moves[a])));
+		}
+		const __m128 moved = _mm_castsi128_ps(laneMask);
+		_mm_store_ps(tEntry, _mm_or_ps(_mm_and_ps(moved, best), _mm_andnot_ps(moved, _mm_load_ps(tEntry))));
+
+		// Lanes whose next voxel is past the end of the segment are done
+		activeLanes &= ~((uint32_t)_mm_movemask_ps(_mm_cmpgt_ps(best, _mm_load_ps(tExit))) & stepLanes);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "voxel_raymarcher_tests.h"
+#include "voxel_raymarcher.h"
+#include "voxel_definitions.h"
+#include "test_random.h"
+#include "vox/model_ray_marcher.h"
+#include "kernel/assert.h"
+#include <algorithm>
+
+namespace VoxelRaymarcherTests
+{
+	typedef VoxelRaymarcher<VoxelModel> Raymarcher;
+
+	struct FirstHit
+	{
+		bool m_hit = false;
+		glm::ivec3 m_voxel = glm::ivec3(0);
+		VoxelData m_data = 0;
+		float m_distance = 0.0f;
+		bool operator()(const Raymarcher::Params& params)
+		{
+			if (params.VoxelData() != 0)
+			{
+				m_hit = true;
+				m_voxel = params.VoxelIndex();
+				m_data = params.VoxelData();
+				m_distance = params.Distance();
+				return false;
+			}
+			return true;
+		}
+	};
+
+	// 16 x 8 x 16m at quarter metre voxels, so 2 x 1 x 2 blocks with a few walls and scattered boxes
+	void BuildModel(VoxelModel& model)
+	{
+		model.SetVoxelSize(glm::vec3(0.25f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(16.0f, 8.0f, 16.0f)));
+		TestRandom random(0x9e3779b9);
+		for (uint32_t box = 0; box < 40; ++box)
+		{
+			const glm::ivec3 boxMin = glm::ivec3(random.NextPoint(glm::vec3(0.0f), glm::vec3(56.0f, 24.0f, 56.0f)));
+			const glm::ivec3 boxSize = glm::ivec3(random.NextPoint(glm::vec3(1.0f), glm::vec3(8.0f)));
+			for (int32_t z = boxMin.z; z < boxMin.z + boxSize.z; ++z)
+			{
+				for (int32_t y = boxMin.y; y < boxMin.y + boxSize.y; ++y)
+				{
+					for (int32_t x = boxMin.x; x < boxMin.x + boxSize.x; ++x)
+					{
+						model.BlockAt(glm::ivec3(x / 32, y / 32, z / 32))->VoxelAt(x % 32, y % 32, z % 32) = (VoxelData)(1 + (box % 5));
+					}
+				}
+			}
+		}
+		for (int32_t z = 0; z < 2; ++z)
+		{
+			for (int32_t x = 0; x < 2; ++x)
+			{
+				model.CompactBlock(glm::ivec3(x, 0, z));
+				model.UpdateOccupancy(glm::ivec3(x, 0, z));
+			}
+		}
+	}
+
+	void CompareRay(VoxelModel& model, const glm::vec3& start, const glm::vec3& end)
+	{
+		Raymarcher slow(model), fast(model);
+		slow.SetSkipEmptySpace(false);
+		FirstHit slowHit, fastHit;
+		slow.Raymarch(start, end, slowHit);
+		fast.Raymarch(start, end, fastHit);
+		SDE_ASSERT(slowHit.m_hit == fastHit.m_hit);
+		SDE_ASSERT(slowHit.m_voxel == fastHit.m_voxel);
+		SDE_ASSERT(slowHit.m_data == fastHit.m_data);
+		SDE_ASSERT(fast.LastStepCount() <= slow.LastStepCount());
+	}
+
+	void RandomRaysTest()
+	{
+		VoxelModel model;
+		BuildModel(model);
+		TestRandom random(0x9e3779b9);
+		for (uint32_t r = 0; r < 2000; ++r)
+		{
+			// Some rays start or end outside the model
+			CompareRay(model, random.NextPoint(glm::vec3(-4.0f), glm::vec3(20.0f, 12.0f, 20.0f)), random.NextPoint(glm::vec3(-4.0f), glm::vec3(20.0f, 12.0f, 20.0f)));
+		}
+	}
+
+	void EdgeCaseRaysTest()
+	{
+		// Rays along voxel/brick/block boundaries and exact diagonals, where the axis tie-break matters
+		VoxelModel model;
+		BuildModel(model);
+		const glm::vec3 starts[] = { glm::vec3(0.0f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(8.0f, 4.0f, 8.0f), glm::vec3(0.5f, 0.25f, 15.75f) };
+		const glm::vec3 directions[] = {
+			glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), glm::vec3(-1, 0, 0),
+			glm::vec3(1, 1, 0), glm::vec3(1, 0, 1), glm::vec3(1, 1, 1), glm::vec3(-1, 1, -1), glm::vec3(2, 1, 0), glm::vec3(1, -2, 4)
+		};
+		for (const auto& start : starts)
+		{
+			for (const auto& direction : directions)
+			{
+				CompareRay(model, start, start + direction * 32.0f);
+				CompareRay(model, start + direction * 32.0f, start);
+			}
+		}
+		CompareRay(model, glm::vec3(3.3f, 2.2f, 1.1f), glm::vec3(3.3f, 2.2f, 1.1f));
+	}
+
+	void OccupancyUpdateTest()
+	{
+		VoxelModel model;
+		model.SetVoxelSize(glm::vec3(0.25f));
+		model.PreallocateMemory(Math::Box3(glm::vec3(0.0f), glm::vec3(16.0f, 8.0f, 16.0f)));
+		const glm::vec3 start(0.1f, 0.1f, 0.1f), end(15.9f, 0.1f, 0.1f);
+
+		// A lone voxel in the far block
+		uint64_t masks[VoxelModel::c_occupancyWords];
+		model.BlockAt(glm::ivec3(1, 0, 0))->VoxelAt(17, 0, 0) = 3;
+		model.UpdateOccupancy(glm::ivec3(1, 0, 0));
+		SDE_ASSERT(model.ReadOccupancy(glm::ivec3(1, 0, 0), masks) && masks[0] == (1ull << 4));
+		Raymarcher raymarcher(model);
+		FirstHit hit;
+		raymarcher.Raymarch(start, end, hit);
+		SDE_ASSERT(hit.m_hit && hit.m_voxel == glm::ivec3(49, 0, 0));
+		SDE_ASSERT(raymarcher.LastStepCount() < 16);		// One skip for the first block, a few bricks, then the hit
+
+		// Removing it and updating the masks makes the whole block skippable again
+		model.BlockAt(glm::ivec3(1, 0, 0))->VoxelAt(17, 0, 0) = 0;
+		model.CompactBlock(glm::ivec3(1, 0, 0));
+		model.UpdateOccupancy(glm::ivec3(1, 0, 0));
+		SDE_ASSERT(model.ReadOccupancy(glm::ivec3(1, 0, 0), masks) && masks[0] == 0);
+		FirstHit miss;
+		raymarcher.Raymarch(start, end, miss);
+		SDE_ASSERT(!miss.m_hit && raymarcher.LastStepCount() == 2);
+		SDE_ASSERT(!model.ReadOccupancy(glm::ivec3(5, 0, 0), masks) && masks[0] == 0);
+	}
+
+	void PacketRaysTest()
+	{
+		// Packets must give the same first hits as tracing each ray alone, including partial packets
+		VoxelModel model;
+		BuildModel(model);
+		TestRandom random(0x9e3779b9);
+		Raymarcher raymarcher(model);
+		glm::vec3 starts[Raymarcher::c_packetSize], ends[Raymarcher::c_packetSize];
+		Raymarcher::Hit hits[Raymarcher::c_packetSize];
+		for (uint32_t packet = 0; packet < 500; ++packet)
+		{
+			const uint32_t rayCount = 1 + (packet % Raymarcher::c_packetSize);
+			const glm::vec3 origin = random.NextPoint(glm::vec3(-4.0f), glm::vec3(20.0f, 12.0f, 20.0f));
+			for (uint32_t r = 0; r < rayCount; ++r)
+			{
+				// Alternate between a spread from one point and unrelated rays
+				starts[r] = (packet & 4) ? origin : random.NextPoint(glm::vec3(-4.0f), glm::vec3(20.0f, 12.0f, 20.0f));
+				ends[r] = random.NextPoint(glm::vec3(-4.0f), glm::vec3(20.0f, 12.0f, 20.0f));
+			}
+			raymarcher.RaymarchPacket(starts, ends, rayCount, hits);
+			for (uint32_t r = 0; r < rayCount; ++r)
+			{
+				FirstHit expected;
+				raymarcher.Raymarch(starts[r], ends[r], expected);
+				SDE_ASSERT(hits[r].m_hit == expected.m_hit);
+				if (expected.m_hit)
+				{
+					SDE_ASSERT(hits[r].m_voxelIndex == expected.m_voxel);
+					SDE_ASSERT(hits[r].m_voxelData == expected.m_data);
+					SDE_ASSERT(hits[r].m_distance == expected.m_distance);
+				}
+			}
+		}
+	}
+
+	// First hit from the engine raymarcher, which only reports the voxel centre
+	struct EngineFirstHit
+	{
+		bool m_hit = false;
+		glm::vec3 m_position = glm::vec3(0.0f);
+		bool operator()(const Vox::ModelRaymarcherParams<VoxelModel>& params)
+		{
+			if (params.VoxelData() != 0)
+			{
+				m_hit = true;
+				m_position = params.VoxelPosition();
+				return false;
+			}
+			return true;
+		}
+	};
+
+	// Distance along the ray to where it enters the voxel box (slab test)
+	float EntryDistance(const glm::vec3& start, const glm::vec3& end, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		const glm::vec3 direction = glm::normalize(end - start);
+		float tEntry = 0.0f;
+		for (int32_t axis = 0; axis < 3; ++axis)
+		{
+			if (direction[axis] != 0.0f)
+			{
+				const float t0 = (boxMin[axis] - start[axis]) / direction[axis];
+				const float t1 = (boxMax[axis] - start[axis]) / direction[axis];
+				tEntry = std::max(tEntry, std::min(t0, t1));
+			}
+		}
+		return tEntry;
+	}
+
+	// The skipping march must find the same voxels as Vox::ModelRaymarcher, which it replaced for raycasts
+	void EngineRaymarcherTest()
+	{
+		VoxelModel model;
+		BuildModel(model);
+		const glm::vec3 voxelSize = model.GetVoxelSize();
+		TestRandom random(0x9e3779b9);
+		uint32_t hitCount = 0;
+		for (uint32_t r = 0; r < 2000; ++r)
+		{
+			const glm::vec3 start = random.NextPoint(glm::vec3(0.01f), glm::vec3(15.99f, 7.99f, 15.99f));
+			const glm::vec3 end = random.NextPoint(glm::vec3(0.01f), glm::vec3(15.99f, 7.99f, 15.99f));
+			EngineFirstHit expected;
+			Vox::ModelRaymarcher<VoxelModel> engineRaymarcher(model);
+			engineRaymarcher.Raymarch(start, end, expected);
+			FirstHit actual;
+			Raymarcher raymarcher(model);
+			raymarcher.Raymarch(start, end, actual);
+
+			SDE_ASSERT(actual.m_hit == expected.m_hit);
+			if (expected.m_hit)
+			{
+				const glm::ivec3 expectedVoxel = glm::ivec3(glm::floor(expected.m_position / voxelSize));
+				SDE_ASSERT(actual.m_voxel == expectedVoxel);
+				const glm::vec3 voxelMin = glm::vec3(expectedVoxel) * voxelSize;
+				const float expectedDistance = EntryDistance(start, end, voxelMin, voxelMin + voxelSize);
+				SDE_ASSERT(glm::abs(actual.m_distance - expectedDistance) < 0.001f);
+				++hitCount;
+			}
+		}
+		SDE_ASSERT(hitCount > 100, "Most rays should hit something");
+	}
+
+	void RunTests()
+	{
+		RandomRaysTest();
+		EdgeCaseRaysTest();
+		OccupancyUpdateTest();
+		PacketRaysTest();
+		EngineRaymarcherTest();
+	}
+}
\ No newline at end of file